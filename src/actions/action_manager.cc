@@ -39,51 +39,79 @@ namespace Astroid {
         /* allow new actions to be queued while waiting for db */
         lk.unlock ();
 
-        Db * db;
-        std::unique_lock<std::mutex> rw_lock;
+        if (a->need_db && a->need_db_rw) {
+          /* drain all queued actions that need the read-write db under one
+           * handle and one atomic transaction, rather than re-opening the
+           * db (and waiting for the readers to close) for each action. */
+          Db db (Db::DbMode::DATABASE_READ_WRITE);
+          unsigned long rev0 = db.get_revision ();
+          bool atomic = db.begin_atomic ();
+          int n = 0;
 
-        if (a->need_db) {
-          if (a->need_db_rw) {
-            db = new Db (Db::DbMode::DATABASE_READ_WRITE);
+          lk.lock ();
 
-          } else {
-            db = new Db (Db::DbMode::DATABASE_READ_ONLY);
+          while (true) {
+            perform (&db, a);
+            n++;
+
+            if (actions.empty ()) break;
+
+            refptr<Action> next = actions.front ();
+            if (!(next->need_db && next->need_db_rw)) break;
 
+            a = next;
+            actions.pop_front ();
           }
+
+          lk.unlock ();
+
+          if (atomic) db.end_atomic ();
+          unsigned long rev1 = db.get_revision ();
+          db.close ();
+
+          if (rev1 > rev0) {
+            std::lock_guard<std::mutex> olk (own_revisions_m);
+            own_revisions.push_back (std::make_pair (rev0, rev1));
+
+            /* nobody is asking (no database watcher) */
+            if (own_revisions.size () > 100) own_revisions.pop_front ();
+          }
+
+          LOG (debug) << "actions: performed " << n << " action(s) on one read-write db.";
+
+          lk.lock ();
+          continue;
+        }
+
+        Db * db;
+        RwLock::ticket lock_ticket = 0;
+
+        if (a->need_db) {
+          db = new Db (Db::DbMode::DATABASE_READ_ONLY);
         } else {
           if (a->need_db_rw) {
-            rw_lock = Db::acquire_rw_lock ();
+            lock_ticket = Db::acquire_rw_lock ();
             db = NULL;
           } else {
-            Db::acquire_ro_lock ();
+            lock_ticket = Db::acquire_ro_lock ();
             db = NULL;
           }
         }
 
         lk.lock ();
 
-        if (!a->in_undo) {
-          a->doit (db);
-        } else {
-          a->undo (db);
-        }
+        perform (db, a);
 
         if (a->need_db) {
           db->close ();
           delete db;
         } else {
           if (a->need_db_rw) {
-            Db::release_rw_lock (rw_lock);
+            Db::release_rw_lock (lock_ticket);
           } else {
-            Db::release_ro_lock ();
+            Db::release_ro_lock (lock_ticket);
           }
         }
-
-        if (!a->in_undo && a->undoable () && !a->skip_undo) {
-          doneactions.push_back (a);
-        }
-
-        if (emit) toemit.push (a);
       }
 
       lk.unlock ();
@@ -92,6 +120,23 @@ namespace Astroid {
     }
   }
 
+  void ActionManager::perform (Db * db, refptr<Action> a) {
+    /* must be called with actions_m locked */
+    if (!a->in_undo) {
+      a->doit (db);
+    } else {
+      a->undo (db);
+    }
+
+    /* undo is still kept per action, also when several actions are
+     * performed in the same transaction */
+    if (!a->in_undo && a->undoable () && !a->skip_undo) {
+      doneactions.push_back (a);
+    }
+
+    if (emit) toemit.push (a);
+  }
+
   void ActionManager::undo () {
     LOG (info) << "actions: undo";
     std::unique_lock<std::mutex> lk (actions_m);
@@ -125,17 +170,37 @@ namespace Astroid {
     }
   }
 
+  std::vector<std::pair<unsigned long, unsigned long>> ActionManager::take_own_revisions () {
+    std::lock_guard<std::mutex> lk (own_revisions_m);
+
+    std::vector<std::pair<unsigned long, unsigned long>> r (own_revisions.begin (), own_revisions.end ());
+    own_revisions.clear ();
+
+    return r;
+  }
+
   void ActionManager::emitter () {
     /* runs on gui thread */
     if (emit) {
-      while (!toemit.empty ()) {
-        std::unique_lock<std::mutex> lk (toemit_m);
+      /* emit all the actions performed since the last time using the same
+       * db */
+      std::queue<refptr<Action>> batch;
 
-        refptr<Action> a = toemit.front ();
-        toemit.pop ();
-        lk.unlock ();
+      {
+        std::lock_guard<std::mutex> lk (toemit_m);
+        batch.swap (toemit);
+      }
+
+      if (batch.empty ()) return;
+
+      LOG (debug) << "actions: emitting signals for " << batch.size () << " action(s).";
+
+      Db db (Db::DATABASE_READ_ONLY);
+
+      while (!batch.empty ()) {
+        refptr<Action> a = batch.front ();
+        batch.pop ();
 
-        Db db (Db::DATABASE_READ_ONLY);
         a->emit (&db);
       }
     }
@@ -198,6 +263,17 @@ namespace Astroid {
     m_signal_thread_changed.emit (db, thread_id);
   }
 
+  ActionManager::type_signal_threads_changed
+    ActionManager::signal_threads_changed ()
+  {
+    return m_signal_threads_changed;
+  }
+
+  void ActionManager::emit_threads_changed (Db * db, const std::set<ustring> & thread_ids, unsigned long from, unsigned long to) {
+    LOG (info) << "actions: emitted changed signal for " << thread_ids.size () << " threads (lastmod: " << from << ".." << to << ")";
+    m_signal_threads_changed.emit (db, thread_ids, from, to);
+  }
+
   /* message */
   ActionManager::type_signal_message_updated
     ActionManager::signal_message_updated ()
@@ -6,6 +6,7 @@
 # include <thread>
 # include <mutex>
 # include <condition_variable>
+# include <set>
 
 # include <sigc++/sigc++.h>
 
@@ -21,16 +22,25 @@ namespace Astroid {
       void undo ();
       void close ();
 
+      /* the (before, after) database revisions of the writes done by the
+       * actions since the last call, oldest first. used by the database
+       * watcher to tell our own changes from external ones. */
+      std::vector<std::pair<unsigned long, unsigned long>> take_own_revisions ();
+
     private:
       bool run = false;
       std::thread action_worker_t;
       void action_worker ();
+      void perform (Db *, refptr<Action>);
 
       std::mutex actions_m;
       std::condition_variable actions_cv;
 
       std::mutex toemit_m;
 
+      std::mutex own_revisions_m;
+      std::deque<std::pair<unsigned long, unsigned long>> own_revisions;
+
       std::deque<refptr<Action>> doneactions;
       std::deque<refptr<Action>> actions;
       std::queue<refptr<Action>> toemit;
@@ -86,6 +96,15 @@ namespace Astroid {
 
       void emit_thread_changed (Db *, ustring);
 
+      /* threads-changed: a set of threads changed between two revisions of
+       * the database (after a poll or an external refresh). emitted once for
+       * the whole set instead of a thread-updated for each thread, listeners
+       * should treat it as a thread-updated for every thread in the set. */
+      typedef sigc::signal <void, Db *, const std::set<ustring> &, unsigned long, unsigned long> type_signal_threads_changed;
+      type_signal_threads_changed signal_threads_changed ();
+
+      void emit_threads_changed (Db *, const std::set<ustring> &, unsigned long, unsigned long);
+
       /* message-updated signal:
        *
        * this signal is only emitted if tags or the like are changed. the
@@ -111,6 +130,7 @@ namespace Astroid {
     protected:
       type_signal_thread_updated m_signal_thread_updated;
       type_signal_thread_changed m_signal_thread_changed;
+      type_signal_threads_changed m_signal_threads_changed;
       type_signal_message_updated m_signal_message_updated;
       type_signal_refreshed m_signal_refreshed;
 
@@ -70,6 +70,9 @@ namespace Astroid {
   }
 
   void TagAction::emit (Db * db) {
+    /* make new tags available to tag completion */
+    Db::add_known_tags (add);
+
     for (auto &t : taggables) {
       t->emit_updated (db);
     }
@@ -30,7 +30,7 @@ namespace Astroid {
     for (auto &tagged : taggables) {
       LOG (debug) << "toggle_action: " << tagged->str ();
 
-      if (find (tagged->tags.begin(), tagged->tags.end(), toggle_tag) != tagged->tags.end ()) {
+      if (tagged->has_tag (toggle_tag)) {
         remove.push_back (toggle_tag);
       } else {
         add.push_back (toggle_tag);
@@ -57,6 +57,13 @@ namespace Astroid {
     return res;
   }
 
+  void ToggleAction::emit (Db * db) {
+    /* add is only set while toggling */
+    Db::add_known_tags ({ toggle_tag });
+
+    TagAction::emit (db);
+  }
+
   SpamAction::SpamAction (refptr<NotmuchItem> nmt)
     : ToggleAction (nmt, "spam") {
     }
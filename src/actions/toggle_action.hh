@@ -15,6 +15,7 @@ namespace Astroid {
       /* for toggleaction undo == doit, which works with
        * how it is defined in tagaction. */
       virtual bool doit (Db *) override;
+      virtual void emit (Db *) override;
   };
 
   class SpamAction : public ToggleAction {
@@ -30,12 +30,16 @@
 # include "build_config.hh"
 # include "db.hh"
 # include "config.hh"
+# include "crypto.hh"
+# include "message_budget.hh"
 # include "account_manager.hh"
+# include "contacts.hh"
 # include "actions/action_manager.hh"
 # include "actions/action.hh"
 # include "utils/date_utils.hh"
 # include "utils/utils.hh"
 # include "utils/resource.hh"
+# include "utils/startup_profiler.hh"
 
 # ifndef DISABLE_PLUGINS
   # include "plugin/manager.hh"
@@ -48,6 +52,9 @@
 # include "modes/thread_index/thread_index.hh"
 # include "modes/edit_message.hh"
 # include "modes/saved_searches.hh"
+# include "modes/thread_index/query_snapshots.hh"
+# include "modes/thread_index/loader_scheduler.hh"
+# include "modes/thread_view/theme.hh"
 
 /* gmime */
 # include <gmime/gmime.h>
@@ -134,6 +141,7 @@ namespace Astroid {
       ( "start-polling",  "indicate that external polling (external notmuch db R/W operations) starts")
       ( "stop-polling",   "indicate that external polling stops")
       ( "refresh", po::value<unsigned long>(), "refresh messages changed since lastmod")
+      ( "profile-startup", "print the time spent in each phase of start up")
 # ifndef DISABLE_PLUGINS
       ( "disable-plugins", "disable plugins");
 # else
@@ -163,6 +171,8 @@ namespace Astroid {
     show_help |= vm.count("help");
     bool test_config = vm.count("test-config");
 
+    StartupProfiler::init (vm.count ("profile-startup"));
+
     if (show_help) {
 
       cout << desc << endl;
@@ -220,19 +230,22 @@ namespace Astroid {
 
     if (!is_remote ()) {
       /* load config */
-      if (vm.count("config")) {
-        if (test_config) {
-          LOG (error) << "--config cannot be specified together with --test-config.";
-          exit (1);
-        }
+      {
+        StartupProfiler::Phase p ("config");
+        if (vm.count("config")) {
+          if (test_config) {
+            LOG (error) << "--config cannot be specified together with --test-config.";
+            exit (1);
+          }
 
-        LOG (info) << "astroid: loading config: " << vm["config"].as<ustring>().c_str();
-        m_config = new Config (vm["config"].as<ustring>().c_str());
-      } else {
-        if (test_config) {
-          m_config = new Config (true);
+          LOG (info) << "astroid: loading config: " << vm["config"].as<ustring>().c_str();
+          m_config = new Config (vm["config"].as<ustring>().c_str());
         } else {
-          m_config = new Config ();
+          if (test_config) {
+            m_config = new Config (true);
+          } else {
+            m_config = new Config ();
+          }
         }
       }
 
@@ -279,9 +292,12 @@ namespace Astroid {
       /* set up classes */
       Date::init ();
       Utils::init ();
+      Crypto::init ();
+      MessageBudget::init ();
 
       /* Initialize Db and check if it has been set up */
       try {
+        StartupProfiler::Phase p ("db");
         Db::init ();
         Db d; d.get_revision ();
       } catch (database_error &ex) {
@@ -296,17 +312,49 @@ namespace Astroid {
         return 1;
       }
 
-      Keybindings::init ();
-      SavedSearches::init ();
+      /* independent phases: these are either not needed by the first window,
+       * or are waited for by their consumer. */
+      StartupProfiler::launch ("theme", [] () {
+          Theme t;
+        });
+
+      StartupProfiler::launch ("tags", [] () {
+          Db db (Db::DbMode::DATABASE_READ_ONLY);
+          db.load_tags ();
+        });
+
+      StartupProfiler::launch ("saved search counts", &SavedSearches::prefetch_stats);
+
+      {
+        StartupProfiler::Phase p ("keybindings");
+        Keybindings::init ();
+      }
+
+      {
+        StartupProfiler::Phase p ("saved searches");
+        SavedSearches::init ();
+        QuerySnapshots::init ();
+        LoaderScheduler::init ();
+      }
 
       /* set up accounts */
-      accounts = new AccountManager ();
+      {
+        StartupProfiler::Phase p ("accounts");
+        accounts = new AccountManager ();
+      }
+
+      /* recipient completion, built or brought up to date in the background */
+      Contacts::init ();
 
 # ifndef DISABLE_PLUGINS
-      /* set up plugins */
-      bool disable_plugins = vm.count ("disable-plugins");
-      plugin_manager = new PluginManager (disable_plugins, in_test ());
-      plugin_manager->astroid_extension = new PluginManager::AstroidExtension (this);
+      /* set up plugins: the plugin loaders (python) are not thread safe and
+       * are kept on the main thread, in parallel with the phases above. */
+      {
+        StartupProfiler::Phase p ("plugins");
+        bool disable_plugins = vm.count ("disable-plugins");
+        plugin_manager = new PluginManager (disable_plugins, in_test ());
+        plugin_manager->astroid_extension = new PluginManager::AstroidExtension (this);
+      }
 # endif
 
       /* set up global actions */
@@ -319,7 +367,10 @@ namespace Astroid {
 
         no_auto_poll = true;
       }
-      poll = new Poll (!no_auto_poll);
+      {
+        StartupProfiler::Phase p ("poll");
+        poll = new Poll (!no_auto_poll);
+      }
 
       Gtk::Application::run (argc, argv);
 
@@ -361,8 +412,12 @@ namespace Astroid {
     /* set up static classes */
     Date::init ();
     Utils::init ();
+    Crypto::init ();
+    MessageBudget::init ();
     Db::init ();
     SavedSearches::init ();
+    QuerySnapshots::init ();
+    LoaderScheduler::init ();
 
     /* set up accounts */
     accounts = new AccountManager ();
@@ -395,6 +450,14 @@ namespace Astroid {
 
     if (actions) actions->close ();
     SavedSearches::destruct ();
+    Contacts::destruct ();
+    Crypto::destruct ();
+    QuerySnapshots::save ();
+    QuerySnapshots::clear ();
+
+    StartupProfiler::wait_all ();
+
+    LOG (debug) << Db::dump_lock_stats ();
 
 # ifndef DISABLE_PLUGINS
     if (plugin_manager && plugin_manager->astroid_extension) delete plugin_manager->astroid_extension;
@@ -405,6 +468,8 @@ namespace Astroid {
   }
 
   Astroid::~Astroid () {
+    Crypto::stop_workers ();
+
     if (accounts) delete accounts;
 
     if (m_config) delete m_config;
@@ -542,7 +607,13 @@ namespace Astroid {
   }
 
   void Astroid::on_activate () {
-    open_new_window ();
+    {
+      StartupProfiler::Phase p ("first window");
+      open_new_window ();
+    }
+
+    /* report when the first window has been drawn */
+    Glib::signal_idle ().connect_once (sigc::ptr_fun (&StartupProfiler::report));
   }
 
   void Astroid::send_mailto (ustring url) {
@@ -180,7 +180,9 @@ namespace Astroid {
               (GMimeMultipart *) mime_object,
               0);
 
-          crypt->verify_signature (mime_object);
+          /* verified on the crypto workers while the rest of the
+           * thread is loaded */
+          crypt->verify_signature_async (mime_object);
 
           auto c = refptr<Chunk>(new Chunk(mo, false, true, crypt));
           kids.push_back (c);
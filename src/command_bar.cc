@@ -14,7 +14,9 @@
 # include "modes/help_mode.hh"
 # include "modes/saved_searches.hh"
 # include "utils/utils.hh"
+# include "utils/startup_profiler.hh"
 # include "db.hh"
+# include "contacts.hh"
 
 using namespace std;
 
@@ -45,8 +47,8 @@ namespace Astroid {
     entry.signal_changed ().connect (
         sigc::mem_fun (this, &CommandBar::entry_changed));
 
-    /* set up tags */
-    {
+    /* set up tags, the first window uses the tags loaded on start up */
+    if (!StartupProfiler::wait ("tags")) {
       Db db (Db::DbMode::DATABASE_READ_ONLY);
       db.load_tags ();
     }
@@ -55,6 +57,11 @@ namespace Astroid {
     search_completion       = refptr<SearchCompletion> (new SearchCompletion());
     text_search_completion  = refptr<SearchTextCompletion> (new SearchTextCompletion ());
     difftag_completion      = refptr<DiffTagCompletion> (new DiffTagCompletion ());
+    contact_completion      = refptr<ContactCompletion> (new ContactCompletion ());
+  }
+
+  CommandBar::~CommandBar () {
+    refresh_idle.disconnect ();
   }
 
   void CommandBar::set_main_window (MainWindow * mw) {
@@ -81,6 +88,7 @@ namespace Astroid {
 
           /* add to saved searches */
           SavedSearches::add_query_to_history (cmd);
+          search_completion->add_history (cmd);
 
           main_window->add_mode (m);
         }
@@ -92,6 +100,7 @@ namespace Astroid {
           text_search_completion->add_query (cmd);
         }
       case CommandMode::AttachMids:
+      case CommandMode::Recipients:
       case CommandMode::DiffTag:
       case CommandMode::Tag:
         {
@@ -140,6 +149,13 @@ namespace Astroid {
         }
         break;
 
+      case CommandMode::Recipients:
+        {
+          entry.set_icon_from_icon_name ("avatar-default-symbolic");
+          start_recipients (cmd);
+        }
+        break;
+
       case CommandMode::Search:
         {
           mode_label.set_text ("");
@@ -179,10 +195,12 @@ namespace Astroid {
   }
 
   void CommandBar::reset_bar () {
+    refresh_idle.disconnect ();
     entry.set_completion (refptr<Gtk::EntryCompletion>());
   }
 
   void CommandBar::start_generic (ustring cmd) {
+    refresh_idle.disconnect ();
     entry.set_completion (refptr<Gtk::EntryCompletion> ());
     current_completion.reset ();
 
@@ -191,7 +209,7 @@ namespace Astroid {
 
   void CommandBar::start_searching (ustring searchstring) {
     /* set up completion */
-    search_completion->load_tags (Db::tags);
+    TagCompletion::update_tags ();
     search_completion->load_history ();
     search_completion->orig_text = "";
     search_completion->history_pos = 0;
@@ -216,7 +234,7 @@ namespace Astroid {
 
   void CommandBar::start_tagging (ustring tagstring) {
     /* set up completion */
-    tag_completion->load_tags (Db::tags);
+    TagCompletion::update_tags ();
     entry.set_completion (tag_completion);
     current_completion = tag_completion;
 
@@ -227,7 +245,7 @@ namespace Astroid {
 
   void CommandBar::start_difftagging (ustring tagstring) {
     /* set up completion */
-    difftag_completion->load_tags (Db::tags);
+    TagCompletion::update_tags ();
     entry.set_completion (difftag_completion);
     current_completion = difftag_completion;
 
@@ -236,6 +254,13 @@ namespace Astroid {
     difftag_completion->color_tags (edit_mode);
   }
 
+  void CommandBar::start_recipients (ustring addresses) {
+    entry.set_completion (contact_completion);
+    current_completion = contact_completion;
+
+    entry.set_text (addresses);
+  }
+
   bool CommandBar::entry_key_press (GdkEventKey * event) {
     LOG (debug) << "cb: got key: " << event->keyval;
 
@@ -410,6 +435,16 @@ namespace Astroid {
         refptr<TagCompletion>::cast_dynamic (current_completion)->color_tags (edit_mode);
 
     }
+
+    /* the cursor is not yet moved past inserted text when the entry
+     * emits changed, refill the completion model when it is idle. this
+     * still happens well before the entry completion re-filters. */
+    if (current_completion && !refresh_idle.connected ()) {
+      refresh_idle = Glib::signal_idle ().connect ([&] () {
+          if (current_completion) current_completion->refresh ();
+          return false;
+        });
+    }
   }
 
 
@@ -430,10 +465,15 @@ namespace Astroid {
     throw std::bad_function_call ();
   }
 
+  void CommandBar::GenericCompletion::refresh () {
+  }
+
   /* get the next match in the list and use it to complete */
   void CommandBar::GenericCompletion::match_next () {
     /* LOG (debug) << "cb: completion: taking next match"; */
 
+    refresh ();
+
     Gtk::TreeIter fwditer = completion_model->get_iter ("0");
 
     Gtk::Entry * e = get_entry ();
@@ -459,6 +499,10 @@ namespace Astroid {
   bool      CommandBar::TagCompletion::canvas_color_set = false;
   Gdk::RGBA CommandBar::TagCompletion::canvas_color;
 
+  PrefixTrie   CommandBar::TagCompletion::tag_index;
+  size_t       CommandBar::TagCompletion::tags_indexed    = 0;
+  unsigned int CommandBar::TagCompletion::tags_generation = 0;
+
   CommandBar::TagCompletion::TagCompletion ()
   {
     completion_model = Gtk::ListStore::create (m_columns);
@@ -474,17 +518,41 @@ namespace Astroid {
     set_minimum_key_length (1);
   }
 
-  void CommandBar::TagCompletion::load_tags (vector<ustring> _tags) {
-    tags = _tags;
-    sort (tags.begin(), tags.end());
+  void CommandBar::TagCompletion::update_tags () {
+    if (tags_generation != Db::tags_generation) {
+      tag_index.clear ();
+      tags_indexed    = 0;
+      tags_generation = Db::tags_generation;
+    }
+
+    /* index the tags that have been added since last time */
+    for (; tags_indexed < Db::tags.size (); tags_indexed++) {
+      const ustring & t = Db::tags[tags_indexed];
+      tag_index.insert (t.lowercase (), t);
+    }
+  }
+
+  void CommandBar::TagCompletion::add_match (const ustring & t, Kind k) {
+    auto row = *(completion_model->append ());
+    row[m_columns.m_tag]  = t;
+    row[m_columns.m_kind] = k;
+  }
+
+  void CommandBar::TagCompletion::refresh () {
+    ustring_sz pos;
+    ustring key = get_partial_tag (pos).lowercase ();
+
+    if (filled && key == filled_key && tag_index.size () == filled_size) return;
 
     completion_model->clear ();
 
-    /* fill model with tags */
-    for (ustring t : tags) {
-      auto row = *(completion_model->append ());
-      row[m_columns.m_tag] = t;
+    for (auto & t : tag_index.complete (key, max_matches)) {
+      add_match (t);
     }
+
+    filled_key  = key;
+    filled_size = tag_index.size ();
+    filled      = true;
   }
 
   /* searches backwards to the previous ' ' and extracts the
@@ -531,27 +599,8 @@ namespace Astroid {
       const ustring&, const
       Gtk::TreeModel::const_iterator& iter)
   {
-    if (iter)
-    {
-
-      ustring_sz pos;
-      ustring key = get_partial_tag (pos);
-
-      Gtk::TreeModel::Row row = *iter;
-
-      Glib::ustring::size_type key_length = key.size();
-      Glib::ustring filter_string = row[m_columns.m_tag];
-
-      Glib::ustring filter_string_start = filter_string.substr(0, key_length);
-
-      // the key is lower-case, even if the user input is not.
-      filter_string_start = filter_string_start.lowercase();
-
-      if(key.lowercase () == filter_string_start)
-        return true; // a match was found.
-    }
-
-    return false; // no match.
+    /* the model only holds the matches for the current key */
+    return bool (iter);
   }
 
 
@@ -693,15 +742,108 @@ namespace Astroid {
    * Search Completion
    ********************/
 
+  PrefixTrie CommandBar::SearchCompletion::history_index;
+  bool       CommandBar::SearchCompletion::history_indexed = false;
+  PrefixTrie CommandBar::SearchCompletion::query_prefixes;
+
   CommandBar::SearchCompletion::SearchCompletion ()
   {
     set_match_func (sigc::mem_fun (*this,
           &CommandBar::SearchCompletion::match));
+
+    if (query_prefixes.size () == 0) {
+      for (ustring p : { "attachment:", "body:", "date:", "folder:", "from:",
+                         "id:", "is:", "lastmod:", "mid:", "mimetype:",
+                         "path:", "property:", "query:", "subject:", "tag:",
+                         "thread:", "to:" }) {
+        query_prefixes.insert (p);
+      }
+    }
   }
 
   void CommandBar::SearchCompletion::load_history () {
     history = SavedSearches::get_history ();
     std::reverse (history.begin (), history.end ());
+
+    if (!history_indexed) {
+      for (auto & h : history) add_history (h);
+      history_indexed = true;
+    }
+  }
+
+  void CommandBar::SearchCompletion::add_history (ustring q) {
+    if (!q.empty ()) history_index.insert (q.lowercase (), q);
+  }
+
+  /* the word under the cursor, unless it is already a search term with a
+   * prefix */
+  bool CommandBar::SearchCompletion::get_partial_word (ustring &out, ustring_sz &outpos) {
+    Gtk::Entry * e = get_entry ();
+    if (e == NULL) return false;
+
+    ustring in = e->get_text ();
+    int cursor = e->get_position ();
+    if (cursor == -1) cursor = in.size ();
+
+    if (cursor == 0) return false;
+
+    outpos = in.find_last_of (" (", cursor - 1);
+    if (outpos == ustring::npos) outpos = 0;
+    else outpos++;
+
+    if (outpos >= static_cast<ustring_sz> (cursor)) return false;
+
+    out = in.substr (outpos, cursor - outpos);
+
+    return (out.find (':') == ustring::npos);
+  }
+
+  void CommandBar::SearchCompletion::refresh () {
+    Gtk::Entry * e = get_entry ();
+    if (e == NULL) return;
+
+    ustring in = e->get_text ();
+    int cursor = e->get_position ();
+
+    ustring fkey = ustring::compose ("%1:%2", cursor, in);
+    size_t  size = tag_index.size () + history_index.size ();
+
+    if (filled && fkey == filled_key && size == filled_size) return;
+
+    completion_model->clear ();
+
+    ustring key;
+    ustring_sz pos;
+
+    if (get_partial_tag (key, pos)) {
+      for (auto & t : tag_index.complete (key.lowercase (), max_matches)) {
+        add_match (t, Kind::Tag);
+      }
+
+    } else {
+      /* search terms matching the current word first, then the past
+       * queries starting with the input if the cursor is at the end */
+      size_t n = 0;
+
+      if (get_partial_word (key, pos)) {
+        for (auto & p : query_prefixes.complete (key.lowercase (), max_matches)) {
+          add_match (p, Kind::QueryPrefix);
+          n++;
+        }
+      }
+
+      bool at_end = (cursor == -1 || static_cast<ustring_sz> (cursor) == in.size ());
+
+      if (!in.empty () && at_end && n < max_matches) {
+        for (auto & h : history_index.complete (in.lowercase (), max_matches - n)) {
+          add_match (h, Kind::History);
+        }
+      }
+    }
+
+    filled_key  = fkey;
+    filled_size = size;
+    filled      = true;
   }
 
   /* searches backwards to the previous ',' and extracts the
@@ -749,28 +891,8 @@ namespace Astroid {
       const ustring&,
       const Gtk::TreeModel::const_iterator& iter)
   {
-    ustring key;
-    ustring_sz pos;
-    bool in_tag_search = get_partial_tag (key, pos);
-
-    if (in_tag_search && iter)
-    {
-
-      Gtk::TreeModel::Row row = *iter;
-
-      Glib::ustring::size_type key_length = key.size();
-      Glib::ustring filter_string = row[m_columns.m_tag];
-
-      Glib::ustring filter_string_start = filter_string.substr(0, key_length);
-
-      // the key is lower-case, even if the user input is not.
-      filter_string_start = filter_string_start.lowercase();
-
-      if(key.lowercase () == filter_string_start)
-        return true; // a match was found.
-    }
-
-    return false; // no match.
+    /* the model only holds the matches for the current input */
+    return bool (iter);
   }
 
 
@@ -783,9 +905,35 @@ namespace Astroid {
       Gtk::TreeModel::Row row = *iter;
       ustring completion = row[m_columns.m_tag];
 
+      Kind kind = static_cast<Kind> (static_cast<int> (row[m_columns.m_kind]));
+
       ustring t = entry->get_text ();
       ustring key;
       ustring_sz    pos;
+
+      if (kind == Kind::History) {
+        entry->set_text (completion);
+        entry->set_position (completion.size ());
+
+        return true;
+
+      } else if (kind == Kind::QueryPrefix) {
+        if (get_partial_word (key, pos)) {
+          /* replace the rest of the word as well */
+          ustring_sz n = t.find_first_of (") ", pos);
+          if (n == ustring::npos) n = t.size ();
+
+          ustring newt = t.substr (0, pos);
+          newt += completion;
+          newt += t.substr (n, t.size ());
+
+          entry->set_text (newt);
+          entry->set_position (pos + completion.size ());
+        }
+
+        return true;
+      }
+
       bool in_tag_search = get_partial_tag (key, pos);
 
       //LOG (debug) << "match selected: " << t << ", in_tag: " << in_tag_search << ", key: " << key << ", pos: " << pos;
@@ -866,6 +1014,8 @@ namespace Astroid {
     completion_model = Gtk::ListStore::create (m_columns);
     set_model (completion_model);
     set_text_column (m_columns.m_query);
+    set_match_func (sigc::mem_fun (*this,
+          &CommandBar::SearchTextCompletion::match));
 
     //set_inline_completion (true);
     set_popup_completion (true);
@@ -875,9 +1025,36 @@ namespace Astroid {
 
   void CommandBar::SearchTextCompletion::add_query (ustring c) {
     if (!c.empty ()) {
+      query_index.insert (c.lowercase (), c);
+    }
+  }
+
+  void CommandBar::SearchTextCompletion::refresh () {
+    Gtk::Entry * e = get_entry ();
+    if (e == NULL) return;
+
+    ustring key = e->get_text ().lowercase ();
+
+    if (filled && key == filled_key && query_index.size () == filled_size) return;
+
+    completion_model->clear ();
+
+    for (auto & q : query_index.complete (key, max_matches)) {
       auto row = *(completion_model->append ());
-      row[m_columns.m_query] = c;
+      row[m_columns.m_query] = q;
     }
+
+    filled_key  = key;
+    filled_size = query_index.size ();
+    filled      = true;
+  }
+
+  bool CommandBar::SearchTextCompletion::match (
+      const ustring&,
+      const Gtk::TreeModel::const_iterator& iter)
+  {
+    /* the model only holds the matches for the current input */
+    return bool (iter);
   }
 
   bool CommandBar::SearchTextCompletion::on_match_selected (
@@ -895,5 +1072,95 @@ namespace Astroid {
 
     return true;
   }
-}
 
+  /********************
+   * Contact Completion
+   ********************/
+
+  CommandBar::ContactCompletion::ContactCompletion ()
+  {
+    completion_model = Gtk::ListStore::create (m_columns);
+    set_model (completion_model);
+    set_text_column (m_columns.m_address);
+    set_match_func (sigc::mem_fun (*this,
+          &CommandBar::ContactCompletion::match));
+
+    set_popup_completion (true);
+    set_popup_single_match (true);
+    set_minimum_key_length (1);
+  }
+
+  /* the address being entered: from the previous ',' to the cursor */
+  ustring CommandBar::ContactCompletion::get_partial_address (ustring_sz &outpos) {
+    Gtk::Entry * e = get_entry ();
+    if (e == NULL) return "";
+
+    ustring in = e->get_text ();
+    int cursor = e->get_position ();
+    if (cursor == -1) cursor = in.size ();
+
+    outpos = (cursor > 0) ? in.find_last_of (",", cursor - 1) : ustring::npos;
+    if (outpos == ustring::npos) outpos = 0;
+    else outpos++;
+
+    /* skip leading white space */
+    while (outpos < static_cast<ustring_sz> (cursor) && in[outpos] == ' ') outpos++;
+
+    return in.substr (outpos, cursor - outpos);
+  }
+
+  void CommandBar::ContactCompletion::refresh () {
+    ustring_sz pos;
+    ustring key = get_partial_address (pos);
+
+    if (filled && key == filled_key) return;
+
+    completion_model->clear ();
+
+    if (!key.empty ()) {
+      for (auto & a : Contacts::lookup (key, max_contacts)) {
+        auto row = *(completion_model->append ());
+        row[m_columns.m_address] = a;
+      }
+    }
+
+    filled_key = key;
+    filled     = true;
+  }
+
+  bool CommandBar::ContactCompletion::match (
+      const ustring&,
+      const Gtk::TreeModel::const_iterator& iter)
+  {
+    /* the model only holds the matches for the current address */
+    return bool (iter);
+  }
+
+  bool CommandBar::ContactCompletion::on_match_selected (
+      const Gtk::TreeModel::iterator& iter) {
+    if (iter)
+    {
+      Gtk::Entry * entry = get_entry();
+
+      Gtk::TreeModel::Row row = *iter;
+      ustring completion = row[m_columns.m_address];
+
+      ustring t = entry->get_text ();
+      ustring_sz pos;
+      get_partial_address (pos);
+
+      /* replace up to the next address */
+      ustring_sz n = t.find_first_of (",", pos);
+      if (n == ustring::npos) n = t.size ();
+
+      ustring newt = t.substr (0, pos);
+      newt += completion;
+      newt += t.substr (n, t.size ());
+
+      entry->set_text (newt);
+      entry->set_position (pos + completion.size ());
+    }
+
+    return true;
+  }
+}
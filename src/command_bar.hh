@@ -15,6 +15,7 @@
 
 # include "astroid.hh"
 # include "proto.hh"
+# include "utils/prefix_trie.hh"
 
 namespace Astroid {
   class CommandBar : public Gtk::SearchBar {
@@ -26,9 +27,11 @@ namespace Astroid {
         Tag,        /* apply or remove tags */
         DiffTag,    /* apply or remove tags using + or - */
         AttachMids,
+        Recipients, /* add addresses, completed from the contacts */
       };
 
       CommandBar ();
+      ~CommandBar ();
 
       MainWindow * main_window;
       CommandMode mode;
@@ -64,6 +67,9 @@ namespace Astroid {
     private:
       void reset_bar ();
 
+      /* the completion model is refilled once the entry has settled */
+      sigc::connection refresh_idle;
+
       class GenericCompletion : public Gtk::EntryCompletion {
         public:
           refptr<Gtk::ListStore> completion_model;
@@ -75,6 +81,12 @@ namespace Astroid {
 
           /* get the next match in the list */
           virtual void match_next ();
+
+          /* fill the model with the matches for the current input, the
+           * matches are looked up in an index rather than having the entry
+           * completion test every candidate on each key stroke. */
+          virtual void refresh ();
+          size_t max_matches = 256;
       };
 
       refptr<GenericCompletion> current_completion;
@@ -88,8 +100,20 @@ namespace Astroid {
         public:
           TagCompletion ();
 
-          void load_tags (std::vector<ustring>);
-          std::vector<ustring> tags; // must be sorted
+          /* the tag index is shared by all tag completions, and is extended
+           * with the tags added to Db::tags since the last update (by tag
+           * actions, see Db::add_known_tags ()). it is rebuilt if Db::tags
+           * has been reloaded. */
+          static PrefixTrie   tag_index;
+          static size_t       tags_indexed;
+          static unsigned int tags_generation;
+          static void update_tags ();
+
+          enum Kind {
+            Tag = 0,
+            QueryPrefix,
+            History,
+          };
 
           // tree model columns, for the EntryCompletion's filter model
           class ModelColumns : public Gtk::TreeModel::ColumnRecord
@@ -97,11 +121,21 @@ namespace Astroid {
             public:
 
               ModelColumns ()
-              { add(m_tag); }
+              { add(m_tag); add(m_kind); }
 
               Gtk::TreeModelColumn<Glib::ustring> m_tag;
+              Gtk::TreeModelColumn<int>           m_kind;
           };
 
+          void add_match (const ustring &, Kind = Kind::Tag);
+
+          /* the key and index size the model was last filled for */
+          ustring filled_key;
+          size_t  filled_size = 0;
+          bool    filled = false;
+
+          void refresh () override;
+
           ModelColumns m_columns;
 
           ustring break_on = ", ";
@@ -152,7 +186,19 @@ namespace Astroid {
           unsigned int history_pos;
           std::vector <ustring> history;
 
+          /* past queries, loaded from the saved history once and extended
+           * with the searches made since */
+          static PrefixTrie history_index;
+          static bool       history_indexed;
+          void add_history (ustring);
+
+          /* search terms: from:, tag:, .. */
+          static PrefixTrie query_prefixes;
+
           bool get_partial_tag (ustring&, ustring_sz&);
+          bool get_partial_word (ustring&, ustring_sz&);
+
+          void refresh () override;
 
           bool match (const ustring&, const
               Gtk::TreeModel::const_iterator&) override;
@@ -189,10 +235,60 @@ namespace Astroid {
 
           ModelColumns m_columns;
 
+          PrefixTrie query_index;
+
+          ustring filled_key;
+          size_t  filled_size = 0;
+          bool    filled = false;
+
           void add_query (ustring);
+          void refresh () override;
+
+          bool match (const ustring&, const
+              Gtk::TreeModel::const_iterator&) override;
+
           bool on_match_selected(const Gtk::TreeModel::iterator& iter) override;
       };
 
       refptr<SearchTextCompletion> text_search_completion;
+
+      /********************
+       * Recipient completion
+       ********************/
+      void start_recipients (ustring);
+
+      class ContactCompletion : public GenericCompletion {
+        public:
+          ContactCompletion ();
+
+          // tree model columns, for the EntryCompletion's filter model
+          class ModelColumns : public Gtk::TreeModel::ColumnRecord
+          {
+            public:
+
+              ModelColumns ()
+              { add(m_address); }
+
+              Gtk::TreeModelColumn<Glib::ustring> m_address;
+          };
+
+          ModelColumns m_columns;
+
+          unsigned int max_contacts = 20;
+
+          ustring filled_key;
+          bool    filled = false;
+
+          ustring get_partial_address (ustring_sz &);
+
+          void refresh () override;
+
+          bool match (const ustring&, const
+              Gtk::TreeModel::const_iterator&) override;
+
+          bool on_match_selected(const Gtk::TreeModel::iterator& iter) override;
+      };
+
+      refptr<ContactCompletion> contact_completion;
   };
 }
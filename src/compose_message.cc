@@ -346,6 +346,7 @@ namespace Astroid {
 
         if (a->is_mime_message) {
 
+          a->message->ensure_loaded ();
           GMimeMessagePart * mp = g_mime_message_part_new_with_message ("rfc822", (GMimeMessage*) a->message->message);
           g_mime_multipart_add (multipart, (GMimeObject *) mp);
 
@@ -169,10 +169,16 @@ namespace Astroid {
     default_config.put ("astroid.notmuch_config" , nm_cfg);
 
     default_config.put ("astroid.debug.dryrun_sending", false);
+    default_config.put ("astroid.debug.db_lock_warn", 5000); // ms, dump db lock holders if waiting longer
 
     /* only show hints with a level higher than this */
     default_config.put ("astroid.hints.level", 0);
 
+    /* plugins */
+    default_config.put ("astroid.plugins.memoize", true); // keep results of format_tags and get_tag_colors
+    default_config.put ("astroid.plugins.process_cache", 32);   // MB of processed messages to keep, 0 to disable
+    default_config.put ("astroid.plugins.process_workers", 4);  // messages of a thread processed in parallel (python plugins only)
+
     default_config.put ("astroid.log.syslog", false);
     default_config.put ("astroid.log.stdout", true);
 
@@ -193,12 +199,16 @@ namespace Astroid {
     /* thread index */
     default_config.put ("thread_index.page_jump_rows", 6);
     default_config.put ("thread_index.sort_order", "newest");
+    default_config.put ("thread_index.cache_queries", 10); // recent query results kept for new tabs, 0 to disable
+    default_config.put ("thread_index.disk_cache", false); // keep the startup queries on disk between sessions
+    default_config.put ("thread_index.loader_slots", 2); // queries loaded at the same time
 
     default_config.put ("general.time.clock_format", "local"); // or 24h, 12h
     default_config.put ("general.time.same_year", "%b %-e");
     default_config.put ("general.time.diff_year", "%x");
 
     default_config.put ("general.tagbar_move", "tag");
+    default_config.put ("general.mmap_threshold", 4 * 1024 * 1024); // bytes, messages larger than this are mapped rather than read, 0 to disable
 
     /* thread index cell theme */
     default_config.put ("thread_index.cell.font_description", "default");
@@ -254,10 +264,21 @@ namespace Astroid {
     default_config.put ("mail.close_on_success", false); // close page automatically on succesful sending of message
     default_config.put ("mail.format_flowed", false); // mail sent with astroid can be reformatted using format_flowed
 
+    /* recipient completion */
+    default_config.put ("mail.contacts.enable", true);    // index the addresses in the database in the background
+    default_config.put ("mail.contacts.batch", 2000);     // about this many messages read per database session when building the index
+    default_config.put ("mail.contacts.half_life", 180);  // days, weight of a contact is halved when not seen for this long
+
     /* polling */
     default_config.put ("poll.interval", Poll::DEFAULT_POLL_INTERVAL); // seconds
     default_config.put ("poll.always_full_refresh", false); // always do full refresh after poll, slow.
 
+    /* watch the database for changes by external programs, and refresh
+     * changed threads without waiting for the next poll. */
+    default_config.put ("poll.watch.database", false);
+    default_config.put ("poll.watch.maildir", false); // run the poll command (spawns it, to index the mail) when mail is delivered to a maildir (new/)
+    default_config.put ("poll.watch.delay", 500); // ms, events within this time are coalesced
+
     /* attachments
      *
      *   a chunk is saved and opened with this command */
@@ -290,11 +311,17 @@ namespace Astroid {
 
     /* expand flagged messages by default */
     default_config.put ("thread_view.expand_flagged", true);
+    default_config.put ("thread_view.parsed_budget", 256); // MB of parsed messages to keep, collapsed messages beyond this are parsed again when needed. 0 is unlimited
 
     /* crypto */
     default_config.put ("crypto.gpg.path", "gpg2");
     default_config.put ("crypto.gpg.always_trust", true);
     default_config.put ("crypto.gpg.enabled", true);
+    default_config.put ("crypto.gpg.session_keys.cache", false);   // keep session keys of decrypted parts in memory
+    default_config.put ("crypto.gpg.session_keys.persist", false); // and on disk between sessions (in a private directory)
+    default_config.put ("crypto.gpg.session_keys.ttl", 3600);      // seconds, 0 keeps them until purged
+    default_config.put ("crypto.gpg.workers", 4);                  // parallel signature verifications, 0 for one per cpu
+    default_config.put ("crypto.gpg.signature_cache", 1000);       // verification results of signed parts to keep, 0 to disable
 
     /* saved searches */
     default_config.put ("saved_searches.show_on_startup", false);
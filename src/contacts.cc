@@ -0,0 +1,335 @@
+# include <algorithm>
+# include <chrono>
+# include <ctime>
+
+# include "astroid.hh"
+# include "config.hh"
+# include "db.hh"
+# include "account_manager.hh"
+# include "contacts.hh"
+# include "utils/address.hh"
+
+using namespace std;
+
+namespace Astroid {
+  bool              Contacts::enabled = false;
+  unsigned int      Contacts::batch   = 2000;
+  bfs::path         Contacts::index_file;
+  ContactIndex      Contacts::index;
+
+  std::mutex        Contacts::m;
+  std::thread       Contacts::worker;
+  bool              Contacts::running = false;
+  bool              Contacts::pending = false;
+  std::atomic<bool> Contacts::stop (false);
+
+  bool              Contacts::loaded = false;
+  std::string       Contacts::uuid;
+  unsigned long     Contacts::revision = 0;
+
+  void Contacts::init () {
+    ptree c = astroid->config ("mail.contacts");
+
+    enabled         = c.get<bool> ("enable");
+    batch           = std::max (1u, c.get<unsigned int> ("batch"));
+    index.half_life = c.get<double> ("half_life") * 24 * 3600;
+    index_file      = astroid->standard_paths ().cache_dir / bfs::path ("contacts.index");
+
+    update ();
+  }
+
+  void Contacts::destruct () {
+    if (!enabled) return;
+
+    stop = true;
+
+    {
+      std::lock_guard<std::mutex> lk (m);
+      pending = false;
+    }
+
+    if (worker.joinable ()) worker.join ();
+
+    save ();
+  }
+
+  void Contacts::update () {
+    if (!enabled || stop) return;
+
+    std::lock_guard<std::mutex> lk (m);
+
+    if (running) {
+      /* the worker catches up once more when it is done */
+      pending = true;
+      return;
+    }
+
+    if (worker.joinable ()) worker.join (); // finished
+
+    running = true;
+    worker  = std::thread (&Contacts::run);
+  }
+
+  void Contacts::run () {
+    if (!loaded) {
+      auto t0 = std::chrono::steady_clock::now ();
+
+      uint64_t r = 0;
+      boost::system::error_code ec;
+      if (bfs::is_regular_file (index_file, ec) && index.load (index_file.string (), uuid, r)) {
+        revision = r;
+
+        LOG (info) << "contacts: loaded " << index.size () << " contacts from index in: " << std::chrono::duration<double, std::milli> (std::chrono::steady_clock::now () - t0).count () << " ms.";
+      }
+
+      loaded = true;
+    }
+
+    std::unique_lock<std::mutex> lk (m);
+
+    do {
+      pending = false;
+      lk.unlock ();
+
+      catch_up ();
+
+      lk.lock ();
+    } while (pending && !stop);
+
+    running = false;
+  }
+
+  void Contacts::catch_up () {
+    std::string   u;
+    unsigned long revnow;
+
+    {
+      Db db (Db::DATABASE_READ_ONLY);
+      u      = db.get_uuid ();
+      revnow = db.get_revision ();
+    }
+
+    if (u != uuid || revision > revnow) {
+      if (!uuid.empty ()) {
+        LOG (info) << "contacts: index is for a different database, rebuilding.";
+      }
+
+      index.clear ();
+      uuid     = u;
+      revision = 0;
+    }
+
+    if (revision == revnow && revision > 0) return;
+
+    auto t0 = std::chrono::steady_clock::now ();
+    size_t n0 = index.messages ();
+
+    if (revision == 0) {
+      /* an interrupted build is continued on the next start, the messages
+       * already counted are skipped */
+      if (!build ()) return;
+
+    } else {
+      Db db (Db::DATABASE_READ_ONLY);
+
+      ustring query = ustring::compose ("lastmod:%1..%2", revision, revnow);
+
+      notmuch_query_t * qry = notmuch_query_create (db.nm_db, query.c_str ());
+      notmuch_messages_t * messages;
+      notmuch_status_t st = notmuch_query_search_messages (qry, &messages);
+
+      for (;
+           (st == NOTMUCH_STATUS_SUCCESS) && !stop && notmuch_messages_valid (messages);
+           notmuch_messages_move_to_next (messages)) {
+
+        notmuch_message_t * message = notmuch_messages_get (messages);
+        add_message (message);
+        notmuch_message_destroy (message);
+      }
+
+      notmuch_query_destroy (qry);
+
+      if (stop) return;
+    }
+
+    bool built = (revision == 0);
+    revision = revnow;
+
+    LOG (info) << "contacts: indexed " << (index.messages () - n0) << " messages (" << index.size () << " contacts, revision: " << revnow << ") in: " << std::chrono::duration<double, std::milli> (std::chrono::steady_clock::now () - t0).count () << " ms.";
+
+    /* do not lose a long build if astroid does not exit cleanly */
+    if (built) save ();
+  }
+
+  bool Contacts::build () {
+    LOG (info) << "contacts: building index..";
+
+    /* the database is read in windows of time, newest first, and released
+     * in between so that writers are not held up for the whole build. the
+     * windows do not overlap and each query only matches its own window, so
+     * no message is skipped and the total work does not grow with the number
+     * of windows. the window is resized to hold about a batch of messages. */
+    time_t oldest = 0;
+    time_t newest = 0;
+
+    {
+      Db db (Db::DATABASE_READ_ONLY);
+
+      auto first_date = [&] (notmuch_sort_t sort, time_t & date) {
+        notmuch_query_t * qry = notmuch_query_create (db.nm_db, "*");
+        notmuch_query_set_sort (qry, sort);
+
+        notmuch_messages_t * messages;
+        bool found = (notmuch_query_search_messages (qry, &messages) == NOTMUCH_STATUS_SUCCESS) && notmuch_messages_valid (messages);
+
+        if (found) {
+          notmuch_message_t * message = notmuch_messages_get (messages);
+          date = notmuch_message_get_date (message);
+          notmuch_message_destroy (message);
+        }
+
+        notmuch_query_destroy (qry);
+        return found;
+      };
+
+      if (!first_date (NOTMUCH_SORT_OLDEST_FIRST, oldest)) return true; // empty
+      first_date (NOTMUCH_SORT_NEWEST_FIRST, newest);
+    }
+
+    const time_t max_span = 10 * 365 * 24 * 3600;
+    time_t span  = 30 * 24 * 3600;
+    time_t hi    = newest;
+    bool   first = true;
+
+    while (!stop) {
+      time_t lo   = hi - span + 1;
+      bool   last = (lo <= oldest);
+
+      /* the first and last windows are open, in case dates are added
+       * meanwhile */
+      ustring query;
+      if (first && last) query = "*";
+      else if (first)    query = ustring::compose ("date:@%1..", lo);
+      else if (last)     query = ustring::compose ("date:..@%1", hi);
+      else               query = ustring::compose ("date:@%1..@%2", lo, hi);
+
+      Db db (Db::DATABASE_READ_ONLY);
+
+      notmuch_query_t * qry = notmuch_query_create (db.nm_db, query.c_str ());
+      notmuch_query_set_sort (qry, NOTMUCH_SORT_UNSORTED);
+
+      notmuch_messages_t * messages;
+      notmuch_status_t st = notmuch_query_search_messages (qry, &messages);
+
+      if (st != NOTMUCH_STATUS_SUCCESS) {
+        LOG (error) << "contacts: could not query: " << query << ", status: " << notmuch_status_to_string (st);
+        notmuch_query_destroy (qry);
+        return false;
+      }
+
+      unsigned int n = 0;
+
+      for (; !stop && notmuch_messages_valid (messages);
+             notmuch_messages_move_to_next (messages), n++) {
+
+        notmuch_message_t * message = notmuch_messages_get (messages);
+        add_message (message);
+        notmuch_message_destroy (message);
+      }
+
+      notmuch_query_destroy (qry);
+
+      if (stop) return false;
+      if (last) return true;
+
+      if (n > 2 * batch) {
+        span = std::max<time_t> (1, span / 2);
+      } else if (n < batch / 2) {
+        span = std::min (max_span, span * 2);
+      }
+
+      hi    = lo - 1;
+      first = false;
+    }
+
+    return false;
+  }
+
+  bool Contacts::add_message (notmuch_message_t * message) {
+    const char * mid = notmuch_message_get_message_id (message);
+    if (mid == NULL || !index.count_message (mid)) return false;
+
+    int64_t date = notmuch_message_get_date (message);
+
+    auto add = [&] (const char * header) {
+      const char * h = notmuch_message_get_header (message, header);
+      if (h == NULL || *h == '\0') return;
+
+      for (Address a : AddressList (h).addresses) {
+        if (a.email ().empty () || astroid->accounts->is_me (a)) continue;
+        index.add (a.email (), a.name (), date);
+      }
+    };
+
+    add ("from");
+
+    /* the recipients of the messages we have sent */
+    bool sent = false;
+    notmuch_tags_t * tags = notmuch_message_get_tags (message);
+    for (; !sent && notmuch_tags_valid (tags); notmuch_tags_move_to_next (tags)) {
+      ustring t = notmuch_tags_get (tags);
+      sent = std::find (Db::sent_tags.begin (), Db::sent_tags.end (), t) != Db::sent_tags.end ();
+    }
+    notmuch_tags_destroy (tags);
+
+    if (sent) {
+      add ("to");
+      add ("cc");
+    }
+
+    return true;
+  }
+
+  void Contacts::save () {
+    if (!loaded || uuid.empty ()) return;
+
+    /* this runs on exit, errors are logged rather than thrown */
+    boost::system::error_code ec;
+    bfs::create_directories (index_file.parent_path (), ec);
+    if (ec) {
+      LOG (error) << "contacts: could not create cache directory: " << index_file.parent_path ().c_str () << ": " << ec.message ();
+      return;
+    }
+
+    if (index.save (index_file.string (), uuid, revision)) {
+      LOG (info) << "contacts: saved " << index.size () << " contacts to: " << index_file.c_str ();
+    } else {
+      LOG (error) << "contacts: could not save index: " << index_file.c_str ();
+    }
+  }
+
+  std::vector<ustring> Contacts::lookup (ustring key, unsigned int max) {
+    std::vector<ustring> out;
+    if (!enabled) return out;
+
+    int64_t now = time (NULL);
+
+    auto add = [&] (const ContactIndex::Contact & c) {
+      ustring a = Address (c.name, c.email).full_address ();
+      if (std::find (out.begin (), out.end (), a) == out.end ()) out.push_back (a);
+    };
+
+    for (auto & c : index.lookup (key, max, now)) add (c);
+
+    /* fill up with fuzzy matches */
+    if (!key.empty () && out.size () < max) {
+      for (auto & c : index.fuzzy (key, max, now)) {
+        if (out.size () >= max) break;
+        add (c);
+      }
+    }
+
+    return out;
+  }
+}
+
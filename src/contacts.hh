@@ -0,0 +1,65 @@
+# pragma once
+
+# include <mutex>
+# include <thread>
+# include <atomic>
+# include <vector>
+# include <boost/filesystem.hpp>
+
+# include <notmuch.h>
+
+# include "astroid.hh"
+# include "proto.hh"
+# include "utils/contact_index.hh"
+
+namespace bfs = boost::filesystem;
+
+namespace Astroid {
+  /* the addresses seen in the database, for completing recipients.
+   *
+   * the index is kept in the cache directory and brought up to date in
+   * the background on start up: a new index is built from all messages,
+   * newest first, while an existing index only needs the messages changed
+   * since the revision it was saved at (lastmod:). after every poll the
+   * changed messages are added the same way.
+   *
+   * senders are taken from all messages, recipients only from the messages
+   * we have sent since reading them requires the message file. the database
+   * is read in windows of time of about a batch of messages when building,
+   * so that writers are not held up for the whole build. */
+  class Contacts {
+    public:
+      static void init ();
+      static void destruct (); // stop updating and save the index
+
+      /* catch up with the database in the background */
+      static void update ();
+
+      /* full addresses for key: prefix matches first, then fuzzy matches */
+      static std::vector<ustring> lookup (ustring key, unsigned int max = 20);
+
+    private:
+      static bool         enabled;
+      static unsigned int batch;
+      static bfs::path    index_file;
+      static ContactIndex index;
+
+      static std::mutex        m;
+      static std::thread       worker;
+      static bool              running;
+      static bool              pending;
+      static std::atomic<bool> stop;
+
+      /* only touched by the worker, or after it has stopped */
+      static bool          loaded;
+      static std::string   uuid;
+      static unsigned long revision; // the index is up to date with this
+
+      static void run ();
+      static void catch_up ();
+      static bool build ();
+      static bool add_message (notmuch_message_t *);
+      static void save ();
+  };
+}
+
@@ -3,6 +3,14 @@
 # include "utils/gmime/gmime-compat.h"
 
 # include <string>
+# include <fstream>
+# include <algorithm>
+# include <cstdlib>
+# include <cstring>
+# include <cerrno>
+# include <sys/stat.h>
+# include <fcntl.h>
+# include <unistd.h>
 
 # include <boost/algorithm/string.hpp>
 
@@ -51,17 +59,31 @@ namespace Astroid {
   Crypto::~Crypto () {
     LOG (debug) << "crypto: deconstruct.";
 
+    /* a queued verification still writes to this object */
+    wait ();
+
     /* if (slist)        g_object_unref (slist); */
     /* if (rlist)        g_object_unref (rlist); */
+    if (own_slist && slist) g_object_unref (slist);
     if (decrypt_res)  g_object_unref (decrypt_res);
     if (gpgctx)       g_object_unref (gpgctx);
   }
 
   GMimeObject * Crypto::decrypt_and_verify (GMimeObject * part) {
-    using std::endl;
     LOG (debug) << "crypto: decrypting and verifiying..";
     decrypt_tried = true;
 
+    /* the decrypted part is needed to build the rest of the chunk tree, so
+     * it is decrypted right here rather than queued behind the
+     * verifications on the crypto workers. */
+    return decrypt_part (gpgctx, part);
+  }
+
+  GMimeObject * Crypto::decrypt_part (GMimeCryptoContext * gpgctx, GMimeObject * part) {
+# if (GMIME_MAJOR_VERSION >= 3)
+    (void) gpgctx; // gmime 3 creates its own context
+# endif
+
     if (!GMIME_IS_MULTIPART_ENCRYPTED (part)) {
       LOG (error) << "crypto: part is not encrypted.";
       return NULL;
@@ -70,8 +92,45 @@ namespace Astroid {
     GError *err = NULL;
 
     GMimeMultipartEncrypted * ep = GMIME_MULTIPART_ENCRYPTED (part);
-    GMimeObject * dp = g_mime_multipart_encrypted_decrypt
+    GMimeObject * dp = NULL;
+
+# if (GMIME_MAJOR_VERSION >= 3)
+    std::string digest;
+    if (cache_session_keys) {
+      digest = encrypted_digest (ep);
+      std::string session_key = get_session_key (digest);
+
+      if (!session_key.empty ()) {
+        dp = g_mime_multipart_encrypted_decrypt
+          (ep, GMIME_DECRYPT_NONE, session_key.c_str (), &decrypt_res, &err);
+
+        if (dp == NULL) {
+          LOG (warn) << "crypto: could not decrypt with cached session key, trying private key..";
+          g_clear_error (&err);
+          if (decrypt_res) {
+            g_object_unref (decrypt_res);
+            decrypt_res = NULL;
+          }
+        } else {
+          LOG (debug) << "crypto: decrypted using cached session key.";
+        }
+      }
+    }
+
+    if (dp == NULL) {
+      dp = g_mime_multipart_encrypted_decrypt
+        (ep, cache_session_keys ? GMIME_DECRYPT_EXPORT_SESSION_KEY : GMIME_DECRYPT_NONE,
+         NULL, &decrypt_res, &err);
+
+      if (dp != NULL && cache_session_keys && decrypt_res) {
+        const char * sk = g_mime_decrypt_result_get_session_key (decrypt_res);
+        if (sk != NULL) add_session_key (digest, sk);
+      }
+    }
+# else
+    dp = g_mime_multipart_encrypted_decrypt
 	(ep, GMIME_DECRYPT_NONE, NULL, &decrypt_res, &err);
+# endif
 
     /* GMimeDecryptResult and GMimeCertificates
      *
@@ -192,15 +251,80 @@ namespace Astroid {
   }
 
   bool Crypto::verify_signature (GMimeObject * mo) {
-    GError * err = NULL;
+    verify_signature_async (mo);
+    wait ();
 
+    return verified;
+  }
+
+  void Crypto::verify_signature_async (GMimeObject * mo) {
     verify_tried = true;
 
-    slist = g_mime_multipart_signed_verify (GMIME_MULTIPART_SIGNED(mo), GMIME_VERIFY_NONE, &err);
+    /* the parts of a message are read from the stream the message was
+     * parsed from, the worker verifies a private copy so that it does not
+     * race with the chunks that are built from the original meanwhile. */
+    GMimeStream * copy = g_mime_stream_mem_new ();
+    g_mime_object_write_to_stream (mo, NULL, copy);
+    g_mime_stream_seek (copy, 0, GMIME_STREAM_SEEK_SET);
 
-    verified = verify_signature_list (slist);
+    std::string key;
+    if (max_signatures > 0) {
+      GByteArray * b = g_mime_stream_mem_get_byte_array (GMIME_STREAM_MEM (copy));
 
-    return verified;
+      key = Glib::Checksum::compute_checksum (Glib::Checksum::ChecksumType::CHECKSUM_SHA256,
+          std::string ((const char *) b->data, b->len)) + ":" + keyring_stamp ();
+
+      GMimeSignatureList * cached = get_signatures (key);
+      if (cached != NULL) {
+        LOG (debug) << "crypto: using cached signature verification.";
+        g_object_unref (copy);
+
+        slist     = cached;
+        own_slist = true;
+        verified  = verify_signature_list (slist);
+        return;
+      }
+    }
+
+    pending = submit ("verify", [this, copy, key] (GMimeCryptoContext * gpgctx) {
+# if (GMIME_MAJOR_VERSION >= 3)
+        (void) gpgctx; // gmime 3 creates its own context
+# endif
+        GMimeParser * parser = g_mime_parser_new_with_stream (copy);
+        GMimeObject * sp = g_mime_parser_construct_part (parser, NULL);
+        g_object_unref (parser);
+        g_object_unref (copy);
+
+        if (sp == NULL || !GMIME_IS_MULTIPART_SIGNED (sp)) {
+          LOG (error) << "crypto: could not copy signed part.";
+          if (sp) g_object_unref (sp);
+          return;
+        }
+
+        GError * err = NULL;
+        slist = g_mime_multipart_signed_verify (GMIME_MULTIPART_SIGNED(sp), GMIME_VERIFY_NONE, &err);
+        own_slist = true;
+
+        if (err != NULL) {
+          LOG (warn) << "crypto: failed to verify signature: " << err->message;
+          g_error_free (err);
+        }
+
+        verified = verify_signature_list (slist);
+
+        if (slist != NULL && !key.empty ()) add_signatures (key, slist);
+
+        g_object_unref (sp);
+      }).share ();
+  }
+
+  void Crypto::wait () {
+    if (pending.valid ()) pending.wait ();
+  }
+
+  bool Crypto::verifying () {
+    return pending.valid () &&
+      pending.wait_for (std::chrono::seconds (0)) != std::future_status::ready;
   }
 
   bool Crypto::verify_signature_list (GMimeSignatureList * list) {
@@ -285,6 +409,19 @@ namespace Astroid {
   }
 
   bool Crypto::create_gpg_context () {
+    gpgctx = new_gpg_context (gpgpath, always_trust);
+
+    if (! gpgctx) {
+      LOG (error) << "crypto: failed to create gpg context.";
+      return false;
+    }
+
+
+    return true;
+  }
+
+  GMimeCryptoContext * Crypto::new_gpg_context (ustring gpgpath, bool always_trust) {
+    GMimeCryptoContext * gpgctx = NULL;
 
     if (!astroid->in_test ()) {
 
@@ -307,14 +444,360 @@ namespace Astroid {
 # endif
     }
 
+    return gpgctx;
+  }
+
+  /* signature cache {{{ */
+  std::mutex   Crypto::signatures_m;
+  std::list<std::pair<std::string, GMimeSignatureList *>> Crypto::signatures;
+  std::map<std::string, std::list<std::pair<std::string, GMimeSignatureList *>>::iterator> Crypto::signatures_index;
+  unsigned int Crypto::max_signatures = 0;
+
+  std::string Crypto::keyring_stamp () {
+    /* the verification result depends on the keys and their trust, use the
+     * latest modification of the keyring files. */
+    const char * gh = getenv ("GNUPGHOME");
+    bfs::path home = (gh != NULL) ? bfs::path (gh) : (astroid->standard_paths ().home / bfs::path (".gnupg"));
+
+    time_t stamp = 0;
+    for (auto f : { "pubring.kbx", "pubring.gpg", "trustdb.gpg" }) {
+      struct stat st;
+      if (stat ((home / bfs::path (f)).c_str (), &st) == 0) {
+        stamp = std::max (stamp, st.st_mtime);
+      }
+    }
+
+    return std::to_string (stamp);
+  }
+
+  GMimeSignatureList * Crypto::get_signatures (std::string key) {
+    std::lock_guard<std::mutex> lk (signatures_m);
+
+    auto f = signatures_index.find (key);
+    if (f == signatures_index.end ()) return NULL;
+
+    /* most recently used first */
+    signatures.splice (signatures.begin (), signatures, f->second);
+
+    /* the caller holds a reference, the entry may be evicted */
+    g_object_ref (f->second->second);
+
+    return f->second->second;
+  }
+
+  void Crypto::add_signatures (std::string key, GMimeSignatureList * list) {
+    std::lock_guard<std::mutex> lk (signatures_m);
+
+    if (signatures_index.find (key) != signatures_index.end ()) return;
+
+    g_object_ref (list);
+    signatures.push_front (std::make_pair (key, list));
+    signatures_index[key] = signatures.begin ();
+
+    while (signatures.size () > max_signatures) {
+      auto & o = signatures.back ();
+      signatures_index.erase (o.first);
+      g_object_unref (o.second);
+      signatures.pop_back ();
+    }
+  }
+
+  void Crypto::clear_signatures () {
+    std::lock_guard<std::mutex> lk (signatures_m);
+
+    for (auto & o : signatures) g_object_unref (o.second);
+    signatures.clear ();
+    signatures_index.clear ();
+  }
+  /* }}} */
+
+  /* crypto workers {{{ */
+  std::mutex               Crypto::workers_m;
+  std::condition_variable  Crypto::workers_cv;
+  std::deque<Crypto::Task> Crypto::tasks;
+  std::vector<std::thread> Crypto::workers;
+  bool                     Crypto::workers_stop = false;
+  int                      Crypto::n_workers    = 1;
+  ustring                  Crypto::workers_gpgpath;
+  bool                     Crypto::workers_always_trust = false;
+
+  std::future<void> Crypto::submit (ustring what, Job job) {
+    Task t;
+    t.what   = what;
+    t.job    = job;
+    t.queued = std::chrono::steady_clock::now ();
+
+    std::future<void> f = t.done.get_future ();
+
+    std::lock_guard<std::mutex> lk (workers_m);
+    if (workers.empty ()) start_workers ();
+
+    tasks.push_back (std::move (t));
+    workers_cv.notify_one ();
+
+    return f;
+  }
+
+  void Crypto::start_workers () {
+    /* workers_m is held */
+    LOG (debug) << "crypto: starting " << n_workers << " workers..";
+
+    workers_stop = false;
+    for (int i = 0; i < n_workers; i++) {
+      workers.push_back (std::thread (&Crypto::worker));
+    }
+  }
+
+  void Crypto::stop_workers () {
+    std::vector<std::thread> ws;
+
+    {
+      std::lock_guard<std::mutex> lk (workers_m);
+      workers_stop = true;
+      ws.swap (workers);
+    }
+
+    workers_cv.notify_all ();
+
+    /* the queued jobs are finished first */
+    for (auto &w : ws) w.join ();
+  }
+
+  void Crypto::worker () {
+    GMimeCryptoContext * gpgctx = NULL;
+
+# if (GMIME_MAJOR_VERSION < 3)
+    gpgctx = new_gpg_context (workers_gpgpath, workers_always_trust);
     if (! gpgctx) {
-      LOG (error) << "crypto: failed to create gpg context.";
-      return false;
+      LOG (error) << "crypto: worker: failed to create gpg context.";
     }
+# endif
 
+    while (true) {
+      Task t;
 
-    return true;
+      {
+        std::unique_lock<std::mutex> lk (workers_m);
+        workers_cv.wait (lk, [] { return workers_stop || !tasks.empty (); });
+
+        if (tasks.empty ()) break;
+
+        t = std::move (tasks.front ());
+        tasks.pop_front ();
+      }
+
+      auto start = std::chrono::steady_clock::now ();
+
+      t.job (gpgctx);
+
+      auto end = std::chrono::steady_clock::now ();
+
+      LOG (debug) << "crypto: " << t.what << ": waited "
+        << std::chrono::duration_cast<std::chrono::milliseconds> (start - t.queued).count ()
+        << " ms, took "
+        << std::chrono::duration_cast<std::chrono::milliseconds> (end - start).count ()
+        << " ms.";
+
+      t.done.set_value ();
+    }
+
+    if (gpgctx) g_object_unref (gpgctx);
+  }
+  /* }}} */
+
+  /* session key cache {{{ */
+  std::mutex  Crypto::session_keys_m;
+  std::map<std::string, Crypto::SessionKey> Crypto::session_keys;
+  bool        Crypto::cache_session_keys   = false;
+  bool        Crypto::persist_session_keys = false;
+  int         Crypto::session_key_ttl      = 0;
+  bfs::path   Crypto::session_keys_file;
+
+  void Crypto::init () {
+    ptree c = astroid->config ("crypto.gpg");
+
+    cache_session_keys   = c.get<bool> ("session_keys.cache");
+    persist_session_keys = c.get<bool> ("session_keys.persist") && cache_session_keys;
+    session_key_ttl      = c.get<int>  ("session_keys.ttl");
+    session_keys_file    = astroid->standard_paths ().data_dir / bfs::path ("private/session-keys");
+
+    n_workers = c.get<int> ("workers");
+    if (n_workers <= 0) {
+      n_workers = std::max (1u, std::thread::hardware_concurrency ());
+    }
+
+    max_signatures = std::max (0, c.get<int> ("signature_cache"));
+
+    workers_gpgpath      = ustring (c.get<std::string> ("path"));
+    workers_always_trust = c.get<bool> ("always_trust");
+
+# if (GMIME_MAJOR_VERSION < 3)
+    if (cache_session_keys) {
+      LOG (warn) << "crypto: caching session keys needs gmime 3, disabled.";
+      cache_session_keys   = false;
+      persist_session_keys = false;
+    }
+# endif
+
+    if (persist_session_keys && !session_keys_dir_private ()) {
+      LOG (warn) << "crypto: " << session_keys_file.parent_path ().c_str () << " is not private to the user, session keys will not be kept on disk.";
+      persist_session_keys = false;
+    }
+
+    if (persist_session_keys) load_session_keys ();
+  }
+
+  void Crypto::destruct () {
+    stop_workers ();
+    clear_signatures ();
+
+    if (persist_session_keys) save_session_keys ();
+
+    std::lock_guard<std::mutex> lk (session_keys_m);
+    session_keys.clear ();
+  }
+
+  void Crypto::purge_session_keys () {
+    LOG (info) << "crypto: purging session keys.";
+
+    std::lock_guard<std::mutex> lk (session_keys_m);
+    session_keys.clear ();
+
+    if (bfs::exists (session_keys_file)) bfs::remove (session_keys_file);
+  }
+
+  std::string Crypto::encrypted_digest (GMimeMultipartEncrypted * ep) {
+    /* the encrypted content (second part) identifies the session key */
+    GMimeObject * enc = g_mime_multipart_get_part (GMIME_MULTIPART (ep), GMIME_MULTIPART_ENCRYPTED_CONTENT);
+    if (enc == NULL) return "";
+
+    char * s = g_mime_object_to_string (enc, NULL);
+    std::string digest = Glib::Checksum::compute_checksum (Glib::Checksum::ChecksumType::CHECKSUM_SHA256, std::string (s));
+    g_free (s);
+
+    return digest;
+  }
+
+  std::string Crypto::get_session_key (std::string digest) {
+    if (digest.empty ()) return "";
+
+    std::lock_guard<std::mutex> lk (session_keys_m);
+
+    auto f = session_keys.find (digest);
+    if (f == session_keys.end ()) return "";
+
+    if (session_key_ttl > 0 && (time (NULL) - f->second.added) > session_key_ttl) {
+      LOG (debug) << "crypto: session key expired.";
+      session_keys.erase (f);
+      return "";
+    }
+
+    return f->second.key;
+  }
+
+  void Crypto::add_session_key (std::string digest, std::string key) {
+    if (digest.empty ()) return;
+
+    std::lock_guard<std::mutex> lk (session_keys_m);
+    session_keys[digest] = { key, time (NULL) };
+  }
+
+  void Crypto::load_session_keys () {
+    std::ifstream f (session_keys_file.c_str ());
+    if (!f.good ()) return;
+
+    std::lock_guard<std::mutex> lk (session_keys_m);
+
+    time_t now = time (NULL);
+    std::string digest, key;
+    time_t added;
+
+    while (f >> digest >> added >> key) {
+      if (session_key_ttl > 0 && (now - added) > session_key_ttl) continue;
+      session_keys[digest] = { key, added };
+    }
+
+    LOG (debug) << "crypto: loaded " << session_keys.size () << " session keys.";
+  }
+
+  bool Crypto::session_keys_dir_private () {
+    bfs::path dir = session_keys_file.parent_path ();
+
+    /* created private, an existing directory must be owned by the user and
+     * not be accessible by anyone else */
+    if (mkdir (dir.c_str (), 0700) != 0 && errno != EEXIST) {
+      if (errno != ENOENT) return false;
+
+      bfs::create_directories (dir.parent_path ());
+      if (mkdir (dir.c_str (), 0700) != 0 && errno != EEXIST) return false;
+    }
+
+    struct stat st;
+    if (lstat (dir.c_str (), &st) != 0) return false;
+
+    return S_ISDIR (st.st_mode) && st.st_uid == geteuid () && (st.st_mode & 077) == 0;
+  }
+
+  void Crypto::save_session_keys () {
+    std::lock_guard<std::mutex> lk (session_keys_m);
+
+    if (session_keys.empty ()) {
+      if (bfs::exists (session_keys_file)) bfs::remove (session_keys_file);
+      return;
+    }
+
+    if (!session_keys_dir_private ()) {
+      LOG (warn) << "crypto: " << session_keys_file.parent_path ().c_str () << " is not private to the user, not saving session keys.";
+      return;
+    }
+
+    std::string out;
+    time_t now = time (NULL);
+    for (auto &k : session_keys) {
+      if (session_key_ttl > 0 && (now - k.second.added) > session_key_ttl) continue;
+      out += k.first + " " + std::to_string (k.second.added) + " " + k.second.key + "\n";
+    }
+
+    /* only readable by the user, also if the file already existed. written
+     * to a temporary file and moved in place so that the keys are never
+     * partially written. */
+    std::string tmp = session_keys_file.string () + ".tmp";
+
+    int fd = ::open (tmp.c_str (), O_CREAT | O_TRUNC | O_WRONLY | O_NOFOLLOW | O_CLOEXEC, 0600);
+    if (fd < 0) {
+      LOG (error) << "crypto: could not save session keys: " << tmp << ": " << strerror (errno);
+      return;
+    }
+
+    bool ok = (fchmod (fd, 0600) == 0);
+
+    const char * p = out.data ();
+    size_t left = out.size ();
+    while (ok && left > 0) {
+      ssize_t n = ::write (fd, p, left);
+      if (n < 0 && errno == EINTR) continue;
+      if (n <= 0) {
+        ok = false;
+        break;
+      }
+
+      p    += n;
+      left -= n;
+    }
+
+    ok = ok && (fsync (fd) == 0);
+    ok = (::close (fd) == 0) && ok;
+    ok = ok && (rename (tmp.c_str (), session_keys_file.c_str ()) == 0);
+
+    if (!ok) {
+      LOG (error) << "crypto: could not save session keys: " << session_keys_file.c_str () << ": " << strerror (errno);
+      unlink (tmp.c_str ());
+      return;
+    }
+
+    LOG (debug) << "crypto: saved session keys to: " << session_keys_file.c_str ();
   }
+  /* }}} */
 
   ustring Crypto::get_md5_digest (ustring str) {
     std::string cs = Glib::Checksum::compute_checksum (Glib::Checksum::ChecksumType::CHECKSUM_MD5, str);
@@ -1,13 +1,25 @@
 # pragma once
 
+# include <mutex>
+# include <map>
+# include <list>
+# include <deque>
+# include <vector>
+# include <thread>
+# include <future>
+# include <functional>
+# include <condition_variable>
+# include <chrono>
 # include <gmime/gmime.h>
 # include <boost/property_tree/ptree.hpp>
+# include <boost/filesystem.hpp>
 
 # include "astroid.hh"
 # include "utils/address.hh"
 # include "proto.hh"
 
 using boost::property_tree::ptree;
+namespace bfs = boost::filesystem;
 
 namespace Astroid {
   class Crypto : public Glib::Object {
@@ -27,6 +39,13 @@ namespace Astroid {
 
       bool verify_signature (GMimeObject * mo);
 
+      /* queue the verification on the crypto workers and return at once,
+       * the results (verified, slist) are valid after wait () or once
+       * verifying () is false. */
+      void verify_signature_async (GMimeObject * mo);
+      void wait ();
+      bool verifying (); // the verification has not finished yet
+
       bool encrypt (GMimeObject * mo,
                     bool sign,
                     ustring userid,
@@ -66,6 +85,92 @@ namespace Astroid {
 
       bool verify_signature_list (GMimeSignatureList *);
 
+      GMimeObject * decrypt_part (GMimeCryptoContext * gpgctx, GMimeObject * part);
+
+      /* slist is from a verification rather than from decrypt_res */
+      bool own_slist = false;
+
+      /* a verification in progress on the crypto workers */
+      std::shared_future<void> pending;
+
+      static GMimeCryptoContext * new_gpg_context (ustring gpgpath, bool always_trust);
+
+    public:
+      /* session keys of decrypted parts are kept (if enabled) so that a
+       * part can be decrypted again without the private key, e.g. without
+       * the smartcard. the keys are identified by a digest of the encrypted
+       * content. */
+      static void init ();
+      static void destruct ();
+      static void purge_session_keys ();
+
+    private:
+      struct SessionKey {
+        std::string key;
+        time_t      added;
+      };
+
+      static std::mutex session_keys_m;
+      static std::map<std::string, SessionKey> session_keys;
+
+      static bool      cache_session_keys;
+      static bool      persist_session_keys;
+      static int       session_key_ttl; // seconds
+      static bfs::path session_keys_file;
+
+      static std::string encrypted_digest (GMimeMultipartEncrypted *);
+      static std::string get_session_key (std::string digest);
+      static void        add_session_key (std::string digest, std::string key);
+      static void        load_session_keys ();
+      static void        save_session_keys ();
+      static bool        session_keys_dir_private ();
+
+    private:
+      /* verification results of signed parts are kept, keyed by a digest
+       * of the signed part (content and signature) and the modification
+       * time of the keyring, so that a thread can be shown again without
+       * running gpg. */
+      static std::mutex signatures_m;
+      static std::list<std::pair<std::string, GMimeSignatureList *>> signatures;
+      static std::map<std::string, std::list<std::pair<std::string, GMimeSignatureList *>>::iterator> signatures_index;
+      static unsigned int max_signatures;
+
+      static std::string keyring_stamp ();
+      static GMimeSignatureList * get_signatures (std::string key);
+      static void add_signatures (std::string key, GMimeSignatureList *);
+      static void clear_signatures ();
+
+      /* signed parts are verified on a pool of worker threads, each with its
+       * own gpg context (gmime 3 creates a context per operation). the
+       * workers are started on the first job. decryption is not queued, the
+       * decrypted part is needed right away to build the chunk tree. */
+      typedef std::function<void (GMimeCryptoContext *)> Job;
+
+      struct Task {
+        ustring what;
+        Job     job;
+        std::promise<void> done;
+        std::chrono::time_point<std::chrono::steady_clock> queued;
+      };
+
+      static std::mutex               workers_m;
+      static std::condition_variable  workers_cv;
+      static std::deque<Task>         tasks;
+      static std::vector<std::thread> workers;
+      static bool                     workers_stop;
+
+      static int     n_workers;
+      static ustring workers_gpgpath;
+      static bool    workers_always_trust;
+
+      static std::future<void> submit (ustring what, Job);
+      static void start_workers ();
+      static void worker ();
+
+    public:
+      /* finishes the queued jobs */
+      static void stop_workers ();
+
     public:
       static ustring  get_md5_digest (ustring str);
       static gssize   get_md5_length ();
@@ -1,6 +1,7 @@
 # include <iostream>
 # include <vector>
 # include <algorithm>
+# include <cstring>
 # include <exception>
 # include <boost/filesystem.hpp>
 
@@ -25,9 +26,11 @@ using namespace std;
 using namespace boost::filesystem;
 
 namespace Astroid {
-  std::atomic<int>          Db::read_only_dbs_open;
-  std::mutex                Db::db_open;
-  std::condition_variable   Db::dbs_open;
+  RwLock Db::lock ("db");
+
+  std::shared_timed_mutex                  Db::tag_ids_m;
+  std::vector<ustring>                     Db::tag_names;
+  std::unordered_map<std::string, unsigned int> Db::tag_ids;
 
   /* static settings */
   bool Db::maildir_synchronize_flags = false;
@@ -35,6 +38,7 @@ namespace Astroid {
   std::vector<ustring> Db::sent_tags = { "sent" };
   std::vector<ustring> Db::draft_tags = { "draft" };
   std::vector<ustring> Db::tags;
+  unsigned int Db::tags_generation = 0;
 
   bfs::path Db::path_db;
 
@@ -77,6 +81,9 @@ namespace Astroid {
     sent_tags = VectorUtils::split_and_trim (sent_tags_s, ",");
     sort (sent_tags.begin (), sent_tags.end ());
 
+    lock.warn_after = chrono::milliseconds (
+        astroid->config ().get<int> ("astroid.debug.db_lock_warn"));
+
     try {
       maildir_synchronize_flags = config.get<bool> ("maildir.synchronize_flags");
     } catch (const boost::property_tree::ptree_bad_path &ex) {
@@ -84,7 +91,7 @@ namespace Astroid {
     }
   }
 
-  Db::Db (DbMode _mode) {
+  Db::Db (DbMode _mode, const char * caller) {
     mode = _mode;
 
     time_t start = clock ();
@@ -92,9 +99,9 @@ namespace Astroid {
     nm_db = NULL;
 
     if (mode == DATABASE_READ_ONLY) {
-      open_db_read_only (true);
+      open_db_read_only (true, caller);
     } else if (mode == DATABASE_READ_WRITE) {
-      open_db_write (true);
+      open_db_write (true, caller);
     } else {
       throw invalid_argument ("db: mode must be read-only or read-write");
     }
@@ -103,12 +110,12 @@ namespace Astroid {
     LOG (debug) << "db: open time: " << diff << " ms.";
   }
 
-  bool Db::open_db_write (bool block) {
+  bool Db::open_db_write (bool block, const char * caller) {
     LOG (info) << "db: open db read-write.";
 
-    /* lock will wait for all read-onlys to close, lk will not be released before
-     * db is closed */
-    rw_lock = Db::acquire_rw_lock ();
+    /* lock will wait for all read-onlys to close, it will not be released
+     * before db is closed */
+    lock_ticket = Db::acquire_rw_lock (caller);
 
     notmuch_status_t s;
 
@@ -141,7 +148,7 @@ namespace Astroid {
     if (s != NOTMUCH_STATUS_SUCCESS) {
       LOG (error) << "db: error: failed opening database for writing, have you configured the notmuch database path correctly?";
 
-      release_rw_lock (rw_lock);
+      release_rw_lock (lock_ticket);
       throw database_error ("failed to open database for writing");
 
       return false;
@@ -150,8 +157,8 @@ namespace Astroid {
     return true;
   }
 
-  bool Db::open_db_read_only (bool block) {
-    Db::acquire_ro_lock ();
+  bool Db::open_db_read_only (bool block, const char * caller) {
+    lock_ticket = Db::acquire_ro_lock (caller);
 
     notmuch_status_t s;
 
@@ -179,7 +186,7 @@ namespace Astroid {
     if (s != NOTMUCH_STATUS_SUCCESS) {
       LOG (error) << "db: error: failed opening database for reading, have you configured the notmuch database path correctly?";
 
-      release_ro_lock ();
+      release_ro_lock (lock_ticket);
       throw database_error ("failed to open database (in read-only mode)");
 
       return false;
@@ -188,39 +195,42 @@ namespace Astroid {
     return true;
   }
 
-  std::unique_lock<std::mutex> Db::acquire_rw_lock () {
-    /* lock will wait for all read-onlys to close, lk will not be released before
-     * db is closed */
-    LOG (debug) << "db: rw-s: waiting for rw lock.. (r-o open: " << read_only_dbs_open << ")";
-    std::unique_lock<std::mutex> rwl (db_open);
-    dbs_open.wait (rwl, [] { return (read_only_dbs_open == 0); });
+  RwLock::ticket Db::acquire_rw_lock (const char * caller) {
+    /* will wait for all read-onlys to close, and block new read-onlys from
+     * opening while waiting */
+    LOG (debug) << "db: rw-s: waiting for rw lock.. (r-o open: " << lock.readers () << ")";
+    RwLock::ticket t = lock.lock_write (caller);
     LOG (debug) << "db: rw-s lock acquired.";
 
-    return rwl;
+    return t;
   }
 
-  void Db::release_rw_lock (std::unique_lock<std::mutex> &rwl) {
+  void Db::release_rw_lock (RwLock::ticket t) {
     LOG (debug) << "db: rw-s: releasing lock.";
-    rwl.unlock ();
-    dbs_open.notify_all ();
+    lock.unlock (t);
   }
 
-  void Db::acquire_ro_lock () {
+  RwLock::ticket Db::acquire_ro_lock (const char * caller) {
     LOG (info) << "db: open db read-only, waiting for lock..";
 
-    /* will block if there is an read-write db open */
-    std::lock_guard<std::mutex> lk (db_open);
-    read_only_dbs_open++;
+    /* will block if there is an read-write db open or waiting */
+    RwLock::ticket t = lock.lock_read (caller);
     LOG (debug) << "db: read-only got lock.";
+
+    return t;
   }
 
-  void Db::release_ro_lock () {
-    LOG (debug) << "db: ro: waiting for lock to close..";
-    std::unique_lock<std::mutex> lk (db_open);
+  void Db::release_ro_lock (RwLock::ticket t) {
     LOG (debug) << "db: ro: closing..";
-    read_only_dbs_open--;
-    lk.unlock ();
-    dbs_open.notify_all ();
+    lock.unlock (t);
+  }
+
+  std::string Db::dump_lock () {
+    return lock.dump ();
+  }
+
+  std::string Db::dump_lock_stats () {
+    return lock.dump_stats ();
   }
 
   void Db::close () {
@@ -235,9 +245,9 @@ namespace Astroid {
 
       if (mode == DATABASE_READ_WRITE) {
         LOG (debug) << "db: rw: releasing lock.";
-        release_rw_lock (rw_lock);
+        release_rw_lock (lock_ticket);
       } else {
-        release_ro_lock ();
+        release_ro_lock (lock_ticket);
       }
     }
   }
@@ -253,11 +263,100 @@ namespace Astroid {
     return revision;
   }
 
+  ustring Db::get_uuid () {
+    const char *uuid;
+    notmuch_database_get_revision (nm_db, &uuid);
+
+    return ustring (uuid);
+  }
+
+  unsigned int Db::tag_id (const ustring & tag) {
+    {
+      std::shared_lock<std::shared_timed_mutex> lk (tag_ids_m);
+
+      auto f = tag_ids.find (tag.raw ());
+      if (f != tag_ids.end ()) return f->second;
+    }
+
+    std::unique_lock<std::shared_timed_mutex> lk (tag_ids_m);
+
+    /* may have been added while waiting for the lock */
+    auto f = tag_ids.find (tag.raw ());
+    if (f != tag_ids.end ()) return f->second;
+
+    unsigned int id = tag_names.size ();
+    tag_names.push_back (tag);
+    tag_ids[tag.raw ()] = id;
+
+    return id;
+  }
+
+  int Db::find_tag_id (const ustring & tag) {
+    std::shared_lock<std::shared_timed_mutex> lk (tag_ids_m);
+
+    auto f = tag_ids.find (tag.raw ());
+    if (f != tag_ids.end ()) return f->second;
+    else return -1;
+  }
+
+  ustring Db::tag_name (unsigned int id) {
+    std::shared_lock<std::shared_timed_mutex> lk (tag_ids_m);
+
+    if (id < tag_names.size ()) return tag_names[id];
+    else return "";
+  }
+
+  void Db::tag_ids_of (const std::vector<ustring> & tags, TagSet & set) {
+    /* resolve all the tags under one shared lock, only new tags need to
+     * take it exclusively */
+    std::vector<const ustring *> unknown;
+
+    {
+      std::shared_lock<std::shared_timed_mutex> lk (tag_ids_m);
+
+      for (auto & t : tags) {
+        auto f = tag_ids.find (t.raw ());
+        if (f != tag_ids.end ()) set.set (f->second);
+        else unknown.push_back (&t);
+      }
+    }
+
+    for (auto t : unknown) set.set (tag_id (*t));
+  }
+
+  bool Db::begin_atomic () {
+    if (mode != DATABASE_READ_WRITE) {
+      LOG (error) << "db: atomic section requires a read-write db.";
+      return false;
+    }
+
+    notmuch_status_t s = notmuch_database_begin_atomic (nm_db);
+
+    if (s != NOTMUCH_STATUS_SUCCESS) {
+      LOG (error) << "db: could not begin atomic section: " << notmuch_status_to_string (s);
+      return false;
+    }
+
+    return true;
+  }
+
+  bool Db::end_atomic () {
+    notmuch_status_t s = notmuch_database_end_atomic (nm_db);
+
+    if (s != NOTMUCH_STATUS_SUCCESS) {
+      LOG (error) << "db: could not end atomic section: " << notmuch_status_to_string (s);
+      return false;
+    }
+
+    return true;
+  }
+
   void Db::load_tags () {
     notmuch_tags_t * nm_tags = notmuch_database_get_all_tags (nm_db);
     const char * tag;
 
     tags.clear ();
+    tags_generation++;
 
     for (; notmuch_tags_valid (nm_tags);
            notmuch_tags_move_to_next (nm_tags))
@@ -266,6 +365,7 @@ namespace Astroid {
       tag = notmuch_tags_get (nm_tags);
 
       tags.push_back (ustring(tag));
+      tag_id (tags.back ());
     }
 
     notmuch_tags_destroy (nm_tags);
@@ -273,6 +373,18 @@ namespace Astroid {
     LOG (info) << "db: loaded " << tags.size () << " tags.";
   }
 
+  void Db::add_known_tags (const std::vector<ustring> & new_tags) {
+    for (ustring t : new_tags) {
+      t = sanitize_tag (t);
+      if (!check_tag (t)) continue;
+
+      if (find (tags.begin (), tags.end (), t) == tags.end ()) {
+        LOG (debug) << "db: new tag: " << t;
+        tags.push_back (t);
+      }
+    }
+  }
+
   bool Db::remove_message (ustring fname) {
     notmuch_status_t s = notmuch_database_remove_message (nm_db,
         fname.c_str ());
@@ -446,6 +558,102 @@ namespace Astroid {
     return (st == NOTMUCH_STATUS_SUCCESS) && (c == 1);
   }
 
+  std::set<ustring> Db::threads_in_query (ustring query_in, const std::set<ustring> & thread_ids) {
+    /* returns the threads of thread_ids that are in the query, checked in
+     * batches rather than one query per thread. */
+    std::set<ustring> found;
+
+    UstringUtils::trim(query_in);
+    bool all = (query_in.length() == 0 || query_in == "*");
+
+    time_t t0 = clock ();
+
+    const unsigned int batch = 256;
+    auto it = thread_ids.begin ();
+
+    while (it != thread_ids.end ()) {
+      string query_s = "(";
+
+      for (unsigned int i = 0; i < batch && it != thread_ids.end (); i++, it++) {
+        if (i > 0) query_s += " OR ";
+        query_s += "thread:" + *it;
+      }
+
+      query_s += ")";
+
+      if (!all) {
+        query_s += " AND (" + query_in + ")";
+      }
+
+      notmuch_query_t * query = notmuch_query_create (nm_db, query_s.c_str());
+      for (ustring &t : excluded_tags) {
+        notmuch_query_add_tag_exclude (query, t.c_str());
+      }
+      notmuch_query_set_omit_excluded (query, NOTMUCH_EXCLUDE_TRUE);
+
+      notmuch_threads_t * threads;
+      notmuch_status_t st = notmuch_query_search_threads (query, &threads);
+
+      if (st == NOTMUCH_STATUS_SUCCESS) {
+        for (; notmuch_threads_valid (threads);
+               notmuch_threads_move_to_next (threads)) {
+
+          notmuch_thread_t * thread = notmuch_threads_get (threads);
+          const char * t = notmuch_thread_get_thread_id (thread);
+          if (t != NULL) found.insert (ustring (t));
+          notmuch_thread_destroy (thread);
+        }
+      } else {
+        LOG (error) << "db: could not check threads in query: " << query_in << ", status: " << notmuch_status_to_string (st);
+      }
+
+      notmuch_query_destroy (query);
+    }
+
+    LOG (debug) << "db: " << found.size () << " of " << thread_ids.size () << " threads in query, check: " << ((clock() - t0) * 1000.0 / CLOCKS_PER_SEC) << " ms.";
+
+    return found;
+  }
+
+  bool Db::thread_ids_in_query (ustring query_in, std::set<ustring> & thread_ids, bool exclude) {
+    /* searching for messages only looks up the thread id of each message,
+     * while searching for threads loads all messages of all the threads. */
+    time_t t0 = clock ();
+
+    notmuch_query_t * query = notmuch_query_create (nm_db, query_in.c_str());
+    if (exclude) {
+      for (ustring &t : excluded_tags) {
+        notmuch_query_add_tag_exclude (query, t.c_str());
+      }
+      notmuch_query_set_omit_excluded (query, NOTMUCH_EXCLUDE_TRUE);
+    }
+    notmuch_query_set_sort (query, NOTMUCH_SORT_UNSORTED);
+
+    notmuch_messages_t * messages;
+    notmuch_status_t st = notmuch_query_search_messages (query, &messages);
+
+    if (st != NOTMUCH_STATUS_SUCCESS) {
+      LOG (error) << "db: could not get thread ids for query: " << query_in << ", status: " << notmuch_status_to_string (st);
+      notmuch_query_destroy (query);
+      return false;
+    }
+
+    for (; notmuch_messages_valid (messages);
+           notmuch_messages_move_to_next (messages)) {
+
+      notmuch_message_t * message = notmuch_messages_get (messages);
+      const char * t = notmuch_message_get_thread_id (message);
+      if (t != NULL) thread_ids.insert (ustring (t));
+      notmuch_message_destroy (message);
+    }
+
+    notmuch_query_destroy (query);
+
+    LOG (debug) << "db: " << thread_ids.size () << " threads in query, in: " << ((clock() - t0) * 1000.0 / CLOCKS_PER_SEC) << " ms.";
+
+    return true;
+  }
+
   void Db::on_thread (ustring thread_id, function<void(notmuch_thread_t *)> func) {
 
     string query_s = "thread:" + thread_id;
@@ -548,7 +756,9 @@ namespace Astroid {
    * notmuch thread
    * --------------
    */
-  NotmuchThread::NotmuchThread (notmuch_thread_t * t) {
+  NotmuchThread::NotmuchThread (notmuch_thread_t * t, std::shared_ptr<StringArena> _arena) {
+    arena = _arena ? _arena : StringArena::global ();
+
     const char * ti = notmuch_thread_get_thread_id (t);
     if (ti == NULL) {
       LOG (error) << "nmt: got NULL thread id.";
@@ -560,6 +770,18 @@ namespace Astroid {
     load (t);
   }
 
+  NotmuchThread::NotmuchThread (ustring _thread_id, std::shared_ptr<StringArena> _arena) {
+    arena = _arena ? _arena : StringArena::global ();
+    thread_id = _thread_id;
+
+    unread         = false;
+    attachment     = false;
+    flagged        = false;
+    newest_date    = 0;
+    oldest_date    = 0;
+    total_messages = 0;
+  }
+
   NotmuchThread::~NotmuchThread () {
     //LOG (debug) << "nmt: deconstruct.";
   }
@@ -599,7 +821,15 @@ namespace Astroid {
     oldest_date = notmuch_thread_get_oldest_date (nm_thread);
     total_messages = check_total_messages (nm_thread);
     tags        = get_tags (nm_thread);
+    message_id  = get_message_id (nm_thread); // before get_authors, which destroys the messages
     authors     = get_authors (nm_thread);
+
+    index_tags ();
+    changed ();
+  }
+
+  void NotmuchThread::changed () {
+    version++;
   }
 
   vector<ustring> NotmuchThread::get_tags (notmuch_thread_t * nm_thread) {
@@ -636,12 +866,41 @@ namespace Astroid {
     return ttags;
   }
 
-  vector<tuple<ustring,bool>> NotmuchThread::get_authors (notmuch_thread_t * nm_thread) {
+  const char * NotmuchThread::get_message_id (notmuch_thread_t * nm_thread) {
+    const char * mid = NULL;
+
+    notmuch_messages_t * qmessages;
+    notmuch_message_t  * message;
+
+    for (qmessages = notmuch_thread_get_messages (nm_thread);
+         notmuch_messages_valid (qmessages);
+         notmuch_messages_move_to_next (qmessages)) {
+
+      message = notmuch_messages_get (qmessages);
+
+      const char * m = notmuch_message_get_message_id (message); // belongs to message
+      if (m != NULL && (mid == NULL || strcmp (m, mid) < 0)) {
+        mid = m;
+      }
+    }
+
+    return (mid != NULL) ? arena->store (mid) : "";
+  }
+
+  NotmuchThread::Author NotmuchThread::make_author (StringArena & arena, const std::string & name, bool unread) {
+    auto n = arena.intern_folded (name, [] (const std::string & s) {
+          return ustring (s).lowercase ().raw ();
+        });
+
+    return Author { n.first, n.second, unread };
+  }
+
+  vector<NotmuchThread::Author> NotmuchThread::get_authors (notmuch_thread_t * nm_thread) {
     /* important: this might be called from another thread, we cannot output anything here */
 
     /* returns a vector of authors and whether they are authors of
      * an unread message in the thread */
-    vector<tuple<ustring, bool>> aths;
+    vector<Author> aths;
 
     /* get messages from thread */
     notmuch_messages_t * qmessages;
@@ -683,17 +942,20 @@ namespace Astroid {
           }
       }
 
+      /* interned: equal names have the same pointer */
+      Author an = make_author (*arena, a, _unread);
+
       auto fnd = find_if (aths.begin (), aths.end (),
-          [&] (tuple<ustring, bool> &p) {
-            return get<0>(p) == a;
+          [&] (Author &p) {
+            return p.name == an.name;
           });
 
       if (fnd == aths.end ()) {
-        aths.push_back (make_tuple (a, _unread));
+        aths.push_back (an);
       } else {
         /* check if it is marked unread */
-        if (_unread && !(get<1> (*fnd))) {
-          get<1> (*fnd) = true;
+        if (_unread && !fnd->unread) {
+          fnd->unread = true;
         }
       }
 
@@ -752,13 +1014,11 @@ namespace Astroid {
 
           if (res) {
             tags.push_back (tag);
+            tag_set.set (Db::tag_id (tag));
+            changed ();
 
-            // add to global tag list
-            if (find(db->tags.begin (),
-                  db->tags.end (),
-                  tag) == db->tags.end ()) {
-              db->tags.push_back (tag);
-            }
+            /* the global tag list is extended by the action on the gui
+             * thread, see Db::add_known_tags () */
           }
 
           res = true;
@@ -817,6 +1077,8 @@ namespace Astroid {
             tags.erase (remove (tags.begin (),
                                 tags.end (),
                                 tag), tags.end ());
+            tag_set.reset (Db::tag_id (tag));
+            changed ();
           }
 
           res = true;
@@ -834,14 +1096,20 @@ namespace Astroid {
     astroid->actions->emit_thread_updated (db, thread_id);
   }
 
+  ustring NotmuchThread::filter_str () {
+    /* the author names are folded once when they are interned */
+    ustring index_str = subject.lowercase ();
+    for (auto &a : authors)  index_str += a.folded;
+
+    ustring rest;
+    for (auto &t : tags)     rest += t;
+    rest += thread_id;
+
+    return index_str + rest.lowercase ();
+  }
+
   bool NotmuchThread::matches (std::vector<ustring> &k) {
-    if (index_str.empty ()) {
-      index_str = subject;
-      for (auto &a : authors)  index_str += get<0>(a);
-      for (auto &t : tags)     index_str += t;
-      index_str += thread_id;
-      index_str = index_str.lowercase ();
-    }
+    ustring index_str = filter_str ();
 
     /* match all keys (AND) */
     return std::all_of (k.begin (), k.end (),
@@ -851,6 +1119,27 @@ namespace Astroid {
           });
   }
 
+  size_t NotmuchThread::memory_usage () {
+    /* strings short enough for the small string optimization do not use
+     * the heap */
+    auto heap = [] (const ustring &s) -> size_t {
+      return s.bytes () > 15 ? s.bytes () + 1 : 0;
+    };
+
+    size_t m = sizeof (NotmuchThread);
+
+    m += heap (thread_id);
+    m += heap (subject);
+
+    m += tags.capacity () * sizeof (ustring);
+    for (auto &t : tags) m += heap (t);
+
+    m += authors.capacity () * sizeof (Author);
+    m += tag_set.bytes ();
+
+    return m;
+  }
+
   bool NotmuchThread::in_query (Db * db, ustring query) {
     return db->thread_in_query (query, thread_id);
   }
@@ -951,6 +1240,7 @@ namespace Astroid {
   NotmuchMessage::NotmuchMessage (refptr<Message> m) {
     mid       = m->mid;
     tags      = m->tags;
+    index_tags ();
     thread_id = m->tid;
     subject   = m->subject;
     sender    = m->sender;
@@ -1002,6 +1292,7 @@ namespace Astroid {
     attachment = false;
     flagged    = false;
     tags       = get_tags (m); // sets up unread, attachment and flagged
+    index_tags ();
   }
 
   vector<ustring> NotmuchMessage::get_tags (notmuch_message_t * m) {
@@ -1178,7 +1469,17 @@ namespace Astroid {
    * NotmuchItem
    ***************/
   bool NotmuchItem::has_tag (ustring tag) {
-    return (find(tags.begin (), tags.end (), tag) != tags.end ());
+    int id = Db::find_tag_id (tag);
+    return (id >= 0) && tag_set.test (id);
+  }
+
+  bool NotmuchItem::has_tag (unsigned int id) const {
+    return tag_set.test (id);
+  }
+
+  void NotmuchItem::index_tags () {
+    tag_set.clear ();
+    Db::tag_ids_of (tags, tag_set);
   }
 
   /***************
@@ -1,11 +1,14 @@
 # pragma once
 
 # include <mutex>
+# include <shared_mutex>
 # include <condition_variable>
 # include <atomic>
 # include <functional>
 
 # include <vector>
+# include <set>
+# include <unordered_map>
 
 # include <time.h>
 
@@ -16,6 +19,23 @@
 # include "config.hh"
 # include "proto.hh"
 
+/* the name of the calling function as a default argument, where the
+ * compiler provides it */
+# if defined(__has_builtin)
+#  if __has_builtin(__builtin_FUNCTION)
+#   define DB_CALLER __builtin_FUNCTION ()
+#  endif
+# endif
+# if !defined(DB_CALLER) && defined(__GNUC__) && !defined(__clang__)
+#  define DB_CALLER __builtin_FUNCTION ()
+# endif
+# ifndef DB_CALLER
+#  define DB_CALLER ""
+# endif
+# include "utils/rw_lock.hh"
+# include "utils/tag_set.hh"
+# include "utils/string_arena.hh"
+
 /* there was a bit of a round-dance of with the _st versions of these returning
  * to the old name, but with different signature */
 # if (LIBNOTMUCH_MAJOR_VERSION < 5)
@@ -43,6 +63,12 @@ namespace Astroid {
 
       std::vector<ustring>  tags;
       bool                  has_tag (ustring);
+      bool                  has_tag (unsigned int id) const; // id from Db::tag_id
+
+      /* interned ids of tags, must be updated with index_tags () whenever
+       * tags is changed */
+      TagSet                tag_set;
+      void                  index_tags ();
 
       virtual bool remove_tag (Db *, ustring) = 0;
       virtual bool add_tag (Db *, ustring)    = 0;
@@ -86,17 +112,47 @@ namespace Astroid {
   /* the notmuch thread object should get by on the db only */
   class NotmuchThread : public NotmuchItem {
     public:
-      NotmuchThread (notmuch_thread_t *);
+      /* strings shared between threads (author names) are interned in the
+       * arena, usually one per query. */
+      NotmuchThread (notmuch_thread_t *, std::shared_ptr<StringArena> arena = nullptr);
+
+      /* an empty thread to be filled in by the caller, e.g. from a cache */
+      NotmuchThread (ustring thread_id, std::shared_ptr<StringArena> arena = nullptr);
       ~NotmuchThread ();
 
       time_t  newest_date;
       time_t  oldest_date;
       int     total_messages;
-      std::vector<std::tuple<ustring,bool>> authors;
+
+      struct Author {
+        const char * name;   // in arena
+        const char * folded; // lower case name, in arena
+        bool         unread;
+      };
+
+      /* intern an author name and its lower case form in arena */
+      static Author make_author (StringArena &, const std::string & name, bool unread);
+
+      std::vector<Author> authors;
+
+      /* the lowest message id in the thread (in arena), used for sorting by
+       * message id */
+      const char * message_id = "";
 
       void load (notmuch_thread_t *);
       bool refresh (Db *) override;
 
+      /* incremented whenever the thread has been reloaded or its tags changed */
+      unsigned int version = 0;
+
+      /* lower case string of subject, authors, tags and thread id used when
+       * filtering. it is not kept, the thread index keeps its own corpus. */
+      ustring filter_str ();
+
+      /* approximate memory used by the thread (bytes), not counting the
+       * arena */
+      size_t memory_usage ();
+
       bool remove_tag (Db *, ustring) override;
       bool add_tag (Db *, ustring) override;
       void emit_updated (Db *) override;
@@ -109,10 +165,13 @@ namespace Astroid {
 
     private:
       int check_total_messages (notmuch_thread_t *);
-      std::vector<std::tuple<ustring,bool>> get_authors (notmuch_thread_t *);
+      std::vector<Author> get_authors (notmuch_thread_t *);
+      const char * get_message_id (notmuch_thread_t *);
       std::vector<ustring> get_tags (notmuch_thread_t *);
 
-      ustring index_str = "";
+      void changed ();
+
+      std::shared_ptr<StringArena> arena;
   };
 
   class Db {
@@ -122,7 +181,9 @@ namespace Astroid {
         DATABASE_READ_WRITE,
       };
 
-      Db (DbMode = DATABASE_READ_ONLY);
+      /* the caller is used to attribute lock wait times, it defaults to the
+       * name of the calling function (empty if the compiler cannot tell). */
+      Db (DbMode = DATABASE_READ_ONLY, const char * caller = DB_CALLER);
       ~Db ();
       void close ();
 
@@ -130,16 +191,39 @@ namespace Astroid {
       void on_message (ustring, std::function <void(notmuch_message_t *)>);
 
       bool thread_in_query (ustring, ustring);
+      std::set<ustring> threads_in_query (ustring, const std::set<ustring> &);
+
+      /* the ids of the threads matching the query, without building the
+       * threads */
+      bool thread_ids_in_query (ustring, std::set<ustring> &, bool exclude = true);
       bool message_in_query (ustring, ustring);
 
       unsigned long get_revision ();
+      ustring       get_uuid ();
+
+      /* group several changes on a read-write db into one transaction */
+      bool begin_atomic ();
+      bool end_atomic ();
 
       notmuch_database_t * nm_db;
 
       static std::vector<ustring> tags;
+      static unsigned int tags_generation; // bumped when tags are reloaded
 
       void load_tags ();
 
+      /* add tags applied by an action to tags, on the gui thread only */
+      static void add_known_tags (const std::vector<ustring> &);
+
+      /* interned tags: every tag seen gets a small, stable id for the
+       * lifetime of the process. new tags are rare, so lookups only take
+       * the table lock shared. callers checking the same tag repeatedly
+       * should resolve its id once. */
+      static unsigned int tag_id (const ustring &);
+      static int          find_tag_id (const ustring &); // -1 if unknown
+      static ustring      tag_name (unsigned int);
+      static void         tag_ids_of (const std::vector<ustring> &, TagSet &);
+
       static std::vector<ustring> sent_tags;
       static std::vector<ustring> draft_tags;
       static std::vector<ustring> excluded_tags;
@@ -154,11 +238,15 @@ namespace Astroid {
 
       /* lock db: use if you need the db in external program and need
        * a specific lock */
-      static std::unique_lock<std::mutex> acquire_rw_lock ();
-      static void release_rw_lock (std::unique_lock<std::mutex> &);
+      static RwLock::ticket acquire_rw_lock (const char * caller = DB_CALLER);
+      static void release_rw_lock (RwLock::ticket);
 
-      static void acquire_ro_lock ();
-      static void release_ro_lock ();
+      static RwLock::ticket acquire_ro_lock (const char * caller = DB_CALLER);
+      static void release_ro_lock (RwLock::ticket);
+
+      /* current holders of the db lock and wait time statistics */
+      static std::string dump_lock ();
+      static std::string dump_lock_stats ();
 
       static bool maildir_synchronize_flags;
       static void init ();
@@ -178,22 +266,20 @@ namespace Astroid {
        *
        */
 
-      /* number of open read-only dbs, when 0 a read-write can be opened */
-      static std::atomic<int>         read_only_dbs_open;
-
-      /* synchronizes openings, read-write dbs will lock this for
-       * its entire lifespan. read-only, only locks it while incrementing
-       * the read_only_dbs_open */
-      static std::mutex               db_open;
+      /* read-only dbs share the lock, a read-write db holds it exclusively
+       * for its entire lifespan. waiting writers have preference over new
+       * readers. */
+      static RwLock lock;
+      RwLock::ticket lock_ticket = 0;
 
-      /* notify when read_only_dbs change */
-      static std::condition_variable  dbs_open;
-      std::unique_lock<std::mutex>    rw_lock;
+      static std::shared_timed_mutex                  tag_ids_m;
+      static std::vector<ustring>                     tag_names;
+      static std::unordered_map<std::string, unsigned int> tag_ids;
 
       DbMode mode;
 
-      bool open_db_write (bool);
-      bool open_db_read_only (bool);
+      bool open_db_write (bool, const char *);
+      bool open_db_read_only (bool, const char *);
       bool closed = false;
 
       const int db_open_timeout = 120; // seconds
@@ -22,6 +22,7 @@
 # include "modes/edit_message.hh"
 # include "modes/log_view.hh"
 # include "command_bar.hh"
+# include "crypto.hh"
 # include "actions/action.hh"
 # include "actions/action_manager.hh"
 # include "utils/resource.hh"
@@ -395,6 +396,13 @@ namespace Astroid {
           return true;
         });
 
+    keys.register_key (UnboundKey (), "main_window.purge_session_keys",
+        "Forget the cached session keys of decrypted messages",
+        [&] (Key) {
+          Crypto::purge_session_keys ();
+          return true;
+        });
+
     keys.register_key ("C-o", "main_window.open_new_window",
         "Open new main window",
         [&] (Key) {
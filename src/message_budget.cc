@@ -0,0 +1,101 @@
+# include <vector>
+# include <algorithm>
+# include <iterator>
+
+# include "astroid.hh"
+# include "config.hh"
+# include "message_budget.hh"
+# include "message_thread.hh"
+
+namespace Astroid {
+  std::list<MessageBudget::Entry> MessageBudget::lru;
+  std::map<Message *, std::list<MessageBudget::Entry>::iterator> MessageBudget::index;
+
+  size_t        MessageBudget::total    = 0;
+  size_t        MessageBudget::limit    = 0;
+  unsigned long MessageBudget::unloaded = 0;
+
+  void MessageBudget::init () {
+    limit = std::max (0, astroid->config ("thread_view").get<int> ("parsed_budget")) * 1024 * 1024;
+  }
+
+  void MessageBudget::add (Message * m, size_t bytes) {
+    auto f = index.find (m);
+
+    if (f != index.end ()) {
+      total -= f->second->bytes;
+      lru.erase (f->second);
+    }
+
+    lru.push_front (Entry { m, bytes });
+    index[m] = lru.begin ();
+    total   += bytes;
+
+    LOG (debug) << "message budget: added " << (bytes / 1024) << " kB, " << status ();
+
+    trim ();
+  }
+
+  void MessageBudget::touch (Message * m) {
+    auto f = index.find (m);
+    if (f == index.end ()) return;
+
+    lru.splice (lru.begin (), lru, f->second);
+  }
+
+  void MessageBudget::remove (Message * m) {
+    auto f = index.find (m);
+    if (f == index.end ()) return;
+
+    total -= f->second->bytes;
+    lru.erase (f->second);
+    index.erase (f);
+
+    LOG (debug) << "message budget: removed, " << status ();
+  }
+
+  void MessageBudget::trim () {
+    if (limit == 0 || total <= limit) return;
+
+    /* least recently used first, the entries are removed by unload (). the
+     * most recently used message is about to be used and is kept. */
+    std::vector<Message *> candidates;
+    for (auto it = lru.rbegin (); it != lru.rend () && std::next (it) != lru.rend (); it++) {
+      if (it->m->may_unload) candidates.push_back (it->m);
+    }
+
+    size_t before = total;
+    int n = 0;
+
+    for (Message * m : candidates) {
+      if (total <= limit) break;
+      if (m->unload ()) n++;
+    }
+
+    unloaded += n;
+
+    LOG (info) << "message budget: unloaded " << n << " messages ("
+      << (before / 1024 / 1024) << " MB before), " << status ();
+  }
+
+  ustring MessageBudget::status () {
+    return ustring::compose ("%1 MB parsed in %2 messages (budget: %3, unloaded in total: %4)",
+        total / 1024 / 1024,
+        lru.size (),
+        (limit == 0 ? ustring ("unlimited") : ustring::compose ("%1 MB", limit / 1024 / 1024)),
+        unloaded);
+  }
+
+  size_t MessageBudget::usage () {
+    return total;
+  }
+
+  size_t MessageBudget::messages () {
+    return lru.size ();
+  }
+
+  size_t MessageBudget::budget () {
+    return limit;
+  }
+}
+
@@ -0,0 +1,52 @@
+# pragma once
+
+# include <list>
+# include <map>
+
+# include "astroid.hh"
+# include "proto.hh"
+
+namespace Astroid {
+  /* keeps the parsed MIME trees of messages within a memory budget.
+   *
+   * a message loaded from a file registers the size of its tree (taken
+   * as the size of the file) and is touched whenever the tree is used.
+   * when the total exceeds the budget the trees of the least recently
+   * used messages that may be unloaded (collapsed in a thread view) are
+   * dropped. the message keeps its headers and tags, and parses the file
+   * again when the tree is needed.
+   *
+   * only used from the gui thread. */
+  class MessageBudget {
+    public:
+      static void init ();
+
+      static void add (Message *, size_t bytes);
+      static void touch (Message *);
+      static void remove (Message *);
+
+      /* unload messages until the total is within the budget */
+      static void trim ();
+
+      static size_t usage ();    // bytes
+      static size_t messages (); // number of parsed messages
+      static size_t budget ();   // bytes, 0 is unlimited
+
+      /* usage, number of messages, budget and unloaded messages, for the log */
+      static ustring status ();
+
+    private:
+      struct Entry {
+        Message * m;
+        size_t    bytes;
+      };
+
+      static std::list<Entry> lru; // most recently used first
+      static std::map<Message *, std::list<Entry>::iterator> index;
+
+      static size_t total;
+      static size_t limit;
+      static unsigned long unloaded;
+  };
+}
+
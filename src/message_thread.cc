@@ -1,5 +1,9 @@
 # include <iostream>
 # include <string>
+# include <fcntl.h>
+# include <unistd.h>
+# include <sys/mman.h>
+# include <sys/stat.h>
 
 # include <notmuch.h>
 # include <gmime/gmime.h>
@@ -10,6 +14,7 @@
 # include "db.hh"
 # include "message_thread.hh"
 # include "chunk.hh"
+# include "message_budget.hh"
 # include "utils/utils.hh"
 # include "utils/cmd.hh"
 # include "utils/date_utils.hh"
@@ -119,6 +124,7 @@ namespace Astroid {
 
   Message::~Message () {
     LOG (debug) << "ms: deconstruct";
+    MessageBudget::remove (this);
     if (message) g_object_unref (message);
   }
 
@@ -152,6 +158,8 @@ namespace Astroid {
           has_file = false;
           in_notmuch = false;
           missing_content = true;
+
+          clear_addresses ();
         }
       });
   }
@@ -197,6 +205,34 @@ namespace Astroid {
         stream = astroid->plugin_manager->astroid_extension->process (fname.c_str());
       }
 # endif
+      raw_from_file = (stream == NULL);
+
+      /* the file may have been renamed (e.g. by a flag change) meanwhile,
+       * opening it below fails then */
+      boost::system::error_code ec;
+      uintmax_t fsize = file_size (fname.c_str (), ec);
+      if (ec) fsize = 0;
+
+      if (stream == NULL) {
+        /* large messages are mapped rather than read through stdio */
+        static const uintmax_t mmap_threshold = astroid->config ().get<uintmax_t> ("general.mmap_threshold");
+
+        if (mmap_threshold > 0 && fsize >= mmap_threshold) {
+          int fd = open (fname.c_str (), O_RDONLY);
+
+          if (fd >= 0) {
+            stream = g_mime_stream_mmap_new (fd, PROT_READ, MAP_PRIVATE);
+
+            if (stream == NULL) {
+              LOG (warn) << "message: could not map: " << fname << ", reading instead.";
+              close (fd);
+            } else {
+              LOG (debug) << "message: mapped: " << fname;
+            }
+          }
+        }
+      }
+
       if (stream == NULL) {
         GError *err = NULL; (void) (err); // not used in GMime 2.
         stream  = g_mime_stream_file_open (fname.c_str(), "r", &err);
@@ -225,7 +261,104 @@ namespace Astroid {
       g_object_unref (_message); // is reffed in load_message
       g_object_unref (stream); // reffed from parser
       g_object_unref (parser); // reffed from message
+
+      from_file = true;
+      MessageBudget::add (this, fsize);
+    }
+  }
+
+  bool Message::loaded () {
+    return message != NULL || missing_content;
+  }
+
+  bool Message::unload () {
+    if (!from_file || message == NULL) return false;
+
+    /* decrypting again could ask for the passphrase or the smartcard */
+    std::function<bool (refptr<Chunk>)> encrypted = [&] (refptr<Chunk> c) {
+      if (c->isencrypted) return true;
+      for (auto &k : c->kids) if (encrypted (k)) return true;
+      return false;
+    };
+
+    if (root && encrypted (root)) return false;
+
+    LOG (debug) << "message: unloading: " << mid;
+
+    std::vector<refptr<Chunk>> chunks;
+    chunk_shape.clear ();
+    chunk_layout (root, chunks, chunk_shape);
+
+    chunk_ids.clear ();
+    for (auto &c : chunks) {
+      chunk_ids.push_back (c->id);
+      chunk_ids.push_back (c->crypt ? c->crypt->id : -1);
     }
+
+    root.clear ();
+    g_object_unref (message);
+    message = NULL;
+
+    MessageBudget::remove (this);
+
+    return true;
+  }
+
+  void Message::ensure_loaded () {
+    if (loaded ()) {
+      MessageBudget::touch (this);
+      return;
+    }
+
+    if (!from_file) return;
+
+    LOG (debug) << "message: loading again: " << mid;
+
+    load_message_from_file (fname);
+
+    if (!root) return;
+
+    /* map the new chunks to the ids of the old ones, in the same order */
+    std::vector<refptr<Chunk>> chunks;
+    std::vector<size_t> shape;
+    chunk_layout (root, chunks, shape);
+
+    if (shape != chunk_shape) {
+      /* the thread view state refers to the old structure, fall back to
+       * the notmuch cache rather than showing the wrong parts */
+      LOG (warn) << "message: structure changed when loading again, not using it: " << mid;
+
+      root.clear ();
+      g_object_unref (message);
+      message = NULL;
+      MessageBudget::remove (this);
+
+      missing_content = true;
+      if (in_notmuch) load_notmuch_cache ();
+      return;
+    }
+
+    for (size_t i = 0; i < chunks.size (); i++) {
+      chunks[i]->id = chunk_ids[2 * i];
+      if (chunks[i]->crypt) chunks[i]->crypt->id = chunk_ids[2 * i + 1];
+    }
+  }
+
+  void Message::chunk_layout (
+      refptr<Chunk> c,
+      std::vector<refptr<Chunk>> & chunks,
+      std::vector<size_t> & shape)
+  {
+    /* pre-order: the chunk, its siblings, then its kids */
+    if (!c) return;
+
+    chunks.push_back (c);
+    shape.push_back (c->siblings.size ());
+    shape.push_back (c->kids.size ());
+    shape.push_back (c->crypt ? 1 : 0);
+
+    for (auto &k : c->siblings) chunk_layout (k, chunks, shape);
+    for (auto &k : c->kids)     chunk_layout (k, chunks, shape);
   }
 
   void Message::load_notmuch_cache () {
@@ -321,6 +454,8 @@ namespace Astroid {
   }
 
   ustring Message::plain_text (bool fallback_html) {
+    ensure_loaded ();
+
     if (missing_content) {
       LOG (warn) << "message: missing content, no text.";
       return "";
@@ -369,6 +504,8 @@ namespace Astroid {
   }
 
   ustring Message::quote () {
+    ensure_loaded ();
+
     if (missing_content) {
       LOG (warn) << "message: missing content, no text.";
       return "";
@@ -430,6 +567,8 @@ namespace Astroid {
   }
 
   vector<refptr<Chunk>> Message::attachments () {
+    ensure_loaded ();
+
     /* return a flat vector of attachments */
 
     vector<refptr<Chunk>> attachments;
@@ -452,6 +591,8 @@ namespace Astroid {
   }
 
   vector<refptr<Chunk>> Message::all_parts () {
+    ensure_loaded ();
+
     vector<refptr<Chunk>> parts;
 
     function< void (refptr<Chunk>) > app_part =
@@ -478,7 +619,11 @@ namespace Astroid {
   }
 
   refptr<Chunk> Message::get_chunk_by_id (int id) {
-    if (root->id == id) {
+    ensure_loaded ();
+
+    if (!root) {
+      return refptr<Chunk> ();
+    } else if (root->id == id) {
       return root;
     } else {
       return root->get_by_id (id);
@@ -486,6 +631,8 @@ namespace Astroid {
   }
 
   vector<refptr<Chunk>> Message::mime_messages () {
+    ensure_loaded ();
+
     /* return a flat vector of mime messages */
 
     vector<refptr<Chunk>> mime_messages;
@@ -508,6 +655,8 @@ namespace Astroid {
   }
 
   vector<refptr<Chunk>> Message::mime_messages_and_attachments () {
+    ensure_loaded ();
+
     /* return a flat vector of mime messages and attachments in correct order */
 
     vector<refptr<Chunk>> parts;
@@ -531,6 +680,8 @@ namespace Astroid {
   }
 
   ustring Message::date () {
+    ensure_loaded ();
+
     if (missing_content) {
       ustring s;
 
@@ -572,6 +723,8 @@ namespace Astroid {
   }
 
   InternetAddressList * Message::to () {
+    ensure_loaded ();
+
     if (missing_content) {
       ustring s;
 
@@ -599,6 +752,8 @@ namespace Astroid {
   }
 
   InternetAddressList * Message::cc () {
+    ensure_loaded ();
+
     if (missing_content) {
       ustring s;
 
@@ -626,6 +781,8 @@ namespace Astroid {
   }
 
   InternetAddressList * Message::bcc () {
+    ensure_loaded ();
+
     if (missing_content) {
       ustring s;
 
@@ -653,6 +810,8 @@ namespace Astroid {
   }
 
   InternetAddressList * Message::other_to () {
+    ensure_loaded ();
+
     InternetAddressList * ret = internet_address_list_new ();
     if (missing_content) {
 
@@ -705,6 +864,8 @@ namespace Astroid {
   }
 
   AddressList Message::list_post () {
+    ensure_loaded ();
+
     if (missing_content) {
       return AddressList ();
     } else {
@@ -732,11 +893,67 @@ namespace Astroid {
     }
   }
 
+  AddressList & Message::to_addresses () {
+    if (!to_a) {
+      InternetAddressList * l = to ();
+      to_a.reset (new AddressList (l));
+      if (missing_content && l) g_object_unref (l); // new list from the cache
+    }
+
+    return *to_a;
+  }
+
+  AddressList & Message::cc_addresses () {
+    if (!cc_a) {
+      InternetAddressList * l = cc ();
+      cc_a.reset (new AddressList (l));
+      if (missing_content && l) g_object_unref (l);
+    }
+
+    return *cc_a;
+  }
+
+  AddressList & Message::bcc_addresses () {
+    if (!bcc_a) {
+      InternetAddressList * l = bcc ();
+      bcc_a.reset (new AddressList (l));
+      if (missing_content && l) g_object_unref (l);
+    }
+
+    return *bcc_a;
+  }
+
+  AddressList & Message::other_to_addresses () {
+    if (!other_to_a) {
+      InternetAddressList * l = other_to (); // always a new list
+      other_to_a.reset (new AddressList (l));
+      g_object_unref (l);
+    }
+
+    return *other_to_a;
+  }
+
+  Address & Message::sender_address () {
+    if (!sender_a) sender_a.reset (new Address (sender));
+
+    return *sender_a;
+  }
+
+  void Message::clear_addresses () {
+    to_a.reset ();
+    cc_a.reset ();
+    bcc_a.reset ();
+    other_to_a.reset ();
+    sender_a.reset ();
+  }
+
   AddressList Message::all_to_from () {
-    return ( AddressList(to()) + AddressList(cc()) + AddressList(bcc()) + AddressList(other_to()) + Address(sender) );
+    return ( to_addresses () + cc_addresses () + bcc_addresses () + other_to_addresses () + sender_address () );
   }
 
   ustring Message::get_filename (ustring appendix) {
+    ensure_loaded ();
+
     ustring _f;
     if (!missing_content) {
       _f = root->get_filename ();
@@ -775,6 +992,8 @@ namespace Astroid {
   }
 
   GMimeMessage * Message::decrypt () {
+    ensure_loaded ();
+
     Crypto c ("application/pgp-encrypted");
 
     return c.decrypt_message (message);
@@ -820,6 +1039,8 @@ namespace Astroid {
   }
 
   void Message::save_to (ustring tofname) {
+    ensure_loaded ();
+
     // apparently boost needs to be compiled with -std=c++0x
     // https://svn.boost.org/trac/boost/ticket/6124
     // copy_file ( path (fname), path (tofname) );
@@ -869,6 +1090,8 @@ namespace Astroid {
   }
 
   refptr<Glib::ByteArray> Message::contents () {
+    ensure_loaded ();
+
     if (missing_content) {
       return Glib::ByteArray::create ();
     } else {
@@ -877,6 +1100,8 @@ namespace Astroid {
   }
 
   refptr<Glib::ByteArray> Message::raw_contents () {
+    ensure_loaded ();
+
     time_t t0 = clock ();
 
     // https://github.com/skx/lumail/blob/master/util/attachments.c
@@ -900,6 +1125,43 @@ namespace Astroid {
     return data;
   }
 
+  refptr<Glib::Bytes> Message::raw_view () {
+    if (raw_from_file && has_file && !missing_content) {
+      int fd = open (fname.c_str (), O_RDONLY);
+
+      if (fd >= 0) {
+        struct stat st;
+        void * p = MAP_FAILED;
+
+        if (fstat (fd, &st) == 0 && st.st_size > 0) {
+          p = mmap (NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        }
+
+        close (fd);
+
+        if (p != MAP_FAILED) {
+          /* unmapped when the last reference is dropped */
+          struct Mapping { void * p; size_t len; };
+          Mapping * m = new Mapping { p, (size_t) st.st_size };
+
+          GBytes * b = g_bytes_new_with_free_func (p, m->len,
+              [] (gpointer d) {
+                Mapping * m = (Mapping *) d;
+                munmap (m->p, m->len);
+                delete m;
+              }, m);
+
+          return Glib::wrap (b);
+        }
+      }
+
+      LOG (warn) << "message: could not map: " << fname << ", copying instead.";
+    }
+
+    auto data = raw_contents ();
+    return Glib::Bytes::create (data->get_data (), data->size ());
+  }
+
   bool Message::is_patch () {
     return (
         (subject.substr(0,3).uppercase() != "RE:") &&
@@ -911,16 +1173,20 @@ namespace Astroid {
   }
 
   bool Message::is_list_post () {
+    ensure_loaded ();
+
     const char * c = g_mime_object_get_header (GMIME_OBJECT(message), "List-Post");
     return (c != NULL);
   }
 
   bool Message::is_encrypted () {
-    return has_tag ("encrypted");
+    static const unsigned int encrypted = Db::tag_id ("encrypted");
+    return has_tag (encrypted);
   }
 
   bool Message::is_signed () {
-    return has_tag ("signed");
+    static const unsigned int sig = Db::tag_id ("signed");
+    return has_tag (sig);
   }
 
   bool Message::has_tag (ustring t) {
@@ -928,6 +1194,11 @@ namespace Astroid {
     else return false;
   }
 
+  bool Message::has_tag (unsigned int id) {
+    if (nmmsg) return nmmsg->has_tag (id);
+    else return false;
+  }
+
   /************
    * exceptions
    * **********
@@ -1030,6 +1301,9 @@ namespace Astroid {
 
     astroid->actions->signal_thread_changed ().connect (
         sigc::mem_fun (this, &MessageThread::on_thread_changed));
+
+    astroid->actions->signal_threads_changed ().connect (
+        sigc::mem_fun (this, &MessageThread::on_threads_changed));
   }
 
   MessageThread::~MessageThread () {
@@ -1088,6 +1362,12 @@ namespace Astroid {
     }
   }
 
+  void MessageThread::on_threads_changed (Db * db, const std::set<ustring> & thread_ids, unsigned long, unsigned long) {
+    if (thread && thread_ids.count (thread->thread_id)) {
+      on_thread_updated (db, thread->thread_id);
+    }
+  }
+
   bool MessageThread::has_tag (ustring t) {
     if (thread) return thread->has_tag (t);
     else return false;
@@ -1098,7 +1378,19 @@ namespace Astroid {
     subject = thread->subject;
     set_first_subject (thread->subject);
 
-    for (auto &mm : thread->messages (db)) {
+    auto mms = thread->messages (db);
+
+# ifndef DISABLE_PLUGINS
+    /* run the process hook of the plugins for all messages in parallel */
+    {
+      std::vector<ustring> fnames;
+      for (auto &mm : mms) fnames.push_back (mm.second->filename);
+
+      astroid->plugin_manager->astroid_extension->process (fnames);
+    }
+# endif
+
+    for (auto &mm : mms) {
       auto m = refptr<Message>(new Message (mm.second, mm.first));
       if (!first_subject_set) set_first_subject(m->subject);
 
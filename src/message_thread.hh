@@ -1,5 +1,7 @@
 # pragma once
 
+# include <set>
+# include <memory>
 # include <notmuch.h>
 # include <gmime/gmime.h>
 
@@ -37,6 +39,13 @@ namespace Astroid {
       void load_message (GMimeMessage *);
       void load_notmuch_cache ();
 
+      /* the MIME tree of a message loaded from a file may be dropped to save
+       * memory (see MessageBudget), it is parsed again when needed. */
+      bool may_unload = false; // set by the thread view for collapsed messages
+      bool loaded ();
+      bool unload ();
+      void ensure_loaded ();
+
       void on_message_updated (Db *, ustring);
       void refresh (Db *);
 
@@ -51,6 +60,14 @@ namespace Astroid {
       InternetAddressList * bcc ();
       InternetAddressList * other_to ();
 
+      /* the parsed addresses of the headers, these are parsed on first
+       * use and kept until the message is loaded again. */
+      AddressList & to_addresses ();
+      AddressList & cc_addresses ();
+      AddressList & bcc_addresses ();
+      AddressList & other_to_addresses ();
+      Address     & sender_address ();
+
       /* address list with all addresses in all headers beginning with to
        * and ending with from */
       AddressList all_to_from ();
@@ -83,12 +100,18 @@ namespace Astroid {
       refptr<Glib::ByteArray> contents ();
       refptr<Glib::ByteArray> raw_contents ();
 
+      /* the raw message without copying it: the file is mapped if the
+       * message was parsed from it unchanged, otherwise the same as
+       * raw_contents (). */
+      refptr<Glib::Bytes> raw_view ();
+
       bool is_patch ();
       bool is_different_subject ();
       bool is_encrypted ();
       bool is_signed ();
       bool is_list_post ();
       bool has_tag (ustring);
+      bool has_tag (unsigned int id); // id from Db::tag_id
 
       GMimeMessage * decrypt ();
 
@@ -110,6 +133,22 @@ namespace Astroid {
 
       bool subject_is_different = true;
       bool process = true;
+
+      /* the message was parsed from fname as is (not through a plugin) */
+      bool raw_from_file = false;
+
+      /* loaded from fname, and the ids and shape of the chunk tree when it
+       * was unloaded: the thread view refers to the chunks by id, so a
+       * tree parsed again is given the same ids. */
+      bool from_file = false;
+      std::vector<int>    chunk_ids;
+      std::vector<size_t> chunk_shape;
+
+      static void chunk_layout (refptr<Chunk>, std::vector<refptr<Chunk>> &, std::vector<size_t> &);
+
+      std::unique_ptr<AddressList> to_a, cc_a, bcc_a, other_to_a;
+      std::unique_ptr<Address>     sender_a;
+      void clear_addresses ();
   };
 
   /* exceptions */
@@ -147,6 +186,7 @@ namespace Astroid {
 
       void on_thread_updated (Db * db, ustring tid);
       void on_thread_changed (Db * db, ustring tid);
+      void on_threads_changed (Db * db, const std::set<ustring> &, unsigned long, unsigned long);
 
     public:
       refptr<NotmuchThread> thread;
@@ -411,6 +411,20 @@ namespace Astroid {
           return true;
         });
 
+    keys.register_key ("t", "edit_message.add_to",
+        "Add recipients (To)",
+        [&] (Key) {
+          add_recipients (false);
+          return true;
+        });
+
+    keys.register_key ("c", "edit_message.add_cc",
+        "Add recipients (Cc)",
+        [&] (Key) {
+          add_recipients (true);
+          return true;
+        });
+
     keys.register_key ("s", "edit_message.save_draft",
         "Save draft",
         [&] (Key) {
@@ -662,6 +676,34 @@ namespace Astroid {
 
   }
 
+  void EditMessage::add_recipients (bool to_cc) {
+    if (editor_active) {
+      set_warning ("Cannot change recipients when editing.");
+      return;
+    }
+
+    if (message_sent || sending_in_progress.load ()) return;
+
+    main_window->enable_command (CommandBar::CommandMode::Recipients,
+        to_cc ? "Cc:" : "To:", "", [&, to_cc] (ustring addresses)
+        {
+          UstringUtils::trim (addresses);
+
+          /* drop a trailing separator */
+          while (!addresses.empty () && (addresses[addresses.size () - 1] == ',' || addresses[addresses.size () - 1] == ' ')) {
+            addresses.erase (addresses.size () - 1);
+          }
+
+          if (addresses.empty ()) return;
+
+          ustring & field = to_cc ? cc : to;
+          field = field.empty () ? addresses : (field + ", " + addresses);
+
+          prepare_message ();
+          read_edited_message ();
+        });
+  }
+
   /* edit / read message cycling {{{ */
   void EditMessage::on_from_combo_changed () {
     /* this will be called when the From: field has been changed
@@ -80,6 +80,9 @@ namespace Astroid {
       void add_attachment (ComposeMessage::Attachment *);
       void attach_file ();
 
+      /* add addresses to To or Cc using the command bar */
+      void add_recipients (bool cc);
+
       /* from combobox */
       class FromColumns : public Gtk::TreeModel::ColumnRecord {
         public:
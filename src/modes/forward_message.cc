@@ -61,10 +61,10 @@ namespace Astroid {
       quoted << "From: " << msg->sender << endl;
       quoted << "Date: " << msg->pretty_verbose_date() << endl;
       quoted << "Subject: " << msg->subject << endl;
-      quoted << "To: " << AddressList(msg->to()).str () << endl;
-      auto cc = AddressList (msg->cc());
+      quoted << "To: " << msg->to_addresses ().str () << endl;
+      AddressList & cc = msg->cc_addresses ();
       if (cc.addresses.size () > 0)
-        quoted << "Cc: " << AddressList(msg->cc()).str () << endl;
+        quoted << "Cc: " << cc.str () << endl;
       quoted << endl;
 
       string vt = msg->quote ();
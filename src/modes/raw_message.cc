@@ -138,8 +138,8 @@ namespace Astroid {
       s << "Filename: (none, memory)"<< endl << endl;
     }
 
-    auto c = msg->raw_contents ();
-    auto cnv = UstringUtils::bytearray_to_ustring (c);
+    auto c = msg->raw_view ();
+    auto cnv = UstringUtils::bytes_to_ustring (c);
 
     if (cnv.first) {
       s << cnv.second;
@@ -237,20 +237,20 @@ namespace Astroid {
         al += msg_from;
       }
 
-      al += AddressList (msg->to());
+      al += msg->to_addresses ();
 
       al.remove_me ();
       al.remove_duplicates ();
 
       to = al.str ();
 
-      AddressList ac (msg->cc ());
+      AddressList ac (msg->cc_addresses ());
       ac.remove_me ();
       ac.remove_duplicates ();
       ac -= al;
       cc = ac.str ();
 
-      AddressList acc (msg->bcc ());
+      AddressList acc (msg->bcc_addresses ());
       acc.remove_me ();
       acc.remove_duplicates ();
       acc -= al;
@@ -275,13 +275,13 @@ namespace Astroid {
       al.remove_duplicates ();
       to = al.str ();
 
-      AddressList ac (msg->cc ());
+      AddressList ac (msg->cc_addresses ());
       ac -= al;
       ac.remove_me ();
       ac.remove_duplicates ();
       cc = ac.str ();
 
-      AddressList acc (msg->bcc ());
+      AddressList acc (msg->bcc_addresses ());
       acc -= al;
       acc -= ac;
       acc.remove_me ();
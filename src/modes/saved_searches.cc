@@ -15,6 +15,10 @@ namespace Astroid {
   Glib::Dispatcher SavedSearches::m_reload;
   std::vector<ustring> SavedSearches::history;
 
+  std::mutex     SavedSearches::prefetched_m;
+  unsigned long  SavedSearches::prefetched_revision = 0;
+  std::map<ustring, std::pair<unsigned int, unsigned int>> SavedSearches::prefetched;
+
   SavedSearches::SavedSearches (MainWindow * mw) : Mode (mw) {
     set_label ("Saved searches");
 
@@ -464,6 +468,9 @@ namespace Astroid {
     astroid->actions->signal_thread_changed ().connect (
         sigc::mem_fun (this, &SavedSearches::on_thread_changed));
 
+    astroid->actions->signal_threads_changed ().connect (
+        sigc::mem_fun (this, &SavedSearches::on_threads_changed));
+
     astroid->actions->signal_refreshed ().connect (
         sigc::mem_fun (this, &SavedSearches::reload));
   }
@@ -517,6 +524,10 @@ namespace Astroid {
     refresh_stats_db (db);
   }
 
+  void SavedSearches::on_threads_changed (Db * db, const std::set<ustring> &, unsigned long, unsigned long) {
+    refresh_stats_db (db);
+  }
+
   void SavedSearches::refresh_stats () {
     Db db;
     refresh_stats_db (&db);
@@ -539,27 +550,10 @@ namespace Astroid {
       ustring query = row[m_columns.m_col_query];
 
       unsigned int total_messages, unread_messages;
-      notmuch_status_t st = NOTMUCH_STATUS_SUCCESS;
 
-      /* get stats */
-      notmuch_query_t * query_t =  notmuch_query_create (db->nm_db, query.c_str ());
-      for (ustring & t : db->excluded_tags) {
-        notmuch_query_add_tag_exclude (query_t, t.c_str());
+      if (!get_prefetched_stats (db, query, total_messages, unread_messages)) {
+        count_query (db, query, total_messages, unread_messages);
       }
-      notmuch_query_set_omit_excluded (query_t, NOTMUCH_EXCLUDE_TRUE);
-      st = notmuch_query_count_messages (query_t, &total_messages); // destructive
-      if (st != NOTMUCH_STATUS_SUCCESS) total_messages = 0;
-      notmuch_query_destroy (query_t);
-
-      ustring unread_q_s = "(" + query + ") AND tag:unread";
-      notmuch_query_t * unread_q = notmuch_query_create (db->nm_db, unread_q_s.c_str());
-      for (ustring & t : db->excluded_tags) {
-        notmuch_query_add_tag_exclude (unread_q, t.c_str());
-      }
-      notmuch_query_set_omit_excluded (unread_q, NOTMUCH_EXCLUDE_TRUE);
-      st = notmuch_query_count_messages (unread_q, &unread_messages); // destructive
-      if (st != NOTMUCH_STATUS_SUCCESS) unread_messages = 0;
-      notmuch_query_destroy (unread_q);
 
       row[m_columns.m_col_unread_messages] = unread_messages;
       row[m_columns.m_col_unread_messages_s] = ustring::compose ("(unread: %1)", unread_messages);
@@ -567,6 +561,81 @@ namespace Astroid {
     }
   }
 
+  void SavedSearches::count_query (Db * db, ustring query, unsigned int &total_messages, unsigned int &unread_messages) {
+    notmuch_status_t st = NOTMUCH_STATUS_SUCCESS;
+
+    /* get stats */
+    notmuch_query_t * query_t =  notmuch_query_create (db->nm_db, query.c_str ());
+    for (ustring & t : db->excluded_tags) {
+      notmuch_query_add_tag_exclude (query_t, t.c_str());
+    }
+    notmuch_query_set_omit_excluded (query_t, NOTMUCH_EXCLUDE_TRUE);
+    st = notmuch_query_count_messages (query_t, &total_messages); // destructive
+    if (st != NOTMUCH_STATUS_SUCCESS) total_messages = 0;
+    notmuch_query_destroy (query_t);
+
+    ustring unread_q_s = "(" + query + ") AND tag:unread";
+    notmuch_query_t * unread_q = notmuch_query_create (db->nm_db, unread_q_s.c_str());
+    for (ustring & t : db->excluded_tags) {
+      notmuch_query_add_tag_exclude (unread_q, t.c_str());
+    }
+    notmuch_query_set_omit_excluded (unread_q, NOTMUCH_EXCLUDE_TRUE);
+    st = notmuch_query_count_messages (unread_q, &unread_messages); // destructive
+    if (st != NOTMUCH_STATUS_SUCCESS) unread_messages = 0;
+    notmuch_query_destroy (unread_q);
+  }
+
+  void SavedSearches::prefetch_stats () {
+    std::vector<ustring> queries;
+
+    for (const auto &kv : astroid->config ("startup.queries")) {
+      queries.push_back (kv.second.data ());
+    }
+
+    for (const auto &kv : load_searches ().get_child ("saved")) {
+      queries.push_back (kv.second.data ());
+    }
+
+    Db db;
+    unsigned long revision = db.get_revision ();
+
+    std::map<ustring, std::pair<unsigned int, unsigned int>> counts;
+
+    for (auto &q : queries) {
+      unsigned int total_messages, unread_messages;
+      count_query (&db, q, total_messages, unread_messages);
+      counts[q] = std::make_pair (total_messages, unread_messages);
+    }
+
+    db.close ();
+
+    LOG (debug) << "searches: prefetched stats for " << counts.size () << " queries.";
+
+    std::lock_guard<std::mutex> lk (prefetched_m);
+    prefetched_revision = revision;
+    prefetched.swap (counts);
+  }
+
+  bool SavedSearches::get_prefetched_stats (Db * db, ustring query, unsigned int &total_messages, unsigned int &unread_messages) {
+    std::lock_guard<std::mutex> lk (prefetched_m);
+
+    if (prefetched.empty ()) return false;
+
+    /* only valid as long as nothing has changed */
+    if (db->get_revision () != prefetched_revision) {
+      prefetched.clear ();
+      return false;
+    }
+
+    auto fnd = prefetched.find (query);
+    if (fnd == prefetched.end ()) return false;
+
+    total_messages  = fnd->second.first;
+    unread_messages = fnd->second.second;
+
+    return true;
+  }
+
   void SavedSearches::load_startup_queries () {
     /* add description */
     auto iter = store->append();
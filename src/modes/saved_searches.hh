@@ -1,5 +1,9 @@
 # pragma once
 
+# include <mutex>
+# include <map>
+# include <set>
+
 # include "mode.hh"
 # include <boost/property_tree/ptree.hpp>
 
@@ -22,6 +26,13 @@ namespace Astroid {
       static void init ();
       static void destruct ();
 
+      /* message counts of startup queries and saved searches, computed
+       * in the background on start up. */
+      static void prefetch_stats ();
+      static bool get_prefetched_stats (Db *, ustring query, unsigned int &total, unsigned int &unread);
+
+      static void count_query (Db *, ustring query, unsigned int &total, unsigned int &unread);
+
     private:
       static ptree load_searches ();
       static void write_back_searches (ptree);
@@ -30,7 +41,12 @@ namespace Astroid {
 
       static Glib::Dispatcher m_reload;
 
+      static std::mutex     prefetched_m;
+      static unsigned long  prefetched_revision;
+      static std::map<ustring, std::pair<unsigned int, unsigned int>> prefetched;
+
       void on_thread_changed (Db *, ustring);
+      void on_threads_changed (Db *, const std::set<ustring> &, unsigned long, unsigned long);
       void load_startup_queries ();
       void load_saved_searches ();
       void add_query (ustring, ustring, bool saved = false, bool history = false);
@@ -0,0 +1,145 @@
+# include <algorithm>
+
+# include "astroid.hh"
+# include "config.hh"
+# include "loader_scheduler.hh"
+
+namespace Astroid {
+  std::mutex                LoaderScheduler::m;
+  std::condition_variable   LoaderScheduler::cv;
+  unsigned int              LoaderScheduler::slots   = 2;
+  unsigned int              LoaderScheduler::running = 0;
+  LoaderScheduler::ticket   LoaderScheduler::next_ticket = 1;
+  std::map<LoaderScheduler::ticket, LoaderScheduler::Entry> LoaderScheduler::entries;
+
+  void LoaderScheduler::init () {
+    slots = std::max (1u, astroid->config ().get<unsigned int> ("thread_index.loader_slots"));
+  }
+
+  LoaderScheduler::ticket LoaderScheduler::enqueue (ustring name, Priority p) {
+    std::lock_guard<std::mutex> lk (m);
+
+    ticket t = next_ticket++;
+
+    Entry e;
+    e.name     = name;
+    e.priority = p;
+    e.queued   = std::chrono::steady_clock::now ();
+
+    entries[t] = e;
+
+    return t;
+  }
+
+  void LoaderScheduler::set_priority (ticket t, Priority p) {
+    std::lock_guard<std::mutex> lk (m);
+
+    auto e = entries.find (t);
+    if (e == entries.end () || e->second.priority == p) return;
+
+    e->second.priority = p;
+    cv.notify_all ();
+  }
+
+  int LoaderScheduler::waiting () {
+    int n = 0;
+    for (auto &e : entries) if (!e.second.running) n++;
+    return n;
+  }
+
+  bool LoaderScheduler::may_run (ticket t) {
+    if (running >= slots) return false;
+
+    /* the first waiting loader of the highest priority goes first */
+    const Entry & me = entries.at (t);
+
+    for (auto &e : entries) {
+      if (e.first == t || e.second.running) continue;
+
+      if (e.second.priority > me.priority ||
+          (e.second.priority == me.priority && e.first < t)) {
+        return false;
+      }
+    }
+
+    return true;
+  }
+
+  bool LoaderScheduler::acquire (ticket t, const std::atomic<bool> & run) {
+    std::unique_lock<std::mutex> lk (m);
+
+    if (!entries.count (t)) return false;
+
+    LOG (debug) << "ls: " << entries.at (t).name << ": waiting for slot (running: " << running << "/" << slots << ", waiting: " << waiting () << ")";
+
+    time_point t0 = std::chrono::steady_clock::now ();
+
+    while (!may_run (t)) {
+      if (!run) return false;
+      cv.wait_for (lk, std::chrono::milliseconds (100));
+      if (!entries.count (t)) return false;
+    }
+
+    Entry & e  = entries.at (t);
+    e.running  = true;
+    e.started  = std::chrono::steady_clock::now ();
+    running++;
+
+    LOG (debug) << "ls: " << e.name << ": running after waiting: " << std::chrono::duration<double, std::milli> (e.started - t0).count () << " ms.";
+
+    return true;
+  }
+
+  bool LoaderScheduler::should_yield (ticket t) {
+    std::lock_guard<std::mutex> lk (m);
+
+    auto me = entries.find (t);
+    if (me == entries.end () || running < slots) return false;
+
+    for (auto &e : entries) {
+      if (!e.second.running && e.second.priority > me->second.priority) return true;
+    }
+
+    return false;
+  }
+
+  bool LoaderScheduler::pause (ticket t, const std::atomic<bool> & run) {
+    {
+      std::lock_guard<std::mutex> lk (m);
+
+      auto e = entries.find (t);
+      if (e == entries.end () || !e->second.running) return false;
+
+      e->second.running   = false;
+      e->second.run_time += std::chrono::duration<double, std::milli> (std::chrono::steady_clock::now () - e->second.started).count ();
+      e->second.pauses++;
+      running--;
+
+      LOG (debug) << "ls: " << e->second.name << ": pausing for loader with higher priority (waiting: " << waiting () << ")";
+
+      cv.notify_all ();
+    }
+
+    return acquire (t, run);
+  }
+
+  void LoaderScheduler::done (ticket t) {
+    std::lock_guard<std::mutex> lk (m);
+
+    auto e = entries.find (t);
+    if (e == entries.end ()) return;
+
+    Entry d = e->second;
+    entries.erase (e);
+
+    if (d.running) {
+      d.run_time += std::chrono::duration<double, std::milli> (std::chrono::steady_clock::now () - d.started).count ();
+      running--;
+    }
+
+    LOG (debug) << "ls: " << d.name << ": done, run time: " << d.run_time << " ms, total: " << std::chrono::duration<double, std::milli> (std::chrono::steady_clock::now () - d.queued).count () << " ms, paused: " << d.pauses << " times (running: " << running << "/" << slots << ", waiting: " << waiting () << ")";
+
+    cv.notify_all ();
+  }
+}
+
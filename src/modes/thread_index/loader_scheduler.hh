@@ -0,0 +1,80 @@
+# pragma once
+
+# include <mutex>
+# include <condition_variable>
+# include <atomic>
+# include <map>
+# include <chrono>
+
+# include "astroid.hh"
+
+namespace Astroid {
+  /* limits the number of query loaders scanning the database at the same
+   * time. this is a gate, not a pool: every loader still runs on its own
+   * thread, which waits here for a slot.
+   *
+   * a loader asks for a slot before it starts and checks in regularly
+   * while loading. loaders of visible thread indexes are served before
+   * background loaders, and a background loader pauses (giving up its
+   * slot) when a visible loader is waiting and no slot is free. it resumes
+   * once a slot is available again, the threads loaded so far stay in the
+   * list.
+   *
+   * a loader must not hold a database open while waiting for a slot: a
+   * waiting writer blocks new readers, so the loader holding the slot
+   * could not open its database. */
+  class LoaderScheduler {
+    public:
+      enum Priority {
+        BACKGROUND = 0,
+        VISIBLE    = 1,
+      };
+
+      typedef unsigned long ticket;
+
+      static void init ();
+
+      /* register a loader, it does not run until acquire () */
+      static ticket enqueue (ustring name, Priority);
+      static void   set_priority (ticket, Priority);
+
+      /* wait for a slot, returns false if run was cleared while waiting */
+      static bool   acquire (ticket, const std::atomic<bool> & run);
+
+      /* a loader with higher priority is waiting for the slot */
+      static bool   should_yield (ticket);
+
+      /* give up the slot and wait for it again, the database must be
+       * closed meanwhile */
+      static bool   pause (ticket, const std::atomic<bool> & run);
+
+      /* release the slot and forget the loader */
+      static void   done (ticket);
+
+    private:
+      typedef std::chrono::time_point<std::chrono::steady_clock> time_point;
+
+      struct Entry {
+        ustring    name;
+        Priority   priority;
+        bool       running = false;
+        int        pauses  = 0;
+        time_point queued;
+        time_point started;
+        double     run_time = 0; // ms, excluding pauses
+      };
+
+      static std::mutex m;
+      static std::condition_variable cv;
+
+      static unsigned int slots;
+      static unsigned int running;
+
+      static ticket next_ticket;
+      static std::map<ticket, Entry> entries;
+
+      static bool may_run (ticket);
+      static int  waiting ();
+  };
+}
+
@@ -6,11 +6,14 @@
 # include "thread_index_list_view.hh"
 # include "config.hh"
 # include "actions/action_manager.hh"
+# include "modes/saved_searches.hh"
+# include "query_snapshots.hh"
 
 # include <thread>
 # include <queue>
 # include <mutex>
 # include <functional>
+# include <chrono>
 
 # include <notmuch.h>
 
@@ -38,6 +41,7 @@ namespace Astroid {
     total_messages = 0;
     unread_messages = 0;
     run = false;
+    complete = false;
 
     queue_has_data.connect (
         sigc::mem_fun (this, &QueryLoader::to_list_adder));
@@ -48,6 +52,9 @@ namespace Astroid {
     astroid->actions->signal_thread_changed ().connect (
         sigc::mem_fun (this, &QueryLoader::on_thread_changed));
 
+    astroid->actions->signal_threads_changed ().connect (
+        sigc::mem_fun (this, &QueryLoader::on_threads_changed));
+
     astroid->actions->signal_refreshed ().connect (
         sigc::mem_fun (this, &QueryLoader::on_refreshed));
   }
@@ -63,7 +70,25 @@ namespace Astroid {
   void QueryLoader::start (ustring q) {
     std::lock_guard<std::mutex> lk (loader_m);
     query = q;
+
+    /* threads still referred to elsewhere keep the previous arena alive */
+    arena = std::make_shared<StringArena> ();
+
+    /* the rows are kept in the order of this loader, also when the sort
+     * was changed while loading */
+    if (list_store->sort != sort) {
+      LOG (debug) << "ql (" << id << "): list store was sorted by: " << sort_strings[static_cast<int> (list_store->sort)] << ", now: " << sort_strings[static_cast<int> (sort)];
+      list_store->sort = sort;
+    }
+
+    if (attach_snapshot ()) return;
+
     run = true;
+    complete = false;
+
+    sched_ticket = LoaderScheduler::enqueue (query,
+        visible ? LoaderScheduler::VISIBLE : LoaderScheduler::BACKGROUND);
+
     loader_thread = std::thread (&QueryLoader::loader, this);
   }
 
@@ -71,12 +96,32 @@ namespace Astroid {
     LOG (debug) << "ql (" << id << "): stopping loader...";
     in_destructor = _in_destructor;
 
+    catch_up_c.disconnect ();
+
     run = false;
     if (loader_thread.joinable ()) loader_thread.join ();
+
+    if (sched_ticket) {
+      LoaderScheduler::done (sched_ticket);
+      sched_ticket = 0;
+    }
+  }
+
+  void QueryLoader::set_visible (bool v) {
+    visible = v;
+
+    if (sched_ticket) {
+      LoaderScheduler::set_priority (sched_ticket,
+          visible ? LoaderScheduler::VISIBLE : LoaderScheduler::BACKGROUND);
+    }
   }
 
   void QueryLoader::reload () {
     stop ();
+
+    /* explicitly reloading reads the query from the database again */
+    QuerySnapshots::remove (query);
+
     std::lock_guard<std::mutex> lk (to_list_m);
     list_store->clear ();
 
@@ -87,12 +132,66 @@ namespace Astroid {
 
   void QueryLoader::refine_query (ustring q) {
     query = q;
-    reload ();
+
+    if (loading () || !refine ()) {
+      reload ();
+    }
+  }
+
+  bool QueryLoader::refine () {
+    /* a refined query (e.g. 'tag:inbox' to 'tag:inbox and from:alice')
+     * mostly matches threads that are already loaded. only the thread ids
+     * of the new query are looked up: rows that no longer match are removed
+     * and the few new threads are added. */
+    auto t0 = std::chrono::steady_clock::now ();
+
+    Db db (Db::DATABASE_READ_ONLY);
+
+    std::set<ustring> tids;
+    if (!db.thread_ids_in_query (query, tids)) return false;
+
+    std::vector<Gtk::TreeIter> remove;
+    std::set<ustring> loaded;
+
+    for (Gtk::TreeIter fwditer = list_store->children ().begin (); fwditer; fwditer++) {
+      ustring tid = (*fwditer)[list_store->columns.thread_id];
+
+      if (tids.count (tid)) {
+        loaded.insert (tid);
+      } else {
+        remove.push_back (fwditer);
+      }
+    }
+
+    unsigned int added = tids.size () - loaded.size ();
+
+    if (added > max_refine_added) {
+      LOG (debug) << "ql (" << id << "): refine: " << added << " new threads, loading query again.";
+      return false;
+    }
+
+    for (auto &iter : remove) list_store->erase (iter);
+
+    for (auto &tid : tids) {
+      if (!loaded.count (tid)) add_thread (&db, tid);
+    }
+
+    loaded_threads = list_store->children ().size ();
+
+    LOG (info) << "ql (" << id << "): refined to: " << query << ", kept: " << loaded.size () << ", removed: " << remove.size () << ", added: " << added << ", in: " << std::chrono::duration<double, std::milli> (std::chrono::steady_clock::now () - t0).count () << " ms.";
+
+    refresh_stats_db (&db);
+    if (!in_destructor) stats_ready.emit ();
+
+    return true;
   }
 
   void QueryLoader::refresh_stats_db (Db * db) {
     LOG (debug) << "ql: refresh stats..";
 
+    /* counts may have been computed on start up */
+    if (SavedSearches::get_prefetched_stats (db, query, total_messages, unread_messages)) return;
+
     notmuch_status_t st = NOTMUCH_STATUS_SUCCESS;
 
     notmuch_query_t * query_t =  notmuch_query_create (db->nm_db, query.c_str ());
@@ -118,46 +217,83 @@ namespace Astroid {
   void QueryLoader::loader () {
     std::lock_guard<std::mutex> loader_lk (loader_m);
 
-    Db db (Db::DATABASE_READ_ONLY);
-    refresh_stats_db (&db);
+    /* wait for a turn to scan the database */
+    if (!LoaderScheduler::acquire (sched_ticket, run)) {
+      LOG (debug) << "ql (" << id << "): stopped before loading.";
+      return;
+    }
+
+    std::unique_ptr<Db> db (new Db (Db::DATABASE_READ_ONLY));
+    refresh_stats_db (db.get ());
     if (!in_destructor) stats_ready.emit ();
 
+    revision = db->get_revision ();
+
+    /* a loader sorted by date can give way to a visible loader: it closes
+     * the database while paused (a paused reader would otherwise hold up
+     * a waiting writer, and with it the visible loader) and continues
+     * with the threads from the date of the last loaded thread. the
+     * threads seen again are skipped. other loaders run to the end. */
+    bool can_pause = (sort == NOTMUCH_SORT_NEWEST_FIRST || sort == NOTMUCH_SORT_OLDEST_FIRST);
+    std::set<std::string> loaded_tids;
+    time_t last_date = 0;
+
     /* set up query */
     notmuch_threads_t * threads = NULL;
+    notmuch_query_t * nmquery = NULL;
 
-    notmuch_query_t * nmquery = notmuch_query_create (db.nm_db, query.c_str ());
-    for (ustring & t : db.excluded_tags) {
-      notmuch_query_add_tag_exclude (nmquery, t.c_str());
-    }
+    auto open_query = [&] (ustring q) {
+      nmquery = notmuch_query_create (db->nm_db, q.c_str ());
+      for (ustring & t : db->excluded_tags) {
+        notmuch_query_add_tag_exclude (nmquery, t.c_str());
+      }
 
-    notmuch_query_set_omit_excluded (nmquery, NOTMUCH_EXCLUDE_TRUE);
-    notmuch_query_set_sort (nmquery, sort);
+      notmuch_query_set_omit_excluded (nmquery, NOTMUCH_EXCLUDE_TRUE);
+      notmuch_query_set_sort (nmquery, sort);
 
-    /* slow */
-    notmuch_status_t st = NOTMUCH_STATUS_SUCCESS;
-    st = notmuch_query_search_threads (nmquery, &threads);
+      /* slow */
+      notmuch_status_t st = notmuch_query_search_threads (nmquery, &threads);
 
-    if (st != NOTMUCH_STATUS_SUCCESS) {
-      LOG (error) << "ql: could not get threads for query: " << query;
-      run = false;
-    }
+      if (st != NOTMUCH_STATUS_SUCCESS) {
+        LOG (error) << "ql: could not get threads for query: " << q;
+        threads = NULL;
+        return false;
+      }
+
+      return true;
+    };
+
+    if (!open_query (query)) run = false;
 
     loaded_threads = 0; // incremented in list_adder
     int i = 0;
+    size_t memory = 0;
 
-    for (;
-         run && notmuch_threads_valid (threads);
-         notmuch_threads_move_to_next (threads)) {
+    while (run && threads && notmuch_threads_valid (threads)) {
 
       notmuch_thread_t  * thread;
       thread = notmuch_threads_get (threads);
 
+      /* move on already, the threads may be replaced when pausing */
+      notmuch_threads_move_to_next (threads);
+
       if (thread == NULL) {
         LOG (error) << "ql: error: could not get thread.";
         throw database_error ("ql: could not get thread (is NULL)");
       }
 
-      NotmuchThread *t = new NotmuchThread (thread);
+      if (can_pause) {
+        const char * tid = notmuch_thread_get_thread_id (thread);
+
+        if (!loaded_tids.insert (tid).second) {
+          notmuch_thread_destroy (thread);
+          continue;
+        }
+      }
+
+      NotmuchThread *t = new NotmuchThread (thread, arena);
+      memory += t->memory_usage ();
+      last_date = (sort == NOTMUCH_SORT_NEWEST_FIRST) ? t->newest_date : t->oldest_date;
 
       notmuch_thread_destroy (thread);
 
@@ -172,12 +308,53 @@ namespace Astroid {
       if ((i % 100) == 0) {
         if (run && !in_destructor)
           queue_has_data.emit ();
+
+        /* give way to the loader of a visible thread index, the threads
+         * loaded so far are shown meanwhile */
+        if (can_pause && LoaderScheduler::should_yield (sched_ticket)) {
+          notmuch_threads_destroy (threads);
+          notmuch_query_destroy (nmquery);
+          threads = NULL;
+          nmquery = NULL;
+
+          db->close ();
+          db.reset ();
+
+          if (!LoaderScheduler::pause (sched_ticket, run)) break;
+
+          db.reset (new Db (Db::DATABASE_READ_ONLY));
+
+          unsigned long rev = db->get_revision ();
+          if (rev != revision) {
+            /* the threads loaded before the pause are updated by the
+             * deferred changed signals. the snapshot keeps the revision
+             * of the start so that it is caught up with the changes. */
+            LOG (debug) << "ql (" << id << "): database changed while paused (revision: " << revision << " -> " << rev << ")";
+          }
+
+          ustring range = (sort == NOTMUCH_SORT_NEWEST_FIRST) ?
+            ustring::compose ("date:..@%1", last_date) :
+            ustring::compose ("date:@%1..", last_date);
+
+          if (!open_query (ustring::compose ("(%1) and %2", query, range))) break;
+        }
       }
     }
 
+    complete = run.load ();
+
     /* closing query */
-    notmuch_threads_destroy (threads);
-    notmuch_query_destroy (nmquery);
+    if (threads) notmuch_threads_destroy (threads);
+    if (nmquery) notmuch_query_destroy (nmquery);
+
+    LoaderScheduler::done (sched_ticket);
+
+    if (i > 0) {
+      LOG (info) << "ql (" << id << "): loaded " << i << " threads, memory: "
+        << (memory + arena->bytes ()) / i << " bytes per row (threads: "
+        << memory << " bytes, arena: " << arena->bytes () << " bytes, "
+        << arena->strings () << " distinct authors)";
+    }
 
     run = false; // on_thread_changed will not check lock
 
@@ -191,23 +368,18 @@ namespace Astroid {
     if (!in_destructor)
       deferred_threads_d.emit ();
 
-    db.close ();
+    if (db) db->close ();
   }
 
   void QueryLoader::to_list_adder () {
     std::lock_guard<std::mutex> lk (to_list_m);
+    bool added = !to_list_store.empty ();
 
     while (!to_list_store.empty ()) {
       refptr<NotmuchThread> t = to_list_store.front ();
       to_list_store.pop ();
 
-      auto iter = list_store->append ();
-      Gtk::ListStore::Row row = *iter;
-
-      row[list_store->columns.newest_date] = t->newest_date;
-      row[list_store->columns.oldest_date] = t->oldest_date;
-      row[list_store->columns.thread_id]   = t->thread_id;
-      row[list_store->columns.thread]      = t;
+      list_store->append_thread (t);
 
       if (loaded_threads == 0) {
         if (!in_destructor)
@@ -221,6 +393,89 @@ namespace Astroid {
         if (!in_destructor && !list_view->filter_txt.empty()) stats_ready.emit ();
       }
     }
+
+    /* the rows are appended in the order of the query, which may differ
+     * slightly from the order used for the list (notmuch only considers
+     * the matching messages). */
+    if (added && !run && !in_destructor) {
+      list_store->sort_rows (sort);
+
+      if (complete) store_snapshot ();
+    }
+  }
+
+  bool QueryLoader::attach_snapshot () {
+    QuerySnapshots::Snapshot snap;
+    if (!QuerySnapshots::get (query, snap)) return false;
+
+    {
+      std::lock_guard<std::mutex> lk (to_list_m);
+      for (auto &t : snap.threads) list_store->append_thread (t);
+    }
+
+    list_store->sort_rows (sort);
+
+    loaded_threads = snap.threads.size ();
+    revision = snap.revision;
+
+    if (loaded_threads > 0 && !in_destructor) first_thread_ready.emit ();
+
+    LOG (info) << "ql (" << id << "): attached to snapshot of: " << query << ", " << loaded_threads << " threads at revision " << snap.revision;
+
+    /* the list is shown before catching up with the database */
+    catch_up_c = Glib::signal_idle ().connect (
+        sigc::mem_fun (this, &QueryLoader::catch_up));
+
+    return true;
+  }
+
+  bool QueryLoader::catch_up () {
+    if (in_destructor) return false;
+
+    auto t0 = std::chrono::steady_clock::now ();
+
+    Db db (Db::DATABASE_READ_ONLY);
+    unsigned long rev = db.get_revision ();
+
+    if (rev != revision) {
+      /* all messages changed since the snapshot, including those that have
+       * left the query */
+      std::set<ustring> changed;
+      ustring lastmod = ustring::compose ("lastmod:%1..%2", revision + 1, rev);
+
+      if (!db.thread_ids_in_query (lastmod, changed, false) || changed.size () > max_catch_up) {
+        LOG (info) << "ql (" << id << "): snapshot too old (" << changed.size () << " changed threads), loading query again.";
+        db.close ();
+        reload ();
+        return false;
+      }
+
+      LOG (debug) << "ql (" << id << "): catching up with " << changed.size () << " changed threads since revision: " << revision;
+
+      on_threads_changed (&db, changed, revision + 1, rev);
+
+      revision = rev;
+      store_snapshot ();
+    }
+
+    refresh_stats_db (&db);
+    stats_ready.emit ();
+
+    LOG (debug) << "ql: caught up with revision " << rev << " in: " << std::chrono::duration<double, std::milli> (std::chrono::steady_clock::now () - t0).count () << " ms.";
+
+    return false;
+  }
+
+  void QueryLoader::store_snapshot () {
+    std::vector<refptr<NotmuchThread>> threads;
+    threads.reserve (list_store->children ().size ());
+
+    for (auto iter = list_store->children ().begin (); iter; iter++) {
+      refptr<NotmuchThread> t = (*iter)[list_store->columns.thread];
+      threads.push_back (t);
+    }
+
+    QuerySnapshots::store (query, revision, std::move (threads));
   }
 
   void QueryLoader::update_deferred_changed_threads () {
@@ -228,12 +483,20 @@ namespace Astroid {
     if (!in_destructor) {
       Db db (Db::DATABASE_READ_ONLY);
 
+      std::set<ustring> tids;
+
       while (!changed_threads.empty ()) {
         ustring tid = changed_threads.front ();
         changed_threads.pop ();
         LOG (debug) << "ql: deferred update of: " << tid;
-        on_thread_changed (&db, tid);
+        tids.insert (tid);
       }
+
+      if (!tids.empty ()) {
+        unsigned long rev = db.get_revision ();
+        on_threads_changed (&db, tids, rev, rev);
+      }
+
       db.close ();
     }
   }
@@ -249,6 +512,7 @@ namespace Astroid {
     if (in_destructor) return;
 
     LOG (warn) << "ql (" << id << "): got refreshed signal.";
+    QuerySnapshots::clear ();
     reload ();
   }
 
@@ -312,8 +576,7 @@ namespace Astroid {
         LOG (debug) << "ql: updated";
         refptr<NotmuchThread> thread = row[list_store->columns.thread];
         thread->refresh (db);
-        row[list_store->columns.newest_date] = thread->newest_date;
-        row[list_store->columns.oldest_date] = thread->oldest_date;
+        list_store->update_position (fwditer);
 
       } else {
         /* deleted */
@@ -329,51 +592,113 @@ namespace Astroid {
       LOG (debug) << "ql: updated: did not find thread, time used: " << ((clock() - t0) * 1000.0 / CLOCKS_PER_SEC) << " ms.";
       if (in_query) {
         LOG (debug) << "ql: new thread for query, adding..";
+        add_thread (db, thread_id);
+        changed = true;
+      }
+    }
+
+    if (changed && !in_destructor) {
+      refresh_stats_db (db); // we should already be running on the gui thread
+      stats_ready.emit ();
+    }
+  }
 
-        /* get current cursor path, if we are at first row and the new addition
-         * is before we should scroll up. */
-        Gtk::TreePath path;
-        Gtk::TreeViewColumn *c;
-        list_view->get_cursor (path, c);
+  void QueryLoader::on_threads_changed (Db * db, const std::set<ustring> & thread_ids, unsigned long from, unsigned long to) {
+    if (in_destructor) return;
 
-        auto iter = list_store->prepend ();
-        Gtk::ListStore::Row newrow = *iter;
+    LOG (info) << "ql (" << id << "): " << query << ", got changed signal for " << thread_ids.size () << " threads (lastmod: " << from << ".." << to << ")";
 
-        NotmuchThread * t;
+    if (loading ()) {
+      LOG (debug) << "ql: still loading, deferring threads_changed to until load is done.";
+      for (auto &t : thread_ids) changed_threads.push (t);
+      return;
+    }
 
-        db->on_thread (thread_id, [&t](notmuch_thread_t *nmt) {
+    time_t t0 = clock ();
 
-            t = new NotmuchThread (nmt);
+    /* check all the threads against the query in one go */
+    std::set<ustring> in_query = db->threads_in_query (query, thread_ids);
 
-          });
+    /* a single pass over the list finds the rows of the changed threads,
+     * they are updated afterwards since refreshing the dates may re-sort
+     * the rows. */
+    std::vector<Gtk::TreeIter> found;
+    std::set<ustring> found_ids;
 
-        newrow[list_store->columns.newest_date] = t->newest_date;
-        newrow[list_store->columns.oldest_date] = t->oldest_date;
-        newrow[list_store->columns.thread_id]   = t->thread_id;
-        newrow[list_store->columns.thread]      = Glib::RefPtr<NotmuchThread>(t);
+    for (Gtk::TreeIter fwditer = list_store->children ().begin (); fwditer; fwditer++) {
+      ustring tid = (*fwditer)[list_store->columns.thread_id];
 
-        /* check if we should select it (if this is the only item) */
-        if (list_store->children().size() == 1) {
-          if (!in_destructor)
-            first_thread_ready.emit ();
-        } else {
+      if (thread_ids.count (tid)) {
+        found.push_back (fwditer);
+        found_ids.insert (tid);
 
-          if (path == Gtk::TreePath ("0")) {
-            Gtk::TreePath addpath = list_store->get_path (iter);
-            if (addpath <= path) {
-              list_view->set_cursor (addpath);
-            }
-          }
-        }
+        if (found_ids.size () == thread_ids.size ()) break;
+      }
+    }
 
-        changed = true;
+    LOG (debug) << "ql: found " << found.size () << " threads in: " << ((clock() - t0) * 1000.0 / CLOCKS_PER_SEC) << " ms.";
+
+    int updated = 0, deleted = 0, added = 0;
+
+    for (auto &iter : found) {
+      Gtk::ListStore::Row row = *iter;
+      ustring tid = row[list_store->columns.thread_id];
+
+      if (in_query.count (tid)) {
+        refptr<NotmuchThread> thread = row[list_store->columns.thread];
+        thread->refresh (db);
+        list_store->update_position (iter);
+        updated++;
+      } else {
+        list_store->erase (iter);
+        deleted++;
       }
     }
 
-    if (changed && !in_destructor) {
-      refresh_stats_db (db); // we should already be running on the gui thread
+    for (auto &tid : in_query) {
+      if (!found_ids.count (tid)) {
+        add_thread (db, tid);
+        added++;
+      }
+    }
+
+    LOG (debug) << "ql: updated: " << updated << ", deleted: " << deleted << ", added: " << added << ", in: " << ((clock() - t0) * 1000.0 / CLOCKS_PER_SEC) << " ms.";
+
+    if ((updated + deleted + added) > 0 && !in_destructor) {
+      refresh_stats_db (db);
       stats_ready.emit ();
     }
   }
-}
 
+  void QueryLoader::add_thread (Db * db, ustring thread_id) {
+    /* get current cursor path, if we are at first row and the new addition
+     * is before we should scroll up. */
+    Gtk::TreePath path;
+    Gtk::TreeViewColumn *c;
+    list_view->get_cursor (path, c);
+
+    NotmuchThread * t;
+
+    db->on_thread (thread_id, [&t](notmuch_thread_t *nmt) {
+
+        t = new NotmuchThread (nmt, arena);
+
+      });
+
+    auto iter = list_store->insert_sorted (Glib::RefPtr<NotmuchThread>(t));
+
+    /* check if we should select it (if this is the only item) */
+    if (list_store->children().size() == 1) {
+      if (!in_destructor)
+        first_thread_ready.emit ();
+    } else {
+
+      if (path == Gtk::TreePath ("0")) {
+        Gtk::TreePath addpath = list_store->get_path (iter);
+        if (addpath <= path) {
+          list_view->set_cursor (addpath);
+        }
+      }
+    }
+  }
+}
@@ -3,10 +3,13 @@
 # include <thread>
 # include <mutex>
 # include <queue>
+# include <set>
+# include <memory>
 # include <notmuch.h>
 
 # include "proto.hh"
 # include "thread_index_list_view.hh"
+# include "loader_scheduler.hh"
 
 namespace Astroid {
   class QueryLoader : public sigc::trackable {
@@ -17,6 +20,7 @@ namespace Astroid {
       QueryLoader ();
       ~QueryLoader ();
 
+      /* change the query, the loaded threads are re-used where possible */
       void refine_query (ustring);
 
       void start (ustring);
@@ -38,17 +42,51 @@ namespace Astroid {
 
       bool loading ();
 
+      /* loaders of visible thread indexes are scheduled first */
+      void set_visible (bool);
+
     private:
       ustring query;
       void refresh_stats_db (Db *);
 
+      /* update the loaded threads to the current query, false if the query
+       * should rather be loaded again. */
+      bool refine ();
+
+      /* at most this many threads are added when refining */
+      const unsigned int max_refine_added = 200;
+
       std::atomic<bool> run;
       bool in_destructor = false;
       void loader ();
 
+      /* the loader went through all threads of the query */
+      std::atomic<bool> complete;
+
+      /* database revision the loaded threads are up to date with */
+      unsigned long revision = 0;
+
+      /* start from the threads loaded by another thread index for the same
+       * query and catch up with the changes since */
+      bool attach_snapshot ();
+      void store_snapshot ();
+
+      sigc::connection catch_up_c;
+      bool catch_up ();
+
+      /* load the query again rather than catching up with more changed
+       * threads than this */
+      const unsigned int max_catch_up = 1000;
+
       std::thread loader_thread;
       std::mutex  loader_m;
 
+      bool visible = false;
+      LoaderScheduler::ticket sched_ticket = 0;
+
+      /* strings shared by the threads of this query */
+      std::shared_ptr<StringArena> arena;
+
       std::queue<refptr<NotmuchThread>> to_list_store;
       std::mutex to_list_m;
 
@@ -63,6 +101,8 @@ namespace Astroid {
 
       /* signal handlers */
       void on_thread_changed (Db *, ustring);
+      void on_threads_changed (Db *, const std::set<ustring> &, unsigned long, unsigned long);
+      void add_thread (Db *, ustring);
       void on_refreshed ();
   };
 }
@@ -0,0 +1,358 @@
+# include <fstream>
+# include <cstring>
+# include <map>
+# include <set>
+# include <chrono>
+# include <sys/mman.h>
+# include <sys/stat.h>
+# include <fcntl.h>
+# include <unistd.h>
+
+# include "astroid.hh"
+# include "config.hh"
+# include "db.hh"
+# include "query_snapshots.hh"
+# include "utils/string_arena.hh"
+
+namespace Astroid {
+  std::mutex              QuerySnapshots::m;
+  unsigned int            QuerySnapshots::max_snapshots = 0;
+  std::list<QuerySnapshots::Snapshot> QuerySnapshots::snapshots;
+  bool                    QuerySnapshots::disk_cache = false;
+  bfs::path               QuerySnapshots::cache_file;
+
+  namespace {
+    const char magic[] = "astroid-threads";
+
+    /* reads from the mapped cache file, reading past the end marks the
+     * file as bad */
+    struct Reader {
+      const char * p;
+      const char * end;
+      bool ok = true;
+
+      template<class T> T get () {
+        T v = T ();
+        if (ok && static_cast<size_t> (end - p) >= sizeof (T)) {
+          memcpy (&v, p, sizeof (T));
+          p += sizeof (T);
+        } else {
+          ok = false;
+        }
+        return v;
+      }
+
+      std::string str () {
+        uint32_t l = get<uint32_t> ();
+        if (!ok || static_cast<size_t> (end - p) < l) {
+          ok = false;
+          return "";
+        }
+
+        std::string s (p, l);
+        p += l;
+        return s;
+      }
+    };
+
+    struct Writer {
+      std::ostream & o;
+
+      template<class T> void put (T v) {
+        o.write (reinterpret_cast<const char *> (&v), sizeof (T));
+      }
+
+      void str (const std::string & s) {
+        put<uint32_t> (s.size ());
+        o.write (s.data (), s.size ());
+      }
+    };
+
+    enum ThreadFlags : uint8_t {
+      UNREAD     = 1,
+      ATTACHMENT = 2,
+      FLAGGED    = 4,
+    };
+  }
+
+  void QuerySnapshots::init () {
+    ptree ti = astroid->config ("thread_index");
+
+    max_snapshots = ti.get<unsigned int> ("cache_queries");
+    disk_cache    = ti.get<bool> ("disk_cache") && max_snapshots > 0;
+    cache_file    = astroid->standard_paths ().cache_dir / bfs::path ("thread_index.cache");
+
+    if (disk_cache) load ();
+  }
+
+  void QuerySnapshots::store (ustring query, unsigned long revision, std::vector<refptr<NotmuchThread>> && threads) {
+    if (max_snapshots == 0) return;
+
+    std::lock_guard<std::mutex> lk (m);
+
+    snapshots.remove_if ([&] (const Snapshot & s) { return s.query == query; });
+
+    LOG (debug) << "qs: storing " << threads.size () << " threads of: " << query << " (revision: " << revision << ")";
+
+    snapshots.push_front ({ query, revision, std::move (threads) });
+
+    while (snapshots.size () > max_snapshots) snapshots.pop_back ();
+  }
+
+  bool QuerySnapshots::get (ustring query, Snapshot & snap) {
+    std::lock_guard<std::mutex> lk (m);
+
+    for (auto it = snapshots.begin (); it != snapshots.end (); it++) {
+      if (it->query == query) {
+        snapshots.splice (snapshots.begin (), snapshots, it);
+        snap = snapshots.front ();
+        return true;
+      }
+    }
+
+    return false;
+  }
+
+  void QuerySnapshots::remove (ustring query) {
+    std::lock_guard<std::mutex> lk (m);
+    snapshots.remove_if ([&] (const Snapshot & s) { return s.query == query; });
+  }
+
+  void QuerySnapshots::clear () {
+    std::lock_guard<std::mutex> lk (m);
+    snapshots.clear ();
+  }
+
+  bool QuerySnapshots::load () {
+    boost::system::error_code ec;
+    if (!bfs::is_regular_file (cache_file, ec)) return false;
+
+    auto t0 = std::chrono::steady_clock::now ();
+
+    int fd = open (cache_file.c_str (), O_RDONLY);
+    if (fd < 0) {
+      LOG (warn) << "qs: could not open: " << cache_file.c_str ();
+      return false;
+    }
+
+    struct stat st;
+    if (fstat (fd, &st) != 0 || st.st_size == 0) {
+      close (fd);
+      return false;
+    }
+
+    void * map = mmap (NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close (fd);
+
+    if (map == MAP_FAILED) {
+      LOG (warn) << "qs: could not map: " << cache_file.c_str ();
+      return false;
+    }
+
+    Reader r { static_cast<const char *> (map), static_cast<const char *> (map) + st.st_size };
+
+    std::string uuid;
+    unsigned long db_revision;
+    {
+      Db db (Db::DATABASE_READ_ONLY);
+      uuid        = db.get_uuid ();
+      db_revision = db.get_revision ();
+    }
+
+    std::list<Snapshot> loaded;
+
+    if (r.str () != magic || r.get<uint32_t> () != cache_version) {
+      LOG (warn) << "qs: unknown cache file format, ignoring.";
+      r.ok = false;
+    } else if (r.str () != uuid) {
+      LOG (info) << "qs: cache is for a different database, ignoring.";
+      r.ok = false;
+    }
+
+    std::vector<ustring> tag_names;
+
+    if (r.ok) {
+      uint32_t n_tags = r.get<uint32_t> ();
+      for (uint32_t i = 0; r.ok && i < n_tags; i++) tag_names.push_back (r.str ());
+
+      uint32_t n_snapshots = r.get<uint32_t> ();
+
+      for (uint32_t s = 0; r.ok && s < n_snapshots; s++) {
+        Snapshot snap;
+        snap.query    = r.str ();
+        snap.revision = r.get<uint64_t> ();
+
+        if (snap.revision > db_revision) {
+          /* the database has been re-created */
+          LOG (info) << "qs: cache is newer than database, ignoring.";
+          r.ok = false;
+          break;
+        }
+
+        auto arena = std::make_shared<StringArena> ();
+
+        uint32_t n_threads = r.get<uint32_t> ();
+        for (uint32_t i = 0; r.ok && i < n_threads; i++) {
+          refptr<NotmuchThread> t (new NotmuchThread (r.str (), arena));
+
+          t->newest_date    = r.get<int64_t> ();
+          t->oldest_date    = r.get<int64_t> ();
+          t->total_messages = r.get<int32_t> ();
+
+          uint8_t flags     = r.get<uint8_t> ();
+          t->unread         = flags & UNREAD;
+          t->attachment     = flags & ATTACHMENT;
+          t->flagged        = flags & FLAGGED;
+
+          t->subject        = r.str ();
+          t->message_id     = arena->store (r.str ());
+
+          uint32_t n_authors = r.get<uint32_t> ();
+          for (uint32_t a = 0; r.ok && a < n_authors; a++) {
+            std::string name = r.str ();
+            bool unread = r.get<uint8_t> ();
+            t->authors.push_back (NotmuchThread::make_author (*arena, name, unread));
+          }
+
+          uint32_t n_thread_tags = r.get<uint32_t> ();
+          for (uint32_t a = 0; r.ok && a < n_thread_tags; a++) {
+            uint32_t tag = r.get<uint32_t> ();
+            if (tag >= tag_names.size ()) {
+              r.ok = false;
+              break;
+            }
+            t->tags.push_back (tag_names[tag]);
+          }
+
+          t->index_tags ();
+          snap.threads.push_back (t);
+        }
+
+        loaded.push_back (std::move (snap));
+      }
+    }
+
+    munmap (map, st.st_size);
+
+    if (!r.ok) return false;
+
+    size_t n = 0;
+    for (auto &s : loaded) n += s.threads.size ();
+
+    LOG (info) << "qs: loaded " << loaded.size () << " queries (" << n << " threads) from cache in: " << std::chrono::duration<double, std::milli> (std::chrono::steady_clock::now () - t0).count () << " ms.";
+
+    std::lock_guard<std::mutex> lk (m);
+    snapshots.splice (snapshots.end (), loaded);
+
+    return true;
+  }
+
+  void QuerySnapshots::save () {
+    if (!disk_cache) return;
+
+    std::set<ustring> startup;
+    for (const auto &kv : astroid->config ("startup.queries")) {
+      startup.insert (kv.second.data ());
+    }
+
+    std::string uuid;
+    {
+      Db db (Db::DATABASE_READ_ONLY);
+      uuid = db.get_uuid ();
+    }
+
+    std::lock_guard<std::mutex> lk (m);
+
+    std::vector<const Snapshot *> queries;
+    std::map<ustring, uint32_t> tag_index;
+    std::vector<ustring> tag_names;
+
+    for (auto &s : snapshots) {
+      if (!startup.count (s.query)) continue;
+      queries.push_back (&s);
+
+      for (auto &t : s.threads) {
+        for (auto &tag : t->tags) {
+          if (tag_index.insert (std::make_pair (tag, tag_names.size ())).second) {
+            tag_names.push_back (tag);
+          }
+        }
+      }
+    }
+
+    /* this runs on exit, errors are logged rather than thrown */
+    boost::system::error_code ec;
+
+    if (queries.empty ()) {
+      bfs::remove (cache_file, ec);
+      if (ec) LOG (error) << "qs: could not remove cache: " << cache_file.c_str () << ": " << ec.message ();
+      return;
+    }
+
+    bfs::create_directories (cache_file.parent_path (), ec);
+    if (ec) {
+      LOG (error) << "qs: could not create cache directory: " << cache_file.parent_path ().c_str () << ": " << ec.message ();
+      return;
+    }
+
+    /* write to a temporary file and move it in place, so that a crash does
+     * not leave a partial cache */
+    bfs::path tmp = cache_file;
+    tmp += ".tmp";
+
+    std::ofstream f (tmp.c_str (), std::ios::binary | std::ios::trunc);
+    Writer w { f };
+
+    w.str (magic);
+    w.put<uint32_t> (cache_version);
+    w.str (uuid);
+
+    w.put<uint32_t> (tag_names.size ());
+    for (auto &t : tag_names) w.str (t);
+
+    w.put<uint32_t> (queries.size ());
+
+    for (auto s : queries) {
+      w.str (s->query);
+      w.put<uint64_t> (s->revision);
+      w.put<uint32_t> (s->threads.size ());
+
+      for (auto &t : s->threads) {
+        w.str (t->thread_id);
+        w.put<int64_t> (t->newest_date);
+        w.put<int64_t> (t->oldest_date);
+        w.put<int32_t> (t->total_messages);
+        w.put<uint8_t> ((t->unread ? UNREAD : 0) | (t->attachment ? ATTACHMENT : 0) | (t->flagged ? FLAGGED : 0));
+        w.str (t->subject);
+        w.str (t->message_id);
+
+        w.put<uint32_t> (t->authors.size ());
+        for (auto &a : t->authors) {
+          w.str (a.name);
+          w.put<uint8_t> (a.unread);
+        }
+
+        w.put<uint32_t> (t->tags.size ());
+        for (auto &tag : t->tags) w.put<uint32_t> (tag_index[tag]);
+      }
+    }
+
+    f.close ();
+
+    if (!f) {
+      LOG (error) << "qs: could not write cache: " << tmp.c_str ();
+      bfs::remove (tmp, ec);
+      return;
+    }
+
+    bfs::rename (tmp, cache_file, ec);
+    if (ec) {
+      LOG (error) << "qs: could not move cache in place: " << cache_file.c_str () << ": " << ec.message ();
+      bfs::remove (tmp, ec);
+      return;
+    }
+
+    LOG (info) << "qs: saved " << queries.size () << " queries to: " << cache_file.c_str ();
+  }
+}
+
@@ -0,0 +1,57 @@
+# pragma once
+
+# include <mutex>
+# include <list>
+# include <vector>
+# include <boost/filesystem.hpp>
+
+# include "proto.hh"
+# include "astroid.hh"
+
+namespace bfs = boost::filesystem;
+
+namespace Astroid {
+  /* the loaded results of recent queries, shared by all thread indexes in
+   * all windows.
+   *
+   * a snapshot holds the threads of a query as they were when it was
+   * loaded, stamped with the revision of the database at that point. a new
+   * thread index for the same query starts out with the snapshot and only
+   * needs to catch up with the messages changed since (lastmod:).
+   *
+   * optionally the snapshots of the startup queries are written to disk on
+   * exit and read back on start up, so that the startup queries can be
+   * shown before they have been loaded from the database. */
+  class QuerySnapshots {
+    public:
+      struct Snapshot {
+        ustring query;
+        unsigned long revision;
+        std::vector<refptr<NotmuchThread>> threads;
+      };
+
+      static void init ();
+
+      static void store (ustring query, unsigned long revision, std::vector<refptr<NotmuchThread>> &&);
+      static bool get (ustring query, Snapshot &);
+      static void remove (ustring query);
+      static void clear ();
+
+      /* write the snapshots of the startup queries to disk */
+      static void save ();
+
+    private:
+      static std::mutex m;
+      static unsigned int max_snapshots;
+
+      /* most recently used first */
+      static std::list<Snapshot> snapshots;
+
+      static bool      disk_cache;
+      static bfs::path cache_file;
+      static const uint32_t cache_version = 1;
+
+      static bool load ();
+  };
+}
+
@@ -50,6 +50,12 @@ namespace Astroid {
     queryloader.first_thread_ready.connect (
         sigc::mem_fun (this, &ThreadIndex::on_first_thread_ready));
 
+    /* the list is only mapped while its page is shown */
+    list_view->signal_map ().connect (
+        sigc::bind (sigc::mem_fun (queryloader, &QueryLoader::set_visible), true));
+    list_view->signal_unmap ().connect (
+        sigc::bind (sigc::mem_fun (queryloader, &QueryLoader::set_visible), false));
+
     queryloader.start (query_string);
 
 # ifndef DISABLE_PLUGINS
@@ -127,8 +133,11 @@ namespace Astroid {
 
           LOG (info) << "ti: sorting by: " << queryloader.sort_strings[static_cast<int>(queryloader.sort)];
 
+          /* the loaded threads are re-ordered in memory, only a partially
+           * loaded list needs to be loaded again in the new order. */
           list_view->set_sort_type (queryloader.sort);
-          queryloader.reload ();
+          if (queryloader.loading ()) queryloader.reload ();
+
           return true;
         });
 
@@ -16,6 +16,7 @@
 
 # include "thread_index.hh"
 # include "thread_index_list_cell_renderer.hh"
+# include "thread_index_list_view.hh"
 # include "db.hh"
 # include "utils/utils.hh"
 # include "crypto.hh"
@@ -34,6 +35,7 @@ namespace Astroid {
     std::sort (hidden_tags.begin (), hidden_tags.end ());
 
     thread_index = _ti;
+    now = time (NULL);
 
     /* load font settings */
     font_desc_string = ti.get<string> ("font_description");
@@ -107,6 +109,8 @@ namespace Astroid {
       font_description.set_weight (Pango::WEIGHT_NORMAL);
     }
 
+    rc = get_row_cache (cell_area, flags);
+
     render_background (cr, widget, background_area, flags);
     render_date (cr, widget, cell_area, flags); // returns height
 
@@ -142,6 +146,53 @@ namespace Astroid {
     LOG (debug) << "til cr: deconstruct.";
   }
 
+  void ThreadIndexListCellRenderer::invalidate_cache () {
+    LOG (debug) << "til cr: invalidating layout cache.";
+    row_cache[0].clear ();
+    row_cache[1].clear ();
+    rc = NULL;
+  }
+
+  bool ThreadIndexListCellRenderer::date_expired (refptr<NotmuchThread> t) {
+    for (auto &cache : row_cache) {
+      auto r = cache.find (t->thread_id);
+
+      if (r != cache.end () && r->second.thread == t && r->second.date &&
+          r->second.date_valid_until <= now) {
+        return true;
+      }
+    }
+
+    return false;
+  }
+
+  ThreadIndexListCellRenderer::RowCache * ThreadIndexListCellRenderer::get_row_cache (
+      const Gdk::Rectangle &cell_area,
+      Gtk::CellRendererState flags)
+  {
+    if (cell_area.get_width () != cache_width) {
+      invalidate_cache ();
+      cache_width = cell_area.get_width ();
+    }
+
+    auto &cache = row_cache[(flags & Gtk::CELL_RENDERER_SELECTED) != 0 ? 1 : 0];
+
+    if (cache.size () > max_cached_rows) {
+      LOG (debug) << "til cr: layout cache full, clearing.";
+      cache.clear ();
+    }
+
+    RowCache &r = cache[thread->thread_id];
+
+    if (r.thread != thread || r.version != thread->version) {
+      r = RowCache ();
+      r.thread  = thread;
+      r.version = thread->version;
+    }
+
+    return &r;
+  }
+
   void ThreadIndexListCellRenderer::render_background ( // {{{
       const ::Cairo::RefPtr< ::Cairo::Context>&cr,
       Gtk::Widget & /* widget */,
@@ -287,25 +338,29 @@ namespace Astroid {
       const Gdk::Rectangle &cell_area,
       Gtk::CellRendererState flags) {
 
-    Glib::RefPtr<Pango::Layout> pango_layout = widget.create_pango_layout ("");
-
-    pango_layout->set_font_description (font_description);
-
     /* set color */
     Glib::RefPtr<Gtk::StyleContext> stylecontext = widget.get_style_context();
 
     Gdk::RGBA color = stylecontext->get_color(Gtk::STATE_FLAG_NORMAL);
     cr->set_source_rgb (color.get_red(), color.get_green(), color.get_blue());
-    ustring color_str;
-    if ((flags & Gtk::CELL_RENDERER_SELECTED) != 0) {
-      color_str = subject_color_selected;
-    } else {
-      color_str = subject_color;
+
+    if (!rc->subject) {
+      rc->subject = widget.create_pango_layout ("");
+      rc->subject->set_font_description (font_description);
+
+      ustring color_str;
+      if ((flags & Gtk::CELL_RENDERER_SELECTED) != 0) {
+        color_str = subject_color_selected;
+      } else {
+        color_str = subject_color;
+      }
+
+      rc->subject->set_markup (ustring::compose ("<span color=\"%1\">%2</span>",
+          color_str,
+          Glib::Markup::escape_text(thread->subject)));
     }
 
-    pango_layout->set_markup (ustring::compose ("<span color=\"%1\">%2</span>",
-        color_str,
-        Glib::Markup::escape_text(thread->subject)));
+    Glib::RefPtr<Pango::Layout> pango_layout = rc->subject;
 
     /* align in the middle */
     int w, h;
@@ -317,56 +372,89 @@ namespace Astroid {
 
   } // }}}
 
+  std::vector<ustring> ThreadIndexListCellRenderer::shown_tags (refptr<NotmuchThread> t) {
+    /* subtract hidden tags */
+    vector<ustring> tags;
+    set_difference (t->tags.begin(),
+                    t->tags.end(),
+                    hidden_tags.begin (),
+                    hidden_tags.end (),
+                    back_inserter(tags));
+
+    return tags;
+  }
+
   int ThreadIndexListCellRenderer::render_tags ( // {{{
       const ::Cairo::RefPtr< ::Cairo::Context>&cr,
       Gtk::Widget &widget,
       const Gdk::Rectangle &cell_area,
       Gtk::CellRendererState flags) {
 
-    Glib::RefPtr<Pango::Layout> pango_layout = widget.create_pango_layout ("");
-
-    pango_layout->set_font_description (font_description);
-
     /* set color */
     Glib::RefPtr<Gtk::StyleContext> stylecontext = widget.get_style_context();
 
     Gdk::RGBA color = stylecontext->get_color(Gtk::STATE_FLAG_NORMAL);
     cr->set_source_rgb (color.get_red(), color.get_green(), color.get_blue());
 
-    /* subtract hidden tags */
-    vector<ustring> tags;
-    set_difference (thread->tags.begin(),
-                    thread->tags.end(),
-                    hidden_tags.begin (),
-                    hidden_tags.end (),
-                    back_inserter(tags));
+    if (!rc->tags) {
+      Glib::RefPtr<Pango::Layout> pango_layout = widget.create_pango_layout ("");
 
-    ustring tag_string;
+      pango_layout->set_font_description (font_description);
 
-    Gdk::Color bg;
+      vector<ustring> tags = shown_tags (thread);
 
-    if ((flags & Gtk::CELL_RENDERER_SELECTED) != 0) {
-      bg = Gdk::Color (background_color_selected);
-      cr->set_source_rgb (bg.get_red_p(), bg.get_green_p(), bg.get_blue_p());
-    } else {
-      bg.set_grey_p (1.);
-    }
+      ustring tag_string;
 
-    /* first try plugin */
+      Gdk::Color bg;
+
+      if ((flags & Gtk::CELL_RENDERER_SELECTED) != 0) {
+        bg = Gdk::Color (background_color_selected);
+      } else {
+        bg.set_grey_p (1.);
+      }
+
+      /* first try plugin */
 # ifndef DISABLE_PLUGINS
-    if (!thread_index->plugins->format_tags (tags, bg.to_string (), (flags & Gtk::CELL_RENDERER_SELECTED) != 0, tag_string)) {
+      bool selected = (flags & Gtk::CELL_RENDERER_SELECTED) != 0;
+
+      if (thread_index->plugins->batches_tags () &&
+          !thread_index->plugins->formatted (tags, bg.to_string (), selected)) {
+        /* format the tags of all rows on screen in one call */
+        vector<vector<ustring>> tag_sets;
+        for (auto &t : thread_index->list_view->get_visible_threads ()) {
+          tag_sets.push_back (shown_tags (t));
+        }
+
+        thread_index->plugins->format_tags (tag_sets, bg.to_string (), selected);
+      }
+
+      if (!thread_index->plugins->format_tags (tags, bg.to_string (), selected, tag_string)) {
 # endif
 
-      unsigned char cv[3] = { (unsigned char) bg.get_red (),
-                              (unsigned char) bg.get_green (),
-                              (unsigned char) bg.get_blue () };
+        unsigned char cv[3] = { (unsigned char) bg.get_red (),
+                                (unsigned char) bg.get_green (),
+                                (unsigned char) bg.get_blue () };
 
-      tag_string = VectorUtils::concat_tags_color (tags, true, tags_len, cv);
+        tag_string = VectorUtils::concat_tags_color (tags, true, tags_len, cv);
 # ifndef DISABLE_PLUGINS
-    }
+      }
 # endif
 
-    pango_layout->set_markup (tag_string);
+      pango_layout->set_markup (tag_string);
+
+      int w, h;
+      pango_layout->get_size (w, h);
+
+      rc->tags       = pango_layout;
+      rc->tags_width = w;
+    }
+
+    if ((flags & Gtk::CELL_RENDERER_SELECTED) != 0) {
+      Gdk::Color bg (background_color_selected);
+      cr->set_source_rgb (bg.get_red_p(), bg.get_green_p(), bg.get_blue_p());
+    }
+
+    Glib::RefPtr<Pango::Layout> pango_layout = rc->tags;
 
     /* align in the middle */
     int w, h;
@@ -376,7 +464,7 @@ namespace Astroid {
     cr->move_to (cell_area.get_x() + tags_start, cell_area.get_y() + y);
     pango_layout->show_in_cairo_context (cr);
 
-    return w;
+    return rc->tags_width;
 
   } // }}}
 
@@ -386,11 +474,14 @@ namespace Astroid {
       const Gdk::Rectangle &cell_area,
       Gtk::CellRendererState flags) {
 
-    ustring date = Date::pretty_print (thread->newest_date);
+    if (!rc->date || rc->date_valid_until <= now) {
+      ustring date = Date::pretty_print (thread->newest_date, now, rc->date_valid_until);
 
-    Glib::RefPtr<Pango::Layout> pango_layout = widget.create_pango_layout (date);
+      rc->date = widget.create_pango_layout (date);
+      rc->date->set_font_description (font_description);
+    }
 
-    pango_layout->set_font_description (font_description);
+    Glib::RefPtr<Pango::Layout> pango_layout = rc->date;
 
     /* set color */
     Glib::RefPtr<Gtk::StyleContext> stylecontext = widget.get_style_context();
@@ -423,14 +514,16 @@ namespace Astroid {
       const Gdk::Rectangle &cell_area,
       Gtk::CellRendererState flags) {
 
+    if (!rc->message_count) {
 # define BUFLEN 24
-    char buf[BUFLEN];
-    snprintf (buf, BUFLEN, "(%d)", thread->total_messages);
-
+      char buf[BUFLEN];
+      snprintf (buf, BUFLEN, "(%d)", thread->total_messages);
 
-    Glib::RefPtr<Pango::Layout> pango_layout = widget.create_pango_layout (buf);
+      rc->message_count = widget.create_pango_layout (buf);
+      rc->message_count->set_font_description (font_description);
+    }
 
-    pango_layout->set_font_description (font_description);
+    Glib::RefPtr<Pango::Layout> pango_layout = rc->message_count;
 
     /* set color */
     Glib::RefPtr<Gtk::StyleContext> stylecontext = widget.get_style_context();
@@ -461,88 +554,94 @@ namespace Astroid {
       const Gdk::Rectangle &cell_area,
       Gtk::CellRendererState flags) {
 
-    /* format authors string */
-    ustring authors;
-
-    if (thread->authors.size () == 1) {
-      /* if only one, show full name */
-      ustring an = get<0>(thread->authors[0]);
+    if (!rc->authors) {
+      /* format authors string */
+      ustring authors;
 
-      if (static_cast<int>(an.size()) >= authors_len) {
-        an = an.substr (0, authors_len);
-        UstringUtils::trim_right(an);
-        an += ".";
-      }
-
-      if (get<1>(thread->authors[0])) {
-        authors = ustring::compose ("<b>%1</b>",
-          Glib::Markup::escape_text (an));
-      } else {
-        authors = Glib::Markup::escape_text (an);
-      }
-
-    } else {
-      /* show first names separated by comma */
-      bool first = true;
-
-      int len = 0;
-      for (auto &a : thread->authors) {
-        if (!first) len += 1; // comma
+      if (thread->authors.size () == 1) {
+        /* if only one, show full name */
+        ustring an = thread->authors[0].name;
 
-        ustring an = get<0>(a);
-
-        size_t pos = an.find_first_of (",. @");
-        if (an[pos] == ',' || an[pos] == '.') { // last name, first name format or initial/title.
-            an = an.substr (pos + 1, an.size ());
-            UstringUtils::trim_left (an);
-            pos = an.find_first_of (" @");
-            an = an.substr (0, pos);
-        } else {
-            an = an.substr (0, pos);
-        }
-
-        int tlen = static_cast<int>(an.size());
-        if ((len + tlen) >= authors_len) {
-          an = an.substr (0, authors_len - len);
-          UstringUtils::trim_right (an);
+        if (static_cast<int>(an.size()) >= authors_len) {
+          an = an.substr (0, authors_len);
+          UstringUtils::trim_right(an);
           an += ".";
-          tlen = authors_len - len;
         }
 
-        len += tlen;
-
-        if (!first) {
-          authors += ",";
+        if (thread->authors[0].unread) {
+          authors = ustring::compose ("<b>%1</b>",
+            Glib::Markup::escape_text (an));
         } else {
-          first = false;
+          authors = Glib::Markup::escape_text (an);
         }
 
-        if (get<1>(a)) {
-          authors += ustring::compose ("<b>%1</b>", Glib::Markup::escape_text (an));
-        } else {
-          authors += Glib::Markup::escape_text (an);
+      } else {
+        /* show first names separated by comma */
+        bool first = true;
+
+        int len = 0;
+        for (auto &a : thread->authors) {
+          if (!first) len += 1; // comma
+
+          ustring an = a.name;
+
+          size_t pos = an.find_first_of (",. @");
+          if (an[pos] == ',' || an[pos] == '.') { // last name, first name format or initial/title.
+              an = an.substr (pos + 1, an.size ());
+              UstringUtils::trim_left (an);
+              pos = an.find_first_of (" @");
+              an = an.substr (0, pos);
+          } else {
+              an = an.substr (0, pos);
+          }
+
+          int tlen = static_cast<int>(an.size());
+          if ((len + tlen) >= authors_len) {
+            an = an.substr (0, authors_len - len);
+            UstringUtils::trim_right (an);
+            an += ".";
+            tlen = authors_len - len;
+          }
+
+          len += tlen;
+
+          if (!first) {
+            authors += ",";
+          } else {
+            first = false;
+          }
+
+          if (a.unread) {
+            authors += ustring::compose ("<b>%1</b>", Glib::Markup::escape_text (an));
+          } else {
+            authors += Glib::Markup::escape_text (an);
+          }
+
+
+          if (len >= authors_len) {
+            break;
+          }
         }
+      }
 
 
-        if (len >= authors_len) {
-          break;
-        }
+      Glib::RefPtr<Pango::Layout> pango_layout = widget.create_pango_layout ("");
+      pango_layout->set_markup (authors);
+
+      if (thread->unread) {
+        font_description.set_weight (Pango::WEIGHT_NORMAL);
       }
-    }
 
+      pango_layout->set_font_description (font_description);
 
-    Glib::RefPtr<Pango::Layout> pango_layout = widget.create_pango_layout ("");
-    pango_layout->set_markup (authors);
+      if (thread->unread) {
+        font_description.set_weight (Pango::WEIGHT_BOLD);
+      }
 
-    if (thread->unread) {
-      font_description.set_weight (Pango::WEIGHT_NORMAL);
+      rc->authors = pango_layout;
     }
 
-    pango_layout->set_font_description (font_description);
-
-    if (thread->unread) {
-      font_description.set_weight (Pango::WEIGHT_BOLD);
-    }
+    Glib::RefPtr<Pango::Layout> pango_layout = rc->authors;
 
     /* set color */
     Glib::RefPtr<Gtk::StyleContext> stylecontext = widget.get_style_context();
@@ -1,6 +1,7 @@
 # pragma once
 
 # include <vector>
+# include <unordered_map>
 
 # include <gtkmm.h>
 # include <gtkmm/cellrenderer.h>
@@ -26,6 +27,12 @@ namespace Astroid {
 
       int get_height ();
 
+      /* the tags of the thread without the hidden tags */
+      std::vector<ustring> shown_tags (refptr<NotmuchThread>);
+
+      /* drop all prepared layouts, e.g. when the style or font changed */
+      void invalidate_cache ();
+
     protected:
       /* best documentation so far from here:
        * https://git.gnome.org/browse/gtkmm/tree/gtk/src/cellrenderer.hg
@@ -68,7 +75,39 @@ namespace Astroid {
       int height;
       bool height_set = false;
 
+      /* dates are printed relative to this, updated by the view */
+      time_t now;
+
+      /* the cached date string of this thread is out of date */
+      bool date_expired (refptr<NotmuchThread>);
+
     private:
+      /* the layouts of a row are prepared once and kept until the thread
+       * has been refreshed (its version changes), or the font or width
+       * of the view changes. the date is re-formatted when the printed
+       * string changes (see Date::pretty_print). */
+      struct RowCache {
+        refptr<NotmuchThread> thread;
+        unsigned int version;
+
+        time_t  date_valid_until = 0;
+        refptr<Pango::Layout> date;
+        refptr<Pango::Layout> message_count;
+        refptr<Pango::Layout> authors;
+        refptr<Pango::Layout> tags;
+        refptr<Pango::Layout> subject;
+        int tags_width = 0;
+      };
+
+      /* one cache for unselected and one for selected rows, since the
+       * colors are part of the markup */
+      std::unordered_map<std::string, RowCache> row_cache[2];
+      const size_t max_cached_rows = 4096;
+      int cache_width = -1;
+
+      RowCache * rc = NULL; /* row that is being rendered */
+      RowCache * get_row_cache (const Gdk::Rectangle &, Gtk::CellRendererState);
+
       int line_height; // content_height + line_spacing
       int content_height;
       int line_spacing = 2; // configurable
@@ -2,6 +2,8 @@
 # include <algorithm>
 # include <vector>
 # include <functional>
+# include <chrono>
+# include <cstring>
 
 # include "db.hh"
 # include "modes/paned_mode.hh"
@@ -18,6 +20,7 @@
 # include "utils/utils.hh"
 # include "utils/cmd.hh"
 # include "utils/resource.hh"
+# include "utils/vector_utils.hh"
 
 # include "command_bar.hh"
 
@@ -82,6 +85,153 @@ namespace Astroid {
     LOG (debug) << "tils: deconstuct.";
   }
 
+  bool ThreadIndexListStore::before (notmuch_sort_t s, const NotmuchThread * a, const NotmuchThread * b) {
+    switch (s) {
+      case NOTMUCH_SORT_NEWEST_FIRST:
+        if (a->newest_date != b->newest_date) return a->newest_date > b->newest_date;
+        break;
+
+      case NOTMUCH_SORT_OLDEST_FIRST:
+        if (a->oldest_date != b->oldest_date) return a->oldest_date < b->oldest_date;
+        break;
+
+      case NOTMUCH_SORT_MESSAGE_ID:
+        {
+          int c = strcmp (a->message_id, b->message_id);
+          if (c != 0) return c < 0;
+        }
+        break;
+
+      case NOTMUCH_SORT_UNSORTED:
+      default:
+        /* thread ids are handed out in increasing order as threads are
+         * created, which is close to the document order of notmuch */
+        break;
+    }
+
+    return a->thread_id.raw () < b->thread_id.raw ();
+  }
+
+  NotmuchThread * ThreadIndexListStore::thread_at (int i) {
+    Gtk::ListStore::Row row = children ()[i];
+    refptr<NotmuchThread> t = row[columns.thread];
+    return t.operator-> ();
+  }
+
+  void ThreadIndexListStore::sort_rows (notmuch_sort_t s) {
+    sort = s;
+
+    int n = children ().size ();
+    if (n < 2) return;
+
+    auto t0 = std::chrono::steady_clock::now ();
+
+    /* the rows hold a reference to the threads */
+    std::vector<std::pair<const NotmuchThread *, int>> rows;
+    rows.reserve (n);
+
+    int i = 0;
+    for (auto iter = children ().begin (); iter; iter++, i++) {
+      refptr<NotmuchThread> t = (*iter)[columns.thread];
+      rows.push_back (std::make_pair (t.operator-> (), i));
+    }
+
+    VectorUtils::parallel_sort (rows,
+        [s] (const std::pair<const NotmuchThread *, int> & a,
+             const std::pair<const NotmuchThread *, int> & b) {
+          return before (s, a.first, b.first);
+        });
+
+    std::vector<int> new_order (n);
+    bool changed = false;
+    for (i = 0; i < n; i++) {
+      new_order[i] = rows[i].second;
+      if (new_order[i] != i) changed = true;
+    }
+
+    if (changed) reorder (new_order);
+
+    LOG (debug) << "tils: sorted " << n << " rows in: " << std::chrono::duration<double, std::milli> (std::chrono::steady_clock::now () - t0).count () << " ms.";
+  }
+
+  Gtk::TreeIter ThreadIndexListStore::insert_sorted (refptr<NotmuchThread> t) {
+    /* first row that should go after the thread */
+    int lo = 0, hi = children ().size ();
+    while (lo < hi) {
+      int mid = (lo + hi) / 2;
+      if (before (sort, t.operator-> (), thread_at (mid))) {
+        hi = mid;
+      } else {
+        lo = mid + 1;
+      }
+    }
+
+    Gtk::TreeIter iter;
+    if (lo == static_cast<int> (children ().size ())) {
+      iter = append ();
+    } else {
+      iter = insert (children ()[lo]);
+    }
+
+    set_thread (iter, t);
+
+    return iter;
+  }
+
+  Gtk::TreeIter ThreadIndexListStore::append_thread (refptr<NotmuchThread> t) {
+    Gtk::TreeIter iter = append ();
+    set_thread (iter, t);
+
+    return iter;
+  }
+
+  void ThreadIndexListStore::set_thread (Gtk::TreeIter iter, refptr<NotmuchThread> t) {
+    Gtk::ListStore::Row row = *iter;
+    row[columns.newest_date] = t->newest_date;
+    row[columns.oldest_date] = t->oldest_date;
+    row[columns.thread_id]   = t->thread_id;
+    row[columns.thread]      = t;
+  }
+
+  void ThreadIndexListStore::update_position (Gtk::TreeIter iter) {
+    Gtk::ListStore::Row row = *iter;
+    refptr<NotmuchThread> t = row[columns.thread];
+
+    row[columns.newest_date] = t->newest_date;
+    row[columns.oldest_date] = t->oldest_date;
+
+    int n   = children ().size ();
+    int pos = get_path (iter)[0];
+
+    /* still in order with its neighbours */
+    if ((pos == 0 || !before (sort, t.operator-> (), thread_at (pos - 1))) &&
+        (pos == n - 1 || !before (sort, thread_at (pos + 1), t.operator-> ()))) {
+      return;
+    }
+
+    /* first row (other than this) that should go after the thread, the row
+     * itself counts as its successor so that the search stays monotonic. */
+    int lo = 0, hi = n;
+    while (lo < hi) {
+      int mid = (lo + hi) / 2;
+      int cmp = (mid == pos) ? mid + 1 : mid;
+
+      if (cmp >= n || before (sort, t.operator-> (), thread_at (cmp))) {
+        hi = mid;
+      } else {
+        lo = mid + 1;
+      }
+    }
+
+    if (lo == pos || lo == pos + 1) return;
+
+    if (lo == n) {
+      move (iter, children ().end ());
+    } else {
+      move (iter, children ()[lo]);
+    }
+  }
+
 
   /* ---------
    * list view
@@ -120,7 +270,11 @@ namespace Astroid {
     column->set_cell_data_func (*renderer,
         sigc::mem_fun(this, &ThreadIndexListView::set_thread_data) );
 
-    /* re-draw every minute (check every second) */
+    /* prepared layouts must be re-shaped if the font or theme changes */
+    signal_style_updated ().connect (
+        sigc::mem_fun (renderer, &ThreadIndexListCellRenderer::invalidate_cache));
+
+    /* re-draw rows with out-dated dates (check every second) */
     Glib::signal_timeout ().connect (
         sigc::mem_fun (this, &ThreadIndexListView::redraw), 1000);
 
@@ -249,40 +403,132 @@ namespace Astroid {
       Gtk::ListStore::Row row = *iter;
       refptr<NotmuchThread> t = row[list_store->columns.thread];
 
-      if (t) return t->matches (filter);
-      else   return false;
+      if (!t) return false;
+
+      auto e = filter_entries.find (t->thread_id);
+      if (e != filter_entries.end () &&
+          filter_threads[e->second] == t &&
+          filter_versions[e->second] == t->version) {
+
+        return filter_engine.visible (e->second);
+      }
+
+      return t->matches (filter);
     }
 
     return true;
   }
 
+  void ThreadIndexListView::build_filter_corpus () {
+    auto t0 = std::chrono::steady_clock::now ();
+
+    filter_engine.clear ();
+    filter_threads.clear ();
+    filter_versions.clear ();
+    filter_entries.clear ();
+
+    for (auto &row : list_store->children ()) {
+      refptr<NotmuchThread> t = row[list_store->columns.thread];
+      if (!t) continue;
+
+      size_t e = filter_engine.add (t->filter_str ());
+      filter_threads.push_back (t);
+      filter_versions.push_back (t->version);
+      filter_entries[t->thread_id] = e;
+    }
+
+    LOG (debug) << "tilv: filter: built corpus of " << filter_engine.size () << " threads (" << filter_engine.bytes () << " bytes) in: " << std::chrono::duration<double, std::milli> (std::chrono::steady_clock::now () - t0).count () << " ms.";
+  }
+
   void ThreadIndexListView::on_filter (ustring k) {
     LOG (info) << "ti: filtering: " << k;
 
     if (filter_txt == k) return;
 
+    bool fresh  = filter.empty ();
     filter_txt  = k;
     filter      = VectorUtils::split_and_trim (k.lowercase (), " ");
 
+    if (!filter.empty ()) {
+      auto t0 = std::chrono::steady_clock::now ();
+
+      /* rebuild the corpus when starting a new filter or when threads have
+       * been loaded since, otherwise the previous result may be narrowed. */
+      if (fresh || filter_threads.size () != list_store->children ().size ()) {
+        build_filter_corpus ();
+      }
+
+      std::vector<std::string> keys (filter.begin (), filter.end ());
+      size_t n = filter_engine.filter (keys);
+
+      LOG (debug) << "tilv: filter: " << n << " of " << filter_engine.size () << " threads match, in: " << std::chrono::duration<double, std::milli> (std::chrono::steady_clock::now () - t0).count () << " ms.";
+    }
+
     filtered_store->refilter ();
 
     thread_index->on_stats_ready ();
   }
 
   bool ThreadIndexListView::redraw () {
-    chrono::duration<double> elapsed = chrono::steady_clock::now() - last_redraw;
+    /* the dates are printed relative to the same now for all rows until the
+     * next tick, only the visible rows whose printed date has changed since
+     * they were drawn are re-drawn. */
+    renderer->now = time (NULL);
+
+    if (!get_realized ()) return true;
+
+    Gtk::TreePath start, end;
+    if (!get_visible_range (start, end)) return true;
+
+    Gtk::TreeViewColumn * column = get_column (0);
+    int n = 0;
+
+    for (Gtk::TreePath path = start; path <= end; path.next ()) {
+      Gtk::TreeIter iter = filtered_store->get_iter (path);
+      if (!iter) break;
+
+      Gtk::ListStore::Row row = *iter;
+      refptr<NotmuchThread> thread = row[list_store->columns.thread];
+
+      if (thread && renderer->date_expired (thread)) {
+        Gdk::Rectangle rect;
+        get_background_area (path, *column, rect);
 
-    if (elapsed.count () >= 60) {
+        int x, y;
+        convert_bin_window_to_widget_coords (rect.get_x (), rect.get_y (), x, y);
 
-      queue_draw ();
-      last_redraw = chrono::steady_clock::now();
+        queue_draw_area (x, y, get_allocated_width (), rect.get_height ());
+        n++;
+      }
+    }
 
+    if (n > 0) {
+      LOG (debug) << "tilv: redraw: " << n << " rows with changed dates.";
     }
 
     return true;
   }
 
 
+  std::vector<refptr<NotmuchThread>> ThreadIndexListView::get_visible_threads () {
+    std::vector<refptr<NotmuchThread>> threads;
+
+    Gtk::TreePath start, end;
+    if (!get_realized () || !get_visible_range (start, end)) return threads;
+
+    for (Gtk::TreePath path = start; path <= end; path.next ()) {
+      Gtk::TreeIter iter = filtered_store->get_iter (path);
+      if (!iter) break;
+
+      Gtk::ListStore::Row row = *iter;
+      refptr<NotmuchThread> thread = row[list_store->columns.thread];
+
+      if (thread) threads.push_back (thread);
+    }
+
+    return threads;
+  }
+
   void ThreadIndexListView::set_thread_data (
       Gtk::CellRenderer * renderer,
       const Gtk::TreeIter &iter) {
@@ -301,15 +547,7 @@ namespace Astroid {
   }
 
   void ThreadIndexListView::set_sort_type (notmuch_sort_t sort) {
-    if (sort == NOTMUCH_SORT_NEWEST_FIRST) {
-      list_store->set_sort_column (0, Gtk::SortType::SORT_DESCENDING);
-    } else if (sort == NOTMUCH_SORT_OLDEST_FIRST) {
-      list_store->set_sort_column (1, Gtk::SortType::SORT_ASCENDING);
-    } else {
-      // TODO: NOTMUCH_SORT_MESSAGE_ID
-
-      list_store->set_sort_column (Gtk::TreeSortable::DEFAULT_UNSORTED_COLUMN_ID, Gtk::SortType::SORT_ASCENDING);
-    }
+    list_store->sort_rows (sort);
   }
 
   void ThreadIndexListView::register_keys () { // {{{
@@ -1,6 +1,7 @@
 # pragma once
 
 # include <chrono>
+# include <unordered_map>
 
 # include <gtkmm.h>
 # include <gtkmm/liststore.h>
@@ -10,6 +11,7 @@
 # include "config.hh"
 # include "modes/mode.hh"
 # include "modes/keybindings.hh"
+# include "utils/text_filter.hh"
 
 # include "notmuch.h"
 
@@ -41,6 +43,29 @@ namespace Astroid {
       ThreadIndexListStore ();
       ~ThreadIndexListStore ();
       const ThreadIndexListStoreColumnRecord columns;
+
+      /* the store is not sorted by gtk, the rows are kept in this order by
+       * the query loader so that all rows can be re-ordered in one go when
+       * the order changes. */
+      notmuch_sort_t sort = NOTMUCH_SORT_NEWEST_FIRST;
+
+      /* re-order all rows in memory */
+      void sort_rows (notmuch_sort_t);
+
+      /* add a row for the thread at its position */
+      Gtk::TreeIter insert_sorted (refptr<NotmuchThread>);
+
+      /* add a row for the thread at the end */
+      Gtk::TreeIter append_thread (refptr<NotmuchThread>);
+
+      /* move the row of a refreshed thread to its new position */
+      void update_position (Gtk::TreeIter);
+
+      static bool before (notmuch_sort_t, const NotmuchThread *, const NotmuchThread *);
+
+    private:
+      NotmuchThread * thread_at (int);
+      void set_thread (Gtk::TreeIter, refptr<NotmuchThread>);
   };
 
 
@@ -65,6 +90,9 @@ namespace Astroid {
 
       void set_thread_data (Gtk::CellRenderer *, const Gtk::TreeIter & );
 
+      /* the threads of the rows currently on screen */
+      std::vector<refptr<NotmuchThread>> get_visible_threads ();
+
       ustring get_current_thread_id ();
       refptr<NotmuchThread> get_current_thread ();
 
@@ -76,6 +104,15 @@ namespace Astroid {
       std::vector<ustring> filter;
       void on_filter (ustring k);
 
+      /* packed search corpus of the loaded threads. threads that are
+       * not in the corpus, or have changed since it was built, are
+       * matched directly. */
+      TextFilter filter_engine;
+      std::vector<refptr<NotmuchThread>> filter_threads;
+      std::vector<unsigned int>          filter_versions;
+      std::unordered_map<std::string, size_t> filter_entries;
+      void build_filter_corpus ();
+
 
     protected:
       Keybindings multi_keys;
@@ -113,7 +150,6 @@ namespace Astroid {
       virtual bool on_key_press_event (GdkEventKey *) override;
 
     private:
-      std::chrono::time_point<std::chrono::steady_clock> last_redraw;
       bool redraw ();
   };
 
@@ -67,6 +67,7 @@ namespace Astroid {
 
   PageClient::~PageClient () {
     LOG (debug) << "pc: destruct";
+    verifications_c.disconnect ();
     g_signal_handler_disconnect (thread_view->context,
         extension_connect_id);
 
@@ -234,6 +235,10 @@ namespace Astroid {
 
   void PageClient::clear_messages () {
     LOG (debug) << "pc: clear messages..";
+    verifications.clear ();
+    verifications_c.disconnect ();
+    recipients_sent.clear ();
+
     AstroidMessages::ClearMessage c;
     c.set_yes (true);
     AeProtocol::send_message_sync (AeProtocol::MessageTypes::ClearMessages, c, ostream, m_ostream, istream, m_istream);
@@ -306,6 +311,10 @@ namespace Astroid {
     handle_ack (
         AeProtocol::send_message_sync (AeProtocol::MessageTypes::Hidden, msg, ostream, m_ostream, istream, m_istream)
         );
+
+    if (!hidden && !recipients_sent.count (m)) {
+      update_message (m, AstroidMessages::UpdateMessage_Type_Header);
+    }
   }
 
   void PageClient::set_focus (refptr<Message> m, unsigned int e) {
@@ -351,6 +360,8 @@ namespace Astroid {
   }
 
   void PageClient::remove_message (refptr<Message> m) {
+    recipients_sent.erase (m);
+
     AstroidMessages::Message msg;
     msg.set_mid (m->safe_mid()); // just mid.
     handle_ack (
@@ -375,36 +386,88 @@ namespace Astroid {
         );
   }
 
+  void PageClient::watch_verification (refptr<Message> m, refptr<Crypto> cr) {
+    verifications.push_back (std::make_pair (m, cr));
+
+    if (!verifications_c.connected ()) {
+      verifications_c = Glib::signal_timeout ().connect (
+          sigc::mem_fun (this, &PageClient::check_verifications), 100);
+    }
+  }
+
+  bool PageClient::check_verifications () {
+    std::vector<refptr<Message>> done;
+
+    for (auto it = verifications.begin (); it != verifications.end ();) {
+      if (it->second->verifying ()) {
+        it++;
+        continue;
+      }
+
+      if (std::find (done.begin (), done.end (), it->first) == done.end ()) {
+        done.push_back (it->first);
+      }
+
+      it = verifications.erase (it);
+    }
+
+    for (auto &m : done) {
+      /* a message with another part still being verified is updated when
+       * that is done as well */
+      bool more = std::any_of (verifications.begin (), verifications.end (),
+          [&] (const std::pair<refptr<Message>, refptr<Crypto>> & v) { return v.first == m; });
+
+      if (!more && thread_view->state.count (m)) {
+        LOG (debug) << "pc: signatures verified, updating: " << m->safe_mid ();
+        update_message (m, AstroidMessages::UpdateMessage_Type_VisibleParts);
+      }
+    }
+
+    return !verifications.empty ();
+  }
+
   AstroidMessages::Message PageClient::make_message (refptr<Message> m, bool keep_state) {
     typedef ThreadView::MessageState MessageState;
     AstroidMessages::Message msg;
 
+    /* the tree may have been dropped while collapsed */
+    m->ensure_loaded ();
+
     msg.set_mid (m->safe_mid());
 
-    Address sender (m->sender);
+    Address & sender = m->sender_address ();
     msg.mutable_sender()->set_name (sender.fail_safe_name ());
     msg.mutable_sender()->set_email (sender.email ());
     msg.mutable_sender ()->set_full_address (sender.full_address ());
 
-    for (Address &recipient: AddressList(m->to()).addresses) {
-      AstroidMessages::Address * a = msg.mutable_to()->add_addresses();
-      a->set_name (recipient.fail_safe_name ());
-      a->set_email (recipient.email ());
-      a->set_full_address (recipient.full_address ());
-    }
+    /* the recipients of a collapsed message are parsed and sent when it is
+     * expanded, see set_hidden_state () */
+    auto st = thread_view->state.find (m);
+    if (thread_view->edit_mode || recipients_sent.count (m) ||
+        (st != thread_view->state.end () && st->second.expanded)) {
 
-    for (Address &recipient: AddressList(m->cc()).addresses) {
-      AstroidMessages::Address * a = msg.mutable_cc()->add_addresses();
-      a->set_name (recipient.fail_safe_name ());
-      a->set_email (recipient.email ());
-      a->set_full_address (recipient.full_address ());
-    }
+      recipients_sent.insert (m);
 
-    for (Address &recipient: AddressList(m->bcc()).addresses) {
-      AstroidMessages::Address * a = msg.mutable_bcc()->add_addresses();
-      a->set_name (recipient.fail_safe_name ());
-      a->set_email (recipient.email ());
-      a->set_full_address (recipient.full_address ());
+      for (Address &recipient: m->to_addresses ().addresses) {
+        AstroidMessages::Address * a = msg.mutable_to()->add_addresses();
+        a->set_name (recipient.fail_safe_name ());
+        a->set_email (recipient.email ());
+        a->set_full_address (recipient.full_address ());
+      }
+
+      for (Address &recipient: m->cc_addresses ().addresses) {
+        AstroidMessages::Address * a = msg.mutable_cc()->add_addresses();
+        a->set_name (recipient.fail_safe_name ());
+        a->set_email (recipient.email ());
+        a->set_full_address (recipient.full_address ());
+      }
+
+      for (Address &recipient: m->bcc_addresses ().addresses) {
+        AstroidMessages::Address * a = msg.mutable_bcc()->add_addresses();
+        a->set_name (recipient.fail_safe_name ());
+        a->set_email (recipient.email ());
+        a->set_full_address (recipient.full_address ());
+      }
     }
 
     msg.set_date_pretty (m->pretty_date ());
@@ -589,9 +652,18 @@ namespace Astroid {
 
       vector<ustring> all_sig_errors;
 
-      if (c->issigned) {
+      if (c->issigned && c->crypt->verifying ()) {
+        /* shown as unverified until the crypto workers are done, the
+         * message is updated then */
+        part->mutable_signature ()->set_verified (false);
+        part->mutable_signature ()->add_sign_strings ("<br />Verifying signature..");
+
+        watch_verification (m, c->crypt);
+
+      } else if (c->issigned) {
 
         refptr<Crypto> cr = c->crypt;
+
         part->mutable_signature()->set_verified (cr->verified);
 
         for (int i = 0; i < g_mime_signature_list_length (cr->slist); i++) {
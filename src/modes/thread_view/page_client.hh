@@ -7,9 +7,11 @@
 # include <gtkmm.h>
 # include <thread>
 # include <atomic>
+# include <set>
 
 # include "astroid.hh"
 # include "thread_view.hh"
+# include "crypto.hh"
 
 # include "messages.pb.h"
 
@@ -73,6 +75,16 @@ namespace Astroid {
       AstroidMessages::Message  make_message (refptr<Message> m, bool keep_state = false);
       AstroidMessages::Message::Chunk * build_mime_tree (refptr<Message> m, refptr<Chunk> c, bool root, bool shallow, bool keep_state = false);
 
+      /* signatures still being verified on the crypto workers, the
+       * message is updated when they are done */
+      std::vector<std::pair<refptr<Message>, refptr<Crypto>>> verifications;
+      sigc::connection verifications_c;
+      void watch_verification (refptr<Message>, refptr<Crypto>);
+      bool check_verifications ();
+
+      /* messages whose recipients have been sent to the page */
+      std::set<refptr<Message>> recipients_sent;
+
       ustring get_attachment_thumbnail (refptr<Chunk>);
       ustring get_attachment_data (refptr<Chunk>);
 
@@ -25,6 +25,7 @@ using namespace boost::filesystem;
 
 namespace Astroid {
   std::atomic<bool> Theme::theme_loaded (false);
+  std::mutex        Theme::theme_m;
   const char * Theme::thread_view_html_f = "ui/thread-view.html";
 # ifndef DISABLE_LIBSASS
   const char * Theme::thread_view_scss_f  = "ui/thread-view.scss";
@@ -46,6 +47,8 @@ namespace Astroid {
     using std::endl;
     LOG (debug) << "theme: loading..";
 
+    std::lock_guard<std::mutex> lk (theme_m);
+
     /* load html and css (from scss) */
     if (reload || !theme_loaded) {
       path tv_html = Resource (true, thread_view_html_f).get_path ();
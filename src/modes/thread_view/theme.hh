@@ -1,6 +1,7 @@
 # pragma once
 
 # include <atomic>
+# include <mutex>
 # include <boost/filesystem.hpp>
 
 # include "proto.hh"
@@ -15,6 +16,7 @@ namespace Astroid {
       void load (bool reload);
 
       static std::atomic<bool> theme_loaded;
+      static std::mutex        theme_m; // theme may be pre-loaded on start up
       static const char *  thread_view_html_f;
 # ifndef DISABLE_LIBSASS
       static const char *  thread_view_scss_f;
@@ -20,6 +20,7 @@
 
 # include "main_window.hh"
 # include "message_thread.hh"
+# include "message_budget.hh"
 # include "chunk.hh"
 # include "crypto.hh"
 # include "db.hh"
@@ -49,6 +50,19 @@ using namespace std;
 using boost::property_tree::ptree;
 
 namespace Astroid {
+  namespace {
+    /* the tags checked on every focus change, resolved once */
+    unsigned int unread_tag () {
+      static const unsigned int id = Db::tag_id ("unread");
+      return id;
+    }
+
+    unsigned int flagged_tag () {
+      static const unsigned int id = Db::tag_id ("flagged");
+      return id;
+    }
+  }
+
 
   ThreadView::ThreadView (MainWindow * mw, bool _edit_mode) : Mode (mw) { //
     edit_mode = _edit_mode;
@@ -431,6 +445,15 @@ namespace Astroid {
     focused_message.clear ();
 
     if (mthread) {
+# ifndef DISABLE_PLUGINS
+      /* format the tags of all messages in one plugin call */
+      if (plugins->batches_tags ()) {
+        std::vector<std::vector<ustring>> tag_sets;
+        for (auto &m : mthread->messages) tag_sets.push_back (m->tags);
+        plugins->format_tags (tag_sets, "#ffffff", false);
+      }
+# endif
+
       for (auto &m : mthread->messages) {
         add_message (m);
       }
@@ -438,10 +461,12 @@ namespace Astroid {
       page_client->update_state ();
       update_all_indent_states ();
 
+      LOG (info) << "tv: message budget: " << MessageBudget::status ();
+
       /* focus oldest unread message */
       if (!edit_mode) {
         for (auto &m : mthread->messages_by_time ()) {
-          if (m->has_tag ("unread")) {
+          if (m->has_tag (unread_tag ())) {
             focused_message = m;
             break;
           }
@@ -496,7 +521,7 @@ namespace Astroid {
 
     if (!edit_mode) {
       /* optionally hide / collapse the message */
-      if (!(m->has_tag("unread") || (expand_flagged && m->has_tag("flagged")))) {
+      if (!(m->has_tag (unread_tag ()) || (expand_flagged && m->has_tag (flagged_tag ())))) {
 
         collapse (m);
       } else {
@@ -866,7 +891,7 @@ namespace Astroid {
           bool foundme = false;
 
           for (auto &m : mthread->messages) {
-            if (foundme && m->has_tag ("unread")) {
+            if (foundme && m->has_tag (unread_tag ())) {
               focus_message (m);
               break;
             }
@@ -887,7 +912,7 @@ namespace Astroid {
 
           for (auto mi = mthread->messages.rbegin ();
               mi != mthread->messages.rend (); mi++) {
-            if (foundme && (*mi)->has_tag ("unread")) {
+            if (foundme && (*mi)->has_tag (unread_tag ())) {
               focus_message (*mi);
               break;
             }
@@ -912,9 +937,9 @@ namespace Astroid {
                otherwise use all recipients as in the original */
             if (astroid->accounts->is_me (sender)) {
               from = sender;
-              to   = AddressList(focused_message->to  ());
-              cc   = AddressList(focused_message->cc  ());
-              bcc  = AddressList(focused_message->bcc ());
+              to   = focused_message->to_addresses ();
+              cc   = focused_message->cc_addresses ();
+              bcc  = focused_message->bcc_addresses ();
             } else {
               /* Not from me, just use orginal sender */
               to += sender;
@@ -1190,14 +1215,14 @@ namespace Astroid {
           for (auto &m : mthread->messages) {
             MessageState s = state[m];
             if (s.marked) {
-              auto d   = m->raw_contents ();
-              auto cnv = UstringUtils::bytearray_to_ustring (d);
+              auto d   = m->raw_view ();
+              auto cnv = UstringUtils::bytes_to_unix_ustring (d);
               if (cnv.first) {
                 y += ustring::compose ("From %1  %2",
                     Address(m->sender).email(),
                     m->date_asctime ()); // asctime adds a \n
 
-                y += UstringUtils::unixify (cnv.second);
+                y += cnv.second;
                 y += "\n";
               }
             }
@@ -1708,10 +1733,10 @@ namespace Astroid {
         auto    cp = Gtk::Clipboard::get (astroid->clipboard_target);
         ustring t  = "";
 
-        auto d   = focused_message->raw_contents ();
-        auto cnv = UstringUtils::bytearray_to_ustring (d);
+        auto d   = focused_message->raw_view ();
+        auto cnv = UstringUtils::bytes_to_unix_ustring (d);
         if (cnv.first) {
-          t = UstringUtils::unixify (cnv.second);
+          t = cnv.second;
         }
 
         cp->set_text (t);
@@ -1738,10 +1763,10 @@ namespace Astroid {
           auto    cp = Gtk::Clipboard::get (astroid->clipboard_target);
           ustring t  = "";
 
-          auto d = focused_message->raw_contents ();
-          auto cnv = UstringUtils::bytearray_to_ustring (d);
+          auto d = focused_message->raw_view ();
+          auto cnv = UstringUtils::bytes_to_unix_ustring (d);
           if (cnv.first) {
-            t = UstringUtils::unixify (cnv.second);
+            t = cnv.second;
           }
 
           cp->set_text (t);
@@ -1764,10 +1789,14 @@ namespace Astroid {
           auto cp = Gtk::Clipboard::get (astroid->clipboard_target);
           ustring t = "";
 
-          auto d   = c->contents ();
-          auto cnv = UstringUtils::bytearray_to_ustring (d);
-          if (cnv.first) {
-            t = cnv.second;
+          if (c) {
+            auto d   = c->contents ();
+            auto cnv = UstringUtils::bytearray_to_ustring (d);
+            if (cnv.first) {
+              t = cnv.second;
+            }
+          } else {
+            LOG (error) << "tv: could not find chunk for element.";
           }
 
           cp->set_text (t);
@@ -1779,7 +1808,7 @@ namespace Astroid {
           auto cp = Gtk::Clipboard::get (astroid->clipboard_target);
           ustring t;
 
-          if (c->viewable) {
+          if (c && c->viewable) {
             t = c->viewable_text (false, false);
           } else {
             LOG (error) << "tv: cannot yank text of non-viewable part";
@@ -1860,13 +1889,17 @@ namespace Astroid {
                   refptr<Chunk> c = focused_message->get_chunk_by_id (
                       state[focused_message].elements[state[focused_message].current_element].id);
 
-                  refptr<MessageThread> mt = refptr<MessageThread> (new MessageThread ());
-                  mt->add_message (c);
+                  if (c) {
+                    refptr<MessageThread> mt = refptr<MessageThread> (new MessageThread ());
+                    mt->add_message (c);
 
-                  ThreadView * tv = Gtk::manage(new ThreadView (main_window));
-                  tv->load_message_thread (mt);
+                    ThreadView * tv = Gtk::manage(new ThreadView (main_window));
+                    tv->load_message_thread (mt);
 
-                  main_window->add_mode (tv);
+                    main_window->add_mode (tv);
+                  } else {
+                    LOG (error) << "tv: could not find chunk for element.";
+                  }
 
                 } else if (a == ESave) {
                   /* save part */
@@ -1908,7 +1941,7 @@ namespace Astroid {
         chrono::duration<double> elapsed = chrono::steady_clock::now() - focus_time;
 
         if (unread_delay == 0.0 || elapsed.count () > unread_delay) {
-          if (focused_message->has_tag ("unread")) {
+          if (focused_message->has_tag (unread_tag ())) {
 
             main_window->actions->doit (refptr<Action>(new TagAction (refptr<NotmuchItem>(new NotmuchMessage(focused_message)), {}, { "unread" })), false);
             state[focused_message].unread_checked = true;
@@ -1941,6 +1974,9 @@ namespace Astroid {
     state[m].expanded = true;
     page_client->set_hidden_state (m, false);
 
+    m->may_unload = false;
+    m->ensure_loaded ();
+
     if (!wasexpanded) {
       /* if the message was unexpanded, it would not have been marked as read */
       if (unread_delay == 0.0) unread_check ();
@@ -1956,6 +1992,9 @@ namespace Astroid {
     page_client->set_hidden_state (m, true);
     state[m].expanded = false;
 
+    /* the parsed tree of a collapsed message may be dropped */
+    m->may_unload = true;
+    MessageBudget::trim ();
 
     return wasexpanded;
   }
@@ -776,6 +776,10 @@ void AstroidExtension::update_message (AstroidMessages::UpdateMessage &um) {
     LOG (debug) << "updating message: " << m.mid () << " (tags only)";
     message_render_tags (m, WEBKIT_DOM_HTML_ELEMENT(old_div_message));
     message_update_css_tags (m, WEBKIT_DOM_HTML_ELEMENT(old_div_message));
+
+  } else if (um.type () == AstroidMessages::UpdateMessage_Type_Header) {
+    LOG (debug) << "updating message: " << m.mid () << " (header only)";
+    message_render_header (m, WEBKIT_DOM_HTML_ELEMENT(old_div_message));
   }
 
   g_object_unref (old_div_message);
@@ -785,17 +789,14 @@ void AstroidExtension::update_message (AstroidMessages::UpdateMessage &um) {
   ack (true);
 }
 
-/* main message generation  */
-void AstroidExtension::set_message_html (
-    AstroidMessages::Message m,
+/* header rows, subject and avatar: also used to fill in the recipients
+ * of a message that was added collapsed */
+void AstroidExtension::message_render_header (
+    AstroidMessages::Message &m,
     WebKitDOMHTMLElement * div_message)
 {
   GError *err;
-
-  /* load message into div */
   ustring header;
-  WebKitDOMHTMLElement * div_email_container =
-    DomUtils::select (WEBKIT_DOM_NODE(div_message),  ".email_container");
 
   /* build header */
   insert_header_address (header, "From", m.sender(), true);
@@ -847,8 +848,8 @@ void AstroidExtension::set_message_html (
 
   /* insert header html*/
   WebKitDOMHTMLElement * table_header =
-    DomUtils::select (WEBKIT_DOM_NODE(div_email_container),
-        ".header_container .header" );
+    DomUtils::select (WEBKIT_DOM_NODE(div_message),
+        ".email_container .header_container .header" );
 
   header += create_header_row ("Tags", "", false, false, true);
 
@@ -862,6 +863,22 @@ void AstroidExtension::set_message_html (
     message_update_css_tags (m, WEBKIT_DOM_HTML_ELEMENT(div_message));
   }
 
+  g_object_unref (table_header);
+}
+
+/* main message generation  */
+void AstroidExtension::set_message_html (
+    AstroidMessages::Message m,
+    WebKitDOMHTMLElement * div_message)
+{
+  GError *err;
+
+  /* load message into div */
+  WebKitDOMHTMLElement * div_email_container =
+    DomUtils::select (WEBKIT_DOM_NODE(div_message),  ".email_container");
+
+  message_render_header (m, div_message);
+
   /* if message is missing body, set warning and don't add any content */
   WebKitDOMHTMLElement * span_body =
     DomUtils::select (WEBKIT_DOM_NODE(div_email_container),
@@ -915,7 +932,6 @@ void AstroidExtension::set_message_html (
 
   g_object_unref (preview);
   g_object_unref (span_body);
-  g_object_unref (table_header);
 } //
 
 void AstroidExtension::message_render_tags (AstroidMessages::Message &m,
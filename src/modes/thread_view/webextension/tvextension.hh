@@ -136,6 +136,8 @@ class AstroidExtension {
     void insert_attachments (AstroidMessages::Message &m,
         WebKitDOMHTMLElement * div_message);
 
+    void message_render_header (AstroidMessages::Message &m,
+        WebKitDOMHTMLElement * div_message);
     void message_render_tags (AstroidMessages::Message &m,
         WebKitDOMHTMLElement * div_message);
     void message_update_css_tags (AstroidMessages::Message &m,
@@ -1,7 +1,13 @@
 # include <libpeas/peas.h>
 # include <glibmm.h>
 # include <vector>
+# include <algorithm>
+# include <atomic>
+# include <future>
+# include <chrono>
+# include <sstream>
 # include <cstdlib>
+# include <sys/stat.h>
 
 # include <boost/filesystem.hpp>
 
@@ -134,6 +140,7 @@ namespace Astroid {
    * ********************/
   PluginManager::Extension::Extension () {
     engine        = astroid->plugin_manager->engine;
+    memoize       = astroid->config ("astroid.plugins").get<bool> ("memoize");
   }
 
   PluginManager::Extension::~Extension () {
@@ -142,12 +149,125 @@ namespace Astroid {
     if (extensions) g_object_unref (extensions);
   }
 
+  std::string PluginManager::Extension::memo_key (const std::vector<ustring> & tags, ustring bg, bool selected) {
+    std::string k;
+
+    for (auto &t : tags) {
+      k += t;
+      k += '\x1f';
+    }
+
+    k += '\x1e';
+    k += bg;
+    k += (selected ? "+" : "-");
+
+    return k;
+  }
+
+  bool PluginManager::Extension::memo_find (const std::string & key, bool & res, ustring & out) {
+    if (!memoize) return false;
+
+    auto f = memo.find (key);
+    if (f == memo.end ()) return false;
+
+    res = f->second.first;
+    if (res) out = f->second.second;
+
+    return true;
+  }
+
+  void PluginManager::Extension::memo_add (const std::string & key, bool res, ustring out) {
+    if (!memoize) return;
+
+    if (memo.size () >= max_memo) memo.clear ();
+    memo[key] = std::make_pair (res, out);
+  }
+
+  bool PluginManager::Extension::formatted (const std::vector<ustring> & tags, ustring bg, bool selected) {
+    return memoize && memo.count (memo_key (tags, bg, selected)) > 0;
+  }
+
+  bool PluginManager::Extension::batches_tags () const {
+    return active && memoize && tags_batch;
+  }
+
+  bool PluginManager::Extension::find_tags_batch (
+      const std::vector<PeasPluginInfo *> & plugins,
+      HasHook has_batch,
+      HasHook has_single) {
+
+    for (PeasPluginInfo * p : plugins) {
+      PeasExtension * pe = peas_extension_set_get_extension (extensions, p);
+      if (!pe) continue;
+
+      if (has_batch (pe))  return true;
+      if (has_single (pe)) return false;
+    }
+
+    return false;
+  }
+
+  void PluginManager::Extension::format_tags_batch (
+      const std::vector<PeasPluginInfo *> & plugins,
+      std::vector<std::vector<ustring>> tag_sets,
+      ustring bg,
+      bool selected,
+      TagsBatchHook batch,
+      HasHook has_single) {
+
+    if (!batches_tags () || astroid->plugin_manager->disabled) return;
+
+    /* the sets that have not been formatted yet, tags separated by newline */
+    std::vector<std::string> keys;
+    std::vector<ustring>     sets;
+
+    for (auto &tags : tag_sets) {
+      std::string key = memo_key (tags, bg, selected);
+      if (memo.count (key) || std::find (keys.begin (), keys.end (), key) != keys.end ()) continue;
+
+      keys.push_back (key);
+      sets.push_back (VectorUtils::concat (tags, "\n"));
+    }
+
+    if (keys.empty ()) return;
+
+    for (PeasPluginInfo * p : plugins) {
+      PeasExtension * pe = peas_extension_set_get_extension (extensions, p);
+
+      if (!pe) continue;
+
+      GList * r = batch (pe, bg.c_str (), Glib::ListHandler<ustring>::vector_to_list (sets).data (), selected);
+
+      if (r != NULL) {
+        std::vector<ustring> out = Glib::ListHandler<ustring>::list_to_vector (r, Glib::OWNERSHIP_DEEP);
+
+        if (out.size () != keys.size ()) {
+          LOG (error) << "plugins: format_tags_batch returned " << out.size () << " results for " << keys.size () << " tag sets.";
+          return;
+        }
+
+        for (size_t i = 0; i < keys.size (); i++) memo_add (keys[i], true, out[i]);
+
+        LOG (debug) << "plugins: formatted " << keys.size () << " tag sets in one call.";
+        return;
+      }
+
+      /* a plugin earlier in the chain without the batch hook takes
+       * precedence, leave these for format_tags. */
+      if (has_single (pe)) return;
+    }
+  }
+
   /* ********************
    * AstroidExtension
    * ********************/
   PluginManager::AstroidExtension::AstroidExtension (Astroid * a) {
     astroid = a;
 
+    ptree pc = astroid->config ("astroid.plugins");
+    max_process_cache = std::max (0, pc.get<int> ("process_cache")) * 1024 * 1024;
+    process_workers   = std::max (1, pc.get<int> ("process_workers"));
+
     if (astroid->plugin_manager->disabled) return;
 
     /* loading extensions for each plugin */
@@ -164,12 +284,36 @@ namespace Astroid {
       }
     }
 
+    /* messages are only stat'ed and cached when a plugin implements the
+     * process hook. it is only run in parallel when all the plugins
+     * implementing it are python plugins: pygobject takes the interpreter
+     * lock around every call. a lua state (or a c plugin) may not be used
+     * from several threads at once. */
+    process_parallel = process_workers > 1;
+
+    for ( PeasPluginInfo *p : astroid->plugin_manager->astroid_plugins) {
+      PeasExtension * pe = peas_extension_set_get_extension (extensions, p);
+      if (!ASTROID_IS_ACTIVATABLE (pe) || ASTROID_ACTIVATABLE_GET_IFACE (pe)->process == NULL) continue;
+
+      has_process = true;
+
+      const char * loader = peas_plugin_info_get_external_data (p, "Loader");
+      if (loader == NULL || !(std::string (loader) == "python3" || std::string (loader) == "python")) {
+        LOG (debug) << "plugins: " << peas_plugin_info_get_name (p) << " is not a python plugin, processing messages serially.";
+        process_parallel = false;
+      }
+    }
+
     active = true;
   }
 
   void PluginManager::AstroidExtension::deactivate () {
     active = false;
 
+    if (!process_costs.empty ()) {
+      LOG (info) << "plugins: process hook costs:\n" << dump_process_costs ();
+    }
+
     for ( PeasPluginInfo *p : astroid->plugin_manager->astroid_plugins) {
 
       LOG (debug) << "plugins: deactivating: " << peas_plugin_info_get_name (p);
@@ -220,6 +364,12 @@ namespace Astroid {
 
     if (!active || astroid->plugin_manager->disabled) return clrs;
 
+    std::string key = tag + "\x1e" + bg;
+    if (memoize) {
+      auto f = tag_colors_memo.find (key);
+      if (f != tag_colors_memo.end ()) return f->second;
+    }
+
     for (PeasPluginInfo * p : astroid->plugin_manager->astroid_plugins) {
       PeasExtension * pe = peas_extension_set_get_extension (extensions, p);
 
@@ -238,6 +388,11 @@ namespace Astroid {
       }
     }
 
+    if (memoize) {
+      if (tag_colors_memo.size () >= max_memo) tag_colors_memo.clear ();
+      tag_colors_memo[key] = clrs;
+    }
+
     return clrs;
   }
 
@@ -269,16 +424,172 @@ namespace Astroid {
 
   GMimeStream * PluginManager::AstroidExtension::process (
       const char * fname) {
-    if (!active || astroid->plugin_manager->disabled) return NULL;
+    if (!active || astroid->plugin_manager->disabled || !has_process) return NULL;
+
+    Processed pr;
+    if (!file_stamp (fname, pr)) return NULL;
+
+    {
+      std::lock_guard<std::mutex> lk (process_m);
+
+      /* the stream is copied straight from the cache entry */
+      auto f = process_cache.find (fname);
+      if (f != process_cache.end () && f->second.mtime == pr.mtime && f->second.size == pr.size) {
+        if (!f->second.processed) return NULL;
+        return g_mime_stream_mem_new_with_buffer ((const guint8 *) f->second.data.data (), f->second.data.size ());
+      }
+    }
+
+    run_process (fname, pr);
+
+    GMimeStream * s = NULL;
+    if (pr.processed) {
+      s = g_mime_stream_mem_new_with_buffer ((const guint8 *) pr.data.data (), pr.data.size ());
+    }
+
+    add_processed (fname, std::move (pr));
+
+    return s;
+  }
+
+  void PluginManager::AstroidExtension::process (std::vector<ustring> fnames) {
+    if (!active || astroid->plugin_manager->disabled || max_process_cache == 0) return;
+    if (!has_process) return;
+
+    /* the files that have not been processed yet */
+    std::vector<std::pair<std::string, Processed>> todo;
+
+    {
+      std::lock_guard<std::mutex> lk (process_m);
+
+      for (auto &fname : fnames) {
+        Processed pr;
+        if (!file_stamp (fname.c_str (), pr)) continue;
+
+        auto f = process_cache.find (fname);
+        if (f != process_cache.end () && f->second.mtime == pr.mtime && f->second.size == pr.size) continue;
+
+        todo.push_back (std::make_pair (std::string (fname), pr));
+      }
+    }
+
+    if (todo.size () < 2) return; // on demand
+
+    auto start = std::chrono::steady_clock::now ();
+
+    std::atomic<size_t> next (0);
+
+    auto job = [&] () {
+      size_t i;
+      while ((i = next++) < todo.size ()) {
+        run_process (todo[i].first.c_str (), todo[i].second);
+        add_processed (todo[i].first, std::move (todo[i].second));
+      }
+    };
+
+    size_t n = process_parallel ? std::min<size_t> (process_workers, todo.size ()) : 1;
+
+    std::vector<std::future<void>> fs;
+    for (size_t i = 1; i < n; i++) {
+      fs.push_back (std::async (std::launch::async, job));
+    }
+
+    job ();
+    for (auto &f : fs) f.wait ();
+
+    LOG (debug) << "plugins: processed " << todo.size () << " messages with "
+      << n << " workers in "
+      << std::chrono::duration_cast<std::chrono::milliseconds> (std::chrono::steady_clock::now () - start).count ()
+      << " ms.";
+  }
+
+  bool PluginManager::AstroidExtension::file_stamp (const char * fname, Processed & pr) {
+    struct stat st;
+    if (stat (fname, &st) != 0) return false;
+
+    pr.mtime = st.st_mtime;
+    pr.size  = st.st_size;
+
+    return true;
+  }
+
+  void PluginManager::AstroidExtension::run_process (const char * fname, Processed & pr) {
+    pr.processed = false;
+    pr.data.clear ();
 
     for (PeasPluginInfo * p : astroid->plugin_manager->astroid_plugins) {
       PeasExtension * pe = peas_extension_set_get_extension (extensions, p);
 
+      auto start = std::chrono::steady_clock::now ();
+
       GMimeStream * ret = astroid_activatable_process (ASTROID_ACTIVATABLE(pe), fname);
-      if(ret != NULL) return ret;
+
+      double ms = std::chrono::duration<double, std::milli> (std::chrono::steady_clock::now () - start).count ();
+
+      {
+        std::lock_guard<std::mutex> lk (process_m);
+        Cost & c = process_costs[peas_plugin_info_get_name (p)];
+        c.count++;
+        c.total += ms;
+        c.max    = std::max (c.max, ms);
+      }
+
+      if (ret != NULL) {
+        /* keep the processed message, the stream is read by the parser */
+        GMimeStream * mem = g_mime_stream_mem_new ();
+        g_mime_stream_write_to_stream (ret, mem);
+
+        GByteArray * b = g_mime_stream_mem_get_byte_array (GMIME_STREAM_MEM (mem));
+        pr.data.assign ((const char *) b->data, b->len);
+        pr.processed = true;
+
+        g_object_unref (mem);
+        g_object_unref (ret);
+        return;
+      }
     }
+  }
+
+  void PluginManager::AstroidExtension::add_processed (std::string fname, Processed && pr) {
+    if (max_process_cache == 0) return;
+
+    size_t bytes = fname.size () + pr.data.size ();
+    if (bytes > max_process_cache) return;
 
-    return NULL;
+    std::lock_guard<std::mutex> lk (process_m);
+
+    auto f = process_cache.find (fname);
+    if (f == process_cache.end ()) {
+      process_order.push_back (fname);
+    } else {
+      process_cache_bytes -= fname.size () + f->second.data.size ();
+    }
+
+    process_cache[fname] = std::move (pr);
+    process_cache_bytes += bytes;
+
+    /* the oldest entries are dropped until the cache fits */
+    while (process_cache_bytes > max_process_cache) {
+      auto o = process_cache.find (process_order.front ());
+      process_cache_bytes -= o->first.size () + o->second.data.size ();
+
+      process_cache.erase (o);
+      process_order.pop_front ();
+    }
+  }
+
+  std::string PluginManager::AstroidExtension::dump_process_costs () {
+    std::lock_guard<std::mutex> lk (process_m);
+
+    std::ostringstream o;
+
+    for (auto &c : process_costs) {
+      o << c.first << ": " << c.second.count << " messages, "
+        << (c.second.count > 0 ? c.second.total / c.second.count : 0) << " ms avg, "
+        << c.second.max << " ms max\n";
+    }
+
+    return o.str ();
   }
 
   /* ********************
@@ -304,6 +615,10 @@ namespace Astroid {
       }
     }
 
+    tags_batch = find_tags_batch (astroid->plugin_manager->thread_index_plugins,
+        [] (PeasExtension * pe) { return ASTROID_THREADINDEX_ACTIVATABLE_GET_IFACE (pe)->format_tags_batch != NULL; },
+        [] (PeasExtension * pe) { return ASTROID_THREADINDEX_ACTIVATABLE_GET_IFACE (pe)->format_tags != NULL; });
+
     active = true;
   }
 
@@ -328,6 +643,10 @@ namespace Astroid {
       ustring &out) {
     if (!active || astroid->plugin_manager->disabled) return false;
 
+    std::string key = memo_key (tags, bg, selected);
+    bool res;
+    if (memo_find (key, res, out)) return res;
+
     for (PeasPluginInfo * p : astroid->plugin_manager->thread_index_plugins) {
       PeasExtension * pe = peas_extension_set_get_extension (extensions, p);
 
@@ -337,14 +656,31 @@ namespace Astroid {
 
         if (tgs != NULL) {
           out = ustring (tgs);
+          memo_add (key, true, out);
           return true;
         }
       }
     }
 
+    memo_add (key, false, "");
     return false;
   }
 
+  void PluginManager::ThreadIndexExtension::format_tags (
+      std::vector<std::vector<ustring>> tag_sets,
+      ustring bg,
+      bool selected) {
+
+    format_tags_batch (astroid->plugin_manager->thread_index_plugins,
+        tag_sets, bg, selected,
+        [] (PeasExtension * pe, const char * bg, GList * sets, bool selected) {
+          return astroid_threadindex_activatable_format_tags_batch (ASTROID_THREADINDEX_ACTIVATABLE(pe), bg, sets, selected);
+        },
+        [] (PeasExtension * pe) {
+          return ASTROID_THREADINDEX_ACTIVATABLE_GET_IFACE (pe)->format_tags != NULL;
+        });
+  }
+
   /* ************************
    * ThreadViewExtension
    * ************************/
@@ -365,6 +701,10 @@ namespace Astroid {
       }
     }
 
+    tags_batch = find_tags_batch (astroid->plugin_manager->thread_view_plugins,
+        [] (PeasExtension * pe) { return ASTROID_THREADVIEW_ACTIVATABLE_GET_IFACE (pe)->format_tags_batch != NULL; },
+        [] (PeasExtension * pe) { return ASTROID_THREADVIEW_ACTIVATABLE_GET_IFACE (pe)->format_tags != NULL; });
+
     active = true;
   }
 
@@ -385,6 +725,8 @@ namespace Astroid {
   bool PluginManager::ThreadViewExtension::get_avatar_uri (ustring email, ustring type, int size, refptr<Message> m, ustring &out) {
     if (!active || astroid->plugin_manager->disabled) return false;
 
+    m->ensure_loaded ();
+
     for (PeasPluginInfo * p : astroid->plugin_manager->thread_view_plugins) {
       PeasExtension * pe = peas_extension_set_get_extension (extensions, p);
 
@@ -425,6 +767,10 @@ namespace Astroid {
       ustring &out) {
     if (!active || astroid->plugin_manager->disabled) return false;
 
+    std::string key = memo_key (tags, bg, selected);
+    bool res;
+    if (memo_find (key, res, out)) return res;
+
     for (PeasPluginInfo * p : astroid->plugin_manager->thread_view_plugins) {
       PeasExtension * pe = peas_extension_set_get_extension (extensions, p);
 
@@ -434,14 +780,31 @@ namespace Astroid {
 
         if (tgs != NULL) {
           out = ustring (tgs);
+          memo_add (key, true, out);
           return true;
         }
       }
     }
 
+    memo_add (key, false, "");
     return false;
   }
 
+  void PluginManager::ThreadViewExtension::format_tags (
+      std::vector<std::vector<ustring>> tag_sets,
+      ustring bg,
+      bool selected) {
+
+    format_tags_batch (astroid->plugin_manager->thread_view_plugins,
+        tag_sets, bg, selected,
+        [] (PeasExtension * pe, const char * bg, GList * sets, bool selected) {
+          return astroid_threadview_activatable_format_tags_batch (ASTROID_THREADVIEW_ACTIVATABLE(pe), bg, sets, selected);
+        },
+        [] (PeasExtension * pe) {
+          return ASTROID_THREADVIEW_ACTIVATABLE_GET_IFACE (pe)->format_tags != NULL;
+        });
+  }
+
   std::string PluginManager::ThreadViewExtension::filter_part (
       std::string input_text,
       std::string input_html,
@@ -2,6 +2,12 @@
 
 # include <libpeas/peas.h>
 # include <vector>
+# include <string>
+# include <map>
+# include <deque>
+# include <mutex>
+# include <functional>
+# include <unordered_map>
 
 # include "astroid.hh"
 # include "proto.hh"
@@ -26,10 +32,47 @@ namespace Astroid {
           PeasExtensionSet  * extensions = NULL;
           bool active = false;
 
+          /* the results of the pure hooks (e.g. format_tags) are kept by
+           * their arguments, plugins are expected to return the same
+           * result for the same arguments. */
+          bool memoize = true;
+          const size_t max_memo = 4096;
+          std::unordered_map<std::string, std::pair<bool, ustring>> memo;
+
+          static std::string memo_key (const std::vector<ustring> & tags, ustring bg, bool selected);
+          bool memo_find (const std::string & key, bool & res, ustring & out);
+          void memo_add (const std::string & key, bool res, ustring out);
+
+          /* the format_tags_batch hook of the extension type, and whether a
+           * plugin implements a hook */
+          typedef std::function<GList * (PeasExtension *, const char * bg, GList * tag_sets, bool selected)> TagsBatchHook;
+          typedef std::function<bool (PeasExtension *)> HasHook;
+
+          /* a plugin implements format_tags_batch before any plugin that
+           * only implements format_tags, set up on activation */
+          bool tags_batch = false;
+          bool find_tags_batch (const std::vector<PeasPluginInfo *> &, HasHook has_batch, HasHook has_single);
+
+          /* format the tag sets that are not memoized yet with the batch
+           * hook, the results are memoized for format_tags. */
+          void format_tags_batch (
+              const std::vector<PeasPluginInfo *> &,
+              std::vector<std::vector<ustring>> tag_sets,
+              ustring bg,
+              bool selected,
+              TagsBatchHook batch,
+              HasHook has_single);
+
         public:
           Extension ();
           virtual ~Extension ();
 
+          /* the result for these arguments is memoized */
+          bool formatted (const std::vector<ustring> & tags, ustring bg, bool selected);
+
+          /* tag sets are worth batching, see format_tags_batch */
+          bool batches_tags () const;
+
           virtual void deactivate () = 0;
       };
 
@@ -47,6 +90,46 @@ namespace Astroid {
           std::pair<ustring, ustring> get_tag_colors (ustring tag, ustring bg);
           std::vector<std::pair<ustring, ustring>> get_queries ();
           GMimeStream * process (const char * fname);
+
+          /* run the process hook for these files, in parallel if the
+           * plugins allow it. the results are kept for process (const char *). */
+          void process (std::vector<ustring> fnames);
+
+          /* time spent in the process hook by each plugin */
+          std::string dump_process_costs ();
+
+        private:
+          std::unordered_map<std::string, std::pair<ustring, ustring>> tag_colors_memo;
+
+          /* processed messages, by file name. an entry is valid as long
+           * as the file has the same modification time and size. */
+          struct Processed {
+            time_t      mtime;
+            off_t       size;
+            bool        processed; // by any plugin
+            std::string data;
+          };
+
+          std::mutex process_m;
+          std::map<std::string, Processed> process_cache;
+          std::deque<std::string>          process_order;
+          size_t       max_process_cache;   // bytes
+          size_t       process_cache_bytes = 0;
+          unsigned int process_workers;
+          bool         process_parallel = false;
+          bool         has_process      = false; // a plugin implements process
+
+          struct Cost {
+            unsigned long count = 0;
+            double total = 0; // ms
+            double max   = 0; // ms
+          };
+
+          std::map<std::string, Cost> process_costs;
+
+          static bool file_stamp (const char * fname, Processed &);
+          void run_process (const char * fname, Processed &);
+          void add_processed (std::string fname, Processed &&);
       };
 
       AstroidExtension * astroid_extension; // set up from Astroid
@@ -61,6 +144,10 @@ namespace Astroid {
           void deactivate () override;
 
           bool format_tags (std::vector<ustring> tags, ustring bg, bool selected, ustring &out);
+
+          /* format many tag sets in one plugin call, the results are
+           * memoized for format_tags. */
+          void format_tags (std::vector<std::vector<ustring>> tag_sets, ustring bg, bool selected);
       };
 
       class ThreadViewExtension : public Extension {
@@ -73,6 +160,7 @@ namespace Astroid {
           std::vector<ustring> get_allowed_uris ();
           bool get_avatar_uri (ustring email, ustring type, int size, refptr<Message> m, ustring &out);
           bool format_tags (std::vector<ustring> tags, ustring bg, bool selected, ustring &out);
+          void format_tags (std::vector<std::vector<ustring>> tag_sets, ustring bg, bool selected);
           std::string filter_part (std::string input_text, std::string input_html, std::string mime_type, bool is_patch);
 
       };
@@ -112,3 +112,26 @@ astroid_threadindex_activatable_format_tags (AstroidThreadIndexActivatable * act
   return NULL;
 }
 
+/**
+ * astroid_threadindex_activatable_format_tags_batch:
+ * @activatable: A #AstroidThreadIndexActivatable.
+ * @bg : A #utf8.
+ * @tag_sets: (element-type utf8) (transfer none): List of tag sets, the tags of each set separated by a newline.
+ * @selected: A #bool.
+ *
+ * Returns: (element-type utf8) (transfer full): List of formatted tag sets in the same order, or NULL if not implemented.
+ */
+GList *
+astroid_threadindex_activatable_format_tags_batch (AstroidThreadIndexActivatable * activatable, const char * bg, GList * tag_sets, bool selected)
+{
+	AstroidThreadIndexActivatableInterface *iface;
+
+	if (!ASTROID_IS_THREADINDEX_ACTIVATABLE (activatable)) return NULL;
+
+	iface = ASTROID_THREADINDEX_ACTIVATABLE_GET_IFACE (activatable);
+	if (iface->format_tags_batch)
+		return iface->format_tags_batch (activatable, bg, tag_sets, selected);
+
+  return NULL;
+}
+
@@ -26,6 +26,7 @@ struct _AstroidThreadIndexActivatableInterface
 	void (*update_state) (AstroidThreadIndexActivatable * activatable);
 
   char* (*format_tags) (AstroidThreadIndexActivatable * activatable, const char *bg, GList * tags, bool selected);
+  GList* (*format_tags_batch) (AstroidThreadIndexActivatable * activatable, const char *bg, GList * tag_sets, bool selected);
 };
 
 GType astroid_threadindex_activatable_get_type (void) G_GNUC_CONST;
@@ -37,6 +38,7 @@ void astroid_threadindex_activatable_deactivate (AstroidThreadIndexActivatable *
 void astroid_threadindex_activatable_update_state (AstroidThreadIndexActivatable *activatable);
 
 char * astroid_threadindex_activatable_format_tags (AstroidThreadIndexActivatable * activatable, const char * bg, GList * tags, bool selected);
+GList * astroid_threadindex_activatable_format_tags_batch (AstroidThreadIndexActivatable * activatable, const char * bg, GList * tag_sets, bool selected);
 
 
 G_END_DECLS
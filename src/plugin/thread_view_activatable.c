@@ -165,6 +165,29 @@ astroid_threadview_activatable_format_tags (AstroidThreadViewActivatable * activ
   return NULL;
 }
 
+/**
+ * astroid_threadview_activatable_format_tags_batch:
+ * @activatable: A #AstroidThreadViewActivatable.
+ * @bg : A #utf8.
+ * @tag_sets: (element-type utf8) (transfer none): List of tag sets, the tags of each set separated by a newline.
+ * @selected: A #bool.
+ *
+ * Returns: (element-type utf8) (transfer full): List of formatted tag sets in the same order, or NULL if not implemented.
+ */
+GList *
+astroid_threadview_activatable_format_tags_batch (AstroidThreadViewActivatable * activatable, const char * bg, GList * tag_sets, bool selected)
+{
+	AstroidThreadViewActivatableInterface *iface;
+
+	if (!ASTROID_IS_THREADVIEW_ACTIVATABLE (activatable)) return NULL;
+
+	iface = ASTROID_THREADVIEW_ACTIVATABLE_GET_IFACE (activatable);
+	if (iface->format_tags_batch)
+		return iface->format_tags_batch (activatable, bg, tag_sets, selected);
+
+  return NULL;
+}
+
 /**
  * astroid_threadview_activatable_filter_part:
  * @activatable: A #AstroidThreadViewActivatable.
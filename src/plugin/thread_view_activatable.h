@@ -30,6 +30,7 @@ struct _AstroidThreadViewActivatableInterface
   GList* (*get_allowed_uris) (AstroidThreadViewActivatable * activatable);
 
   char*  (*format_tags) (AstroidThreadViewActivatable * activatable, const char *bg, GList * tags, bool selected);
+  GList* (*format_tags_batch) (AstroidThreadViewActivatable * activatable, const char *bg, GList * tag_sets, bool selected);
 
   char*  (*filter_part) (AstroidThreadViewActivatable * activatable, const char * input_text, const char * input_html, const char * mime_type, bool is_patch);
 };
@@ -47,6 +48,7 @@ char * astroid_threadview_activatable_get_avatar_uri (AstroidThreadViewActivatab
 GList * astroid_threadview_activatable_get_allowed_uris (AstroidThreadViewActivatable * activatable);
 
 char * astroid_threadview_activatable_format_tags (AstroidThreadViewActivatable * activatable, const char * bg, GList * tags, bool selected);
+GList * astroid_threadview_activatable_format_tags_batch (AstroidThreadViewActivatable * activatable, const char * bg, GList * tag_sets, bool selected);
 
 char * astroid_threadview_activatable_filter_part (AstroidThreadViewActivatable * activatable, const char * input_text, const char * input_html, const char * mime_type, bool is_patch);
 
@@ -1,4 +1,6 @@
 # include <mutex>
+# include <algorithm>
+# include <set>
 # include <chrono>
 # include <sys/wait.h>
 
@@ -9,6 +11,7 @@
 # include "poll.hh"
 # include "db.hh"
 # include "config.hh"
+# include "contacts.hh"
 # include "actions/action_manager.hh"
 # include "utils/vector_utils.hh"
 
@@ -29,6 +32,10 @@ namespace Astroid {
     full_refresh  = astroid->config ().get<bool> ("poll.always_full_refresh");
     LOG (debug) << "poll: interval: " << poll_interval;
 
+    watch_database = astroid->config ().get<bool> ("poll.watch.database");
+    watch_maildir  = astroid->config ().get<bool> ("poll.watch.maildir");
+    watch_delay    = astroid->config ().get<int> ("poll.watch.delay");
+
     // check every 1 seconds if periodic poll has changed
     Glib::signal_timeout ().connect (
         sigc::mem_fun (this, &Poll::periodic_polling), 1000);
@@ -49,9 +56,252 @@ namespace Astroid {
     } else {
       d_refresh.connect (sigc::mem_fun (this, &Poll::refresh_full));
     }
+
+    scan_stop = false;
+    setup_watchers ();
   }
 
   void Poll::close () {
+    c_watch_check.disconnect ();
+    c_maildir_check.disconnect ();
+
+    {
+      std::lock_guard<std::mutex> lk (scan_m);
+      scan_stop = true;
+      scan_queue.clear ();
+    }
+
+    if (scan_t.joinable ()) scan_t.join ();
+
+    for (auto &w : watchers) w->cancel ();
+    watchers.clear ();
+  }
+
+  void Poll::setup_watchers () {
+    if (!watch_database && !watch_maildir) return;
+
+    if (watch_database) {
+      {
+        Db db (Db::DbMode::DATABASE_READ_ONLY);
+        watched_revision = db.get_revision ();
+      }
+
+      /* xapian writes to its files on every committed change */
+      path xapian = Db::path_db / path (".notmuch/xapian");
+
+      if (is_directory (xapian)) {
+        add_watcher (xapian, WatchDatabase);
+      } else {
+        add_watcher (Db::path_db / path (".notmuch"), WatchDatabase);
+      }
+    }
+
+    if (watch_maildir) {
+      d_scanned.connect (sigc::mem_fun (this, &Poll::on_scanned));
+      scan_maildir (Db::path_db);
+    }
+  }
+
+  void Poll::add_watcher (path p, WatchKind kind) {
+    if (!watched_dirs.insert (p.string ()).second) return;
+
+    try {
+      auto w = Gio::File::create_for_path (p.c_str ())->monitor_directory (Gio::FILE_MONITOR_NONE);
+
+      if (kind == WatchDatabase) {
+        w->signal_changed ().connect (sigc::mem_fun (this, &Poll::on_watch_event));
+      } else {
+        w->signal_changed ().connect (sigc::bind (
+              sigc::mem_fun (this, &Poll::on_maildir_event), kind == WatchNew));
+      }
+
+      watchers.push_back (w);
+
+      LOG (debug) << "poll: watch: " << p.c_str ();
+    } catch (Glib::Error &ex) {
+      LOG (error) << "poll: watch: could not monitor: " << p.c_str () << ": " << ex.what ();
+    }
+  }
+
+  void Poll::on_watch_event (
+      const refptr<Gio::File> &,
+      const refptr<Gio::File> &,
+      Gio::FileMonitorEvent ev)
+  {
+    if (ev == Gio::FILE_MONITOR_EVENT_ATTRIBUTE_CHANGED) return;
+
+    /* events arriving before the check are coalesced into it */
+    if (c_watch_check.connected ()) return;
+
+    c_watch_check = Glib::signal_timeout ().connect (
+        sigc::mem_fun (this, &Poll::on_watch_check), watch_delay);
+  }
+
+  bool Poll::on_watch_check () {
+    if (!m_dopoll.try_lock ()) {
+      /* a poll is running, it refreshes the changed threads when it is done */
+      LOG (debug) << "poll: watch: poll in progress, skipping.";
+      return false;
+    }
+
+    unsigned long revnow;
+    {
+      Db db (Db::DbMode::DATABASE_READ_ONLY);
+      revnow = db.get_revision ();
+    }
+
+    /* skip the revisions written by our own actions, their changes have
+     * been emitted by the action manager already. */
+    for (auto & r : astroid->actions->take_own_revisions ()) {
+      if (r.first <= watched_revision) {
+        watched_revision = std::max (watched_revision, r.second);
+      }
+    }
+
+    if (revnow > watched_revision) {
+      LOG (info) << "poll: watch: database changed (revision: " << watched_revision << " -> " << revnow << ")";
+
+      before_poll_revision = watched_revision;
+
+      if (full_refresh) {
+        refresh_full ();
+        watched_revision = revnow;
+      } else {
+        refresh_threads (); // updates watched_revision
+      }
+    }
+
+    m_dopoll.unlock ();
+
+    return false;
+  }
+
+  void Poll::on_maildir_event (
+      const refptr<Gio::File> & f,
+      const refptr<Gio::File> &,
+      Gio::FileMonitorEvent ev,
+      bool new_dir)
+  {
+    /* only new files and folders are interesting: tagging renames files
+     * in cur and moves them out of new */
+    if (ev != Gio::FILE_MONITOR_EVENT_CREATED) return;
+
+    if (new_dir) {
+      if (c_maildir_check.connected ()) return;
+
+      maildir_event = chrono::steady_clock::now ();
+      c_maildir_check = Glib::signal_timeout ().connect (
+          sigc::mem_fun (this, &Poll::on_maildir_check), watch_delay);
+
+    } else {
+      /* a new folder, or the cur and new directories of one */
+      boost::system::error_code ec;
+      path p (f->get_path ());
+
+      if (is_directory (p, ec)) scan_maildir (p);
+    }
+  }
+
+  bool Poll::on_maildir_check () {
+    /* a poll finished after the mail was delivered, it has been indexed
+     * already (most likely it was delivered by the poll itself). */
+    if (last_poll_done > maildir_event) return false;
+
+    if (!m_dopoll.try_lock ()) {
+      /* try again when the running poll is done */
+      return true;
+    }
+    m_dopoll.unlock ();
+
+    /* the mail must be indexed before it can be refreshed from the
+     * database, so this runs the poll command */
+    LOG (info) << "poll: watch: new mail in maildir, running poll command..";
+    poll ();
+
+    return false;
+  }
+
+  void Poll::scan_maildir (path root) {
+    std::lock_guard<std::mutex> lk (scan_m);
+    if (scan_stop) return;
+
+    scan_queue.push_back (root);
+
+    if (scanning) return;
+
+    if (scan_t.joinable ()) scan_t.join (); // finished
+
+    scanning = true;
+    scan_t = std::thread (&Poll::scan_worker, this);
+  }
+
+  void Poll::scan_worker () {
+    /* only the folders and their new directories are watched: mail is
+     * delivered to new, and folders are created in other folders. */
+    auto kind_of = [] (const path & p, WatchKind & k) {
+      path n = p.filename ();
+      if (n == ".notmuch" || n == "cur" || n == "tmp") return false;
+
+      k = (n == "new") ? WatchNew : WatchFolder;
+      return true;
+    };
+
+    std::unique_lock<std::mutex> lk (scan_m);
+
+    while (!scan_stop && !scan_queue.empty ()) {
+      path root = scan_queue.front ();
+      scan_queue.pop_front ();
+
+      lk.unlock ();
+
+      std::vector<std::pair<path, WatchKind>> found;
+      WatchKind k;
+
+      try {
+        if (kind_of (root, k)) {
+          found.push_back (std::make_pair (root, k));
+
+          if (k == WatchFolder) {
+            for (recursive_directory_iterator it (root), end; !scan_stop && it != end; ++it) {
+              if (!is_directory (it->path ())) continue;
+
+              if (kind_of (it->path (), k)) {
+                found.push_back (std::make_pair (it->path (), k));
+                if (k == WatchNew) it.no_push ();
+              } else {
+                it.no_push ();
+              }
+            }
+          }
+        }
+      } catch (filesystem_error &ex) {
+        LOG (error) << "poll: watch: could not scan maildir: " << ex.what ();
+      }
+
+      lk.lock ();
+
+      scanned.insert (scanned.end (), found.begin (), found.end ());
+      d_scanned ();
+    }
+
+    scanning = false;
+  }
+
+  void Poll::on_scanned () {
+    /* runs on gui thread */
+    std::vector<std::pair<path, WatchKind>> found;
+
+    {
+      std::lock_guard<std::mutex> lk (scan_m);
+      if (scan_stop) return;
+      found.swap (scanned);
+    }
+
+    if (found.empty ()) return;
+
+    for (auto & f : found) add_watcher (f.first, f.second);
+
+    LOG (info) << "poll: watching " << watchers.size () << " directories for changes.";
   }
 
   void Poll::start_polling () {
@@ -89,6 +339,7 @@ namespace Astroid {
     LOG (info) << "poll: external polling stopped.";
 
     refresh_threads ();
+    last_poll_done = chrono::steady_clock::now ();
     external_polling = false;
     set_poll_state (false);
     m_dopoll.unlock ();
@@ -247,6 +498,7 @@ namespace Astroid {
     LOG (info) << "poll: done (time: " << elapsed.count() << " s) (status: " << child_status << ")";
 
     pid = 0;
+    last_poll_done = last_poll;
     set_poll_state (false);
 
     d_refresh (); /* signal refresh */
@@ -331,6 +583,9 @@ namespace Astroid {
     unsigned long revnow = db.get_revision ();
     LOG (debug) << "poll: refreshing.. revision after poll: " << revnow;
 
+    /* the watcher does not need to refresh these again */
+    watched_revision = std::max (watched_revision, revnow);
+
     if (revnow > before_poll_revision) {
 
       ustring query = ustring::compose ("lastmod:%1..%2",
@@ -345,6 +600,8 @@ namespace Astroid {
 
       LOG (info) << "poll: " << total_threads << " threads changed, updating..";
 
+      std::set<ustring> changed;
+
       if (st == NOTMUCH_STATUS_SUCCESS && total_threads > 0) {
         notmuch_threads_t * threads;
         notmuch_thread_t  * thread;
@@ -358,13 +615,20 @@ namespace Astroid {
 
           const char * t = notmuch_thread_get_thread_id (thread);
 
-          ustring tt (t);
-          astroid->actions->emit_thread_updated (&db, tt);
+          changed.insert (ustring (t));
         }
       }
 
       notmuch_query_destroy (qry);
 
+      /* listeners handle the whole set at once */
+      if (!changed.empty ()) {
+        astroid->actions->emit_threads_changed (&db, changed, before_poll_revision, revnow);
+      }
+
+      /* add the addresses of the new messages */
+      Contacts::update ();
+
     }
   }
 
@@ -6,7 +6,14 @@
 # include <mutex>
 # include <condition_variable>
 # include <chrono>
+# include <vector>
+# include <deque>
+# include <set>
+# include <atomic>
+# include <boost/filesystem.hpp>
 # include <glibmm/iochannel.h>
+# include <giomm/file.h>
+# include <giomm/filemonitor.h>
 
 namespace Astroid {
   class Poll : public sigc::trackable {
@@ -43,6 +50,65 @@ namespace Astroid {
       void refresh_threads ();
       void refresh_full ();
 
+      /* watch the notmuch database for changes made by external programs
+       * (notmuch tag, notmuch new, ..) and refresh the changed threads
+       * without waiting for the next poll. the revisions written by our own
+       * actions are skipped, they have been emitted already.
+       *
+       * optionally watch the new directories of the maildir and run the
+       * poll command when mail is delivered to them. unlike the database
+       * watch this spawns the poll command: delivered mail is not in the
+       * database until it has been indexed (e.g. by notmuch new), so there
+       * is nothing to refresh from lastmod: before that. */
+      bool watch_database = false;
+      bool watch_maildir  = false;
+      int  watch_delay    = 500; // ms, events within this time are coalesced
+
+      unsigned long watched_revision = 0;
+
+      enum WatchKind {
+        WatchDatabase,
+        WatchFolder,    // a maildir folder: new folders are created here
+        WatchNew,       // the new directory of a maildir folder
+      };
+
+      std::vector<refptr<Gio::FileMonitor>> watchers;
+      std::set<std::string> watched_dirs;
+      sigc::connection c_watch_check;
+      sigc::connection c_maildir_check;
+
+      std::chrono::time_point<std::chrono::steady_clock> maildir_event;   // first event since the last check
+      std::chrono::time_point<std::chrono::steady_clock> last_poll_done;
+
+      void setup_watchers ();
+      void add_watcher (boost::filesystem::path, WatchKind);
+      void on_watch_event (
+          const refptr<Gio::File> &,
+          const refptr<Gio::File> &,
+          Gio::FileMonitorEvent);
+      bool on_watch_check ();
+
+      void on_maildir_event (
+          const refptr<Gio::File> &,
+          const refptr<Gio::File> &,
+          Gio::FileMonitorEvent,
+          bool new_dir);
+      bool on_maildir_check ();
+
+      /* the maildir is scanned for folders in the background, both on
+       * start up and when a folder is created */
+      std::thread scan_t;
+      std::mutex  scan_m;
+      bool        scanning = false;
+      std::atomic<bool> scan_stop;
+      std::deque<boost::filesystem::path> scan_queue;
+      std::vector<std::pair<boost::filesystem::path, WatchKind>> scanned;
+      Glib::Dispatcher d_scanned;
+
+      void scan_maildir (boost::filesystem::path);
+      void scan_worker ();
+      void on_scanned ();
+
       std::mutex  poll_cancel_m;
       std::condition_variable poll_cancel_cv;
 
@@ -21,7 +21,7 @@ namespace Astroid {
   struct RuntimePaths;
   class AccountManager;
   class Account;
-  //class Contacts;
+  class Contacts;
   class Poll;
   class PluginManager;
 
@@ -0,0 +1,415 @@
+# include <algorithm>
+# include <fstream>
+# include <cstring>
+# include <cstdio>
+# include <cmath>
+# include <sys/mman.h>
+# include <sys/stat.h>
+# include <fcntl.h>
+# include <unistd.h>
+
+# include "contact_index.hh"
+
+using namespace std;
+
+namespace Astroid {
+  namespace {
+    const char magic[] = "astroid-contacts";
+
+    /* reads from the mapped index file, reading past the end marks the
+     * file as bad */
+    struct Reader {
+      const char * p;
+      const char * end;
+      bool ok = true;
+
+      template<class T> T get () {
+        T v = T ();
+        if (ok && static_cast<size_t> (end - p) >= sizeof (T)) {
+          memcpy (&v, p, sizeof (T));
+          p += sizeof (T);
+        } else {
+          ok = false;
+        }
+        return v;
+      }
+
+      std::string str () {
+        uint32_t l = get<uint32_t> ();
+        if (!ok || static_cast<size_t> (end - p) < l) {
+          ok = false;
+          return "";
+        }
+
+        std::string s (p, l);
+        p += l;
+        return s;
+      }
+    };
+
+    struct Writer {
+      std::ostream & o;
+
+      template<class T> void put (T v) {
+        o.write (reinterpret_cast<const char *> (&v), sizeof (T));
+      }
+
+      void str (const std::string & s) {
+        put<uint32_t> (s.size ());
+        o.write (s.data (), s.size ());
+      }
+    };
+
+    /* split on any of the separators, skipping empty words */
+    std::vector<std::string> words (const std::string & s, const char * seps) {
+      std::vector<std::string> out;
+      size_t pos = 0;
+
+      while (pos < s.size ()) {
+        size_t e = s.find_first_of (seps, pos);
+        if (e == std::string::npos) e = s.size ();
+        if (e > pos) out.push_back (s.substr (pos, e - pos));
+        pos = e + 1;
+      }
+
+      return out;
+    }
+  }
+
+  ContactIndex::ContactIndex () {
+  }
+
+  std::string ContactIndex::fold (const std::string & s) {
+    std::string o = s;
+    for (auto & c : o) {
+      if (c >= 'A' && c <= 'Z') c = c - 'A' + 'a';
+    }
+    return o;
+  }
+
+  uint64_t ContactIndex::hash (const std::string & s) {
+    /* FNV-1a, the hashes are stored in the index file so they must not
+     * depend on the standard library */
+    uint64_t h = 14695981039346656037ULL;
+    for (unsigned char c : s) {
+      h ^= c;
+      h *= 1099511628211ULL;
+    }
+    return h;
+  }
+
+  void ContactIndex::clear () {
+    std::lock_guard<std::mutex> lk (m);
+
+    contacts.clear ();
+    by_email.clear ();
+    counted.clear ();
+    keys.clear ();
+    by_rank.clear ();
+  }
+
+  size_t ContactIndex::size () const {
+    std::lock_guard<std::mutex> lk (m);
+    return contacts.size ();
+  }
+
+  size_t ContactIndex::messages () const {
+    std::lock_guard<std::mutex> lk (m);
+    return counted.size ();
+  }
+
+  bool ContactIndex::count_message (const std::string & message_id) {
+    std::lock_guard<std::mutex> lk (m);
+    return counted.insert (hash (message_id)).second;
+  }
+
+  void ContactIndex::keys_of (const std::string & email, const std::string & name, std::vector<std::string> & out) {
+    std::string e = fold (email);
+    out.push_back (e);
+
+    /* the parts of the local part: john.doe@ -> doe */
+    std::string local = e.substr (0, e.find ('@'));
+    auto lw = words (local, "._-+");
+    for (size_t i = 1; i < lw.size (); i++) out.push_back (lw[i]);
+
+    if (!name.empty ()) {
+      std::string n = fold (name);
+      out.push_back (n);
+
+      auto nw = words (n, " \t,.\"'()");
+      for (size_t i = 1; i < nw.size (); i++) out.push_back (nw[i]);
+    }
+  }
+
+  void ContactIndex::add_keys (uint32_t id, const std::string & name) {
+    std::vector<std::string> ks;
+    keys_of (contacts[id].email, name, ks);
+
+    for (auto & k : ks) keys.insert (std::make_pair (k, id));
+  }
+
+  void ContactIndex::add (const std::string & email, const std::string & name, int64_t date) {
+    std::string fe = fold (email);
+    if (fe.empty ()) return;
+
+    std::lock_guard<std::mutex> lk (m);
+
+    auto it = by_email.find (fe);
+
+    if (it == by_email.end ()) {
+      uint32_t id = contacts.size ();
+      contacts.push_back ({ email, name, 1, date });
+      by_email[fe] = id;
+      by_rank.insert (std::make_pair (score (contacts[id]), id));
+      add_keys (id, name);
+
+    } else {
+      uint32_t id = it->second;
+      Contact & c = contacts[id];
+
+      by_rank.erase (std::make_pair (score (c), id));
+      c.count++;
+
+      /* keep the most recently used name */
+      bool newer = (date >= c.last);
+      if (newer) c.last = date;
+
+      by_rank.insert (std::make_pair (score (c), id));
+
+      if (!name.empty () && name != c.name && (newer || c.name.empty ())) {
+        c.name = name;
+        add_keys (id, name);
+      }
+    }
+  }
+
+  double ContactIndex::rank (const Contact & c, int64_t now) const {
+    double age = static_cast<double> (std::max<int64_t> (0, now - c.last));
+    return c.count * std::exp2 (- age / half_life);
+  }
+
+  double ContactIndex::score (const Contact & c) const {
+    /* log2 of the rank without the term for now, which is the same for
+     * every contact: the order by score is the order by rank at any time
+     * after the last message. */
+    return std::log2 (static_cast<double> (std::max<uint32_t> (1, c.count))) + c.last / half_life;
+  }
+
+  std::vector<ContactIndex::Contact> ContactIndex::lookup (const std::string & prefix, size_t max, int64_t now) const {
+    std::string p = fold (prefix);
+
+    std::lock_guard<std::mutex> lk (m);
+
+    std::vector<uint32_t> ids;
+    std::unordered_set<uint32_t> seen;
+    bool   more    = false;
+    size_t scanned = 0;
+
+    auto it = keys.lower_bound (std::make_pair (p, uint32_t (0)));
+    for (; it != keys.end () && it->first.compare (0, p.size (), p) == 0; ++it) {
+      if (lookup_scan > 0 && scanned++ >= lookup_scan) {
+        more = true;
+        break;
+      }
+
+      if (seen.insert (it->second).second) ids.push_back (it->second);
+    }
+
+    if (more) {
+      /* too many keys start with the prefix (e.g. a single letter), take
+       * the best ranked contacts that match instead. they are dense among
+       * all contacts, so only a few are checked before max are found. */
+      ids.clear ();
+
+      std::vector<std::string> ks;
+      for (auto r = by_rank.rbegin (); r != by_rank.rend () && (max == 0 || ids.size () < max); ++r) {
+        const Contact & c = contacts[r->second];
+
+        ks.clear ();
+        keys_of (c.email, c.name, ks);
+
+        if (std::any_of (ks.begin (), ks.end (), [&] (const std::string & k) { return k.compare (0, p.size (), p) == 0; })) {
+          ids.push_back (r->second);
+        }
+      }
+    }
+
+    std::vector<std::pair<double, uint32_t>> ranked;
+    ranked.reserve (ids.size ());
+    for (auto id : ids) ranked.push_back (std::make_pair (rank (contacts[id], now), id));
+
+    size_t n = (max > 0) ? std::min (max, ranked.size ()) : ranked.size ();
+    std::partial_sort (ranked.begin (), ranked.begin () + n, ranked.end (),
+        [] (const std::pair<double, uint32_t> & a, const std::pair<double, uint32_t> & b) {
+          return a.first > b.first || (a.first == b.first && a.second < b.second);
+        });
+
+    std::vector<Contact> out;
+    for (size_t i = 0; i < n; i++) out.push_back (contacts[ranked[i].second]);
+
+    return out;
+  }
+
+  std::vector<ContactIndex::Contact> ContactIndex::fuzzy (const std::string & key, size_t max, int64_t now) const {
+    std::string k = fold (key);
+
+    std::lock_guard<std::mutex> lk (m);
+
+    std::vector<std::pair<double, uint32_t>> ranked;
+
+    size_t scanned = 0;
+    for (auto r = by_rank.rbegin (); r != by_rank.rend (); ++r) {
+      if (fuzzy_scan > 0 && scanned++ >= fuzzy_scan) break;
+
+      uint32_t id = r->second;
+      const Contact & c = contacts[id];
+
+      /* leftmost match of the characters in order in 'name email', the
+       * score drops with the number of characters skipped in between. the
+       * characters are folded on the fly to avoid copying every contact. */
+      size_t len = c.name.size () + 1 + c.email.size ();
+      auto at = [&] (size_t i) -> char {
+        char ch = (i < c.name.size ()) ? c.name[i] : (i == c.name.size () ? ' ' : c.email[i - c.name.size () - 1]);
+        return (ch >= 'A' && ch <= 'Z') ? (ch - 'A' + 'a') : ch;
+      };
+
+      size_t first = std::string::npos;
+      size_t pos   = 0;
+      bool   found = true;
+
+      for (char ch : k) {
+        while (pos < len && at (pos) != ch) pos++;
+
+        if (pos == len) {
+          found = false;
+          break;
+        }
+
+        if (first == std::string::npos) first = pos;
+        pos++;
+      }
+
+      if (!found) continue;
+
+      size_t gaps = k.empty () ? 0 : (pos - first - k.size ());
+      ranked.push_back (std::make_pair ((1.0 + rank (c, now)) / (1.0 + gaps), id));
+    }
+
+    size_t n = (max > 0) ? std::min (max, ranked.size ()) : ranked.size ();
+    std::partial_sort (ranked.begin (), ranked.begin () + n, ranked.end (),
+        [] (const std::pair<double, uint32_t> & a, const std::pair<double, uint32_t> & b) {
+          return a.first > b.first || (a.first == b.first && a.second < b.second);
+        });
+
+    std::vector<Contact> out;
+    for (size_t i = 0; i < n; i++) out.push_back (contacts[ranked[i].second]);
+
+    return out;
+  }
+
+  bool ContactIndex::save (const std::string & path, const std::string & uuid, uint64_t revision) const {
+    /* write to a temporary file and move it in place, so that a crash does
+     * not leave a partial index */
+    std::string tmp = path + ".tmp";
+
+    std::ofstream f (tmp.c_str (), std::ios::binary | std::ios::trunc);
+    Writer w { f };
+
+    {
+      std::lock_guard<std::mutex> lk (m);
+
+      w.str (magic);
+      w.put<uint32_t> (file_version);
+      w.str (uuid);
+      w.put<uint64_t> (revision);
+
+      w.put<uint32_t> (contacts.size ());
+      for (auto & c : contacts) {
+        w.str (c.email);
+        w.str (c.name);
+        w.put<uint32_t> (c.count);
+        w.put<int64_t> (c.last);
+      }
+
+      std::vector<uint64_t> hashes (counted.begin (), counted.end ());
+      std::sort (hashes.begin (), hashes.end ());
+
+      w.put<uint32_t> (hashes.size ());
+      f.write (reinterpret_cast<const char *> (hashes.data ()), hashes.size () * sizeof (uint64_t));
+    }
+
+    f.close ();
+
+    if (!f) {
+      std::remove (tmp.c_str ());
+      return false;
+    }
+
+    return std::rename (tmp.c_str (), path.c_str ()) == 0;
+  }
+
+  bool ContactIndex::load (const std::string & path, std::string & uuid, uint64_t & revision) {
+    int fd = open (path.c_str (), O_RDONLY);
+    if (fd < 0) return false;
+
+    struct stat st;
+    if (fstat (fd, &st) != 0 || st.st_size == 0) {
+      close (fd);
+      return false;
+    }
+
+    void * map = mmap (NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close (fd);
+
+    if (map == MAP_FAILED) return false;
+
+    Reader r { static_cast<const char *> (map), static_cast<const char *> (map) + st.st_size };
+
+    std::vector<Contact> lcontacts;
+    std::unordered_set<uint64_t> lcounted;
+
+    if (r.str () != magic || r.get<uint32_t> () != file_version) {
+      r.ok = false;
+    }
+
+    if (r.ok) {
+      uuid     = r.str ();
+      revision = r.get<uint64_t> ();
+
+      uint32_t n = r.get<uint32_t> ();
+      for (uint32_t i = 0; r.ok && i < n; i++) {
+        Contact c;
+        c.email = r.str ();
+        c.name  = r.str ();
+        c.count = r.get<uint32_t> ();
+        c.last  = r.get<int64_t> ();
+        lcontacts.push_back (std::move (c));
+      }
+
+      uint32_t nh = r.get<uint32_t> ();
+      lcounted.reserve (nh);
+      for (uint32_t i = 0; r.ok && i < nh; i++) lcounted.insert (r.get<uint64_t> ());
+    }
+
+    munmap (map, st.st_size);
+
+    if (!r.ok) return false;
+
+    std::lock_guard<std::mutex> lk (m);
+
+    contacts.swap (lcontacts);
+    counted.swap (lcounted);
+    by_email.clear ();
+    keys.clear ();
+    by_rank.clear ();
+
+    for (uint32_t id = 0; id < contacts.size (); id++) {
+      by_email[fold (contacts[id].email)] = id;
+      by_rank.insert (std::make_pair (score (contacts[id]), id));
+      add_keys (id, contacts[id].name);
+    }
+
+    return true;
+  }
+}
+
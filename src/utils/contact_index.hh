@@ -0,0 +1,93 @@
+# pragma once
+
+# include <string>
+# include <vector>
+# include <mutex>
+# include <unordered_map>
+# include <unordered_set>
+# include <set>
+# include <cstdint>
+# include <cstddef>
+
+namespace Astroid {
+  /* an index of the addresses seen in messages, for recipient completion.
+   *
+   * every contact is counted once per message it appears in, and the date
+   * of the most recent message is kept. the ids of the counted messages are
+   * kept as 64 bit hashes, so that a message that is seen again (e.g. when
+   * catching up with the changed messages) is not counted twice.
+   *
+   * contacts are ranked by how often and how recently they have been seen:
+   * the count is halved for every half_life seconds since the last message.
+   *
+   * the index is saved as one flat file, which is mapped on load and copied
+   * into the in-memory containers (it is not used in place). lookups
+   * and updates may come from different threads. */
+  class ContactIndex {
+    public:
+      struct Contact {
+        std::string email;
+        std::string name;
+        uint32_t    count = 0;
+        int64_t     last  = 0;  // date of the most recent message
+      };
+
+      ContactIndex ();
+
+      void   clear ();
+      size_t size () const;     // number of contacts
+      size_t messages () const; // number of counted messages
+
+      /* returns false if the message has been counted already, otherwise it
+       * is marked as counted and its addresses should be added. */
+      bool   count_message (const std::string & message_id);
+
+      void   add (const std::string & email, const std::string & name, int64_t date);
+
+      /* contacts where the email, the name or a word in the name starts
+       * with prefix, best ranked first. at most lookup_scan matching keys
+       * are read (0: all), beyond that the best ranked contacts are
+       * checked for the prefix until max are found. */
+      std::vector<Contact> lookup (const std::string & prefix, size_t max, int64_t now) const;
+
+      /* contacts where the name or email contains the characters of key in
+       * order, best matched and ranked first. only the fuzzy_scan best
+       * ranked contacts are considered (0: all). */
+      std::vector<Contact> fuzzy (const std::string & key, size_t max, int64_t now) const;
+
+      /* the file starts with the given stamp (e.g. the database uuid and
+       * revision the index is up to date with) */
+      bool save (const std::string & path, const std::string & uuid, uint64_t revision) const;
+      bool load (const std::string & path, std::string & uuid, uint64_t & revision);
+
+      double half_life = 180 * 24 * 3600; // set before adding contacts
+      size_t lookup_scan = 2000;
+      size_t fuzzy_scan  = 10000;
+
+      /* ascii case folding, names are matched case sensitively beyond that */
+      static std::string fold (const std::string &);
+
+    private:
+      mutable std::mutex m;
+
+      std::vector<Contact> contacts;
+      std::unordered_map<std::string, uint32_t> by_email; // folded email
+      std::unordered_set<uint64_t> counted;
+
+      /* folded email, name and name words pointing to their contact, kept
+       * ordered as they are added so that lookups do not sort */
+      std::set<std::pair<std::string, uint32_t>> keys;
+
+      /* contacts ordered by rank, see score () */
+      std::set<std::pair<double, uint32_t>> by_rank;
+
+      void   add_keys (uint32_t, const std::string & name);
+      static void keys_of (const std::string & email, const std::string & name, std::vector<std::string> &);
+      double rank (const Contact &, int64_t now) const;
+      double score (const Contact &) const;
+
+      static uint64_t hash (const std::string &);
+      static const uint32_t file_version = 1;
+  };
+}
+
@@ -1,4 +1,5 @@
 # include <iostream>
+# include <algorithm>
 
 # include <boost/property_tree/ptree.hpp>
 # include <glibmm/datetime.h>
@@ -60,14 +61,38 @@ namespace Astroid {
 
   Date::ClockFormat Date::clock_format;
 
+  std::mutex Date::cache_m;
+  std::unordered_map<uint64_t, ustring> Date::cache;
+
   ustring Date::pretty_print (time_t t) {
+    time_t valid_until;
+    return pretty_print (t, time (NULL), valid_until);
+  }
+
+  time_t Date::next_midnight (time_t now) {
+    struct tm m = *localtime (&now);
+
+    m.tm_hour  = 0;
+    m.tm_min   = 0;
+    m.tm_sec   = 0;
+    m.tm_mday += 1;
+    m.tm_isdst = -1;
+
+    return mktime (&m);
+  }
+
+  ustring Date::pretty_print (time_t t, time_t now, time_t & valid_until) {
     struct tm * temp_t = localtime (&t);
     struct tm local_time = *temp_t;
 
-    time_t now  = time (NULL);
+    struct tm now_time = *localtime (&now);
+
     time_t diff = now - t;
 
-    CoarseDate cd = coarse_date (t);
+    CoarseDate cd = coarse_date (local_time, now_time, diff);
+
+    /* all categories change at the latest when the day changes */
+    valid_until = next_midnight (now);
 
     ustring fmt;
 	if (clock_format == ClockFormat::YEAR) {
@@ -84,12 +109,17 @@ namespace Astroid {
 	else {
 		switch (cd) {
 		case CoarseDate::NOW:
+			valid_until = std::min (valid_until, t + 60);
 			return "Now";
 
 		case CoarseDate::MINUTES:
+			valid_until = std::min (valid_until, t + (diff / 60 + 1) * 60);
 			return ustring::compose("%1m ago", (unsigned long) (diff / 60));
 
 		case CoarseDate::HOURS:
+			valid_until = std::min (valid_until, std::min (
+						t + (diff / (60 * 60) + 1) * (60 * 60),
+						t + 12 * 60 * 60));
 			return ustring::compose("%1h ago", (unsigned long) (diff / (60 * 60)));
 
 		case CoarseDate::TODAY:
@@ -117,6 +147,20 @@ namespace Astroid {
 		}
 	}
 
+    if (cd == CoarseDate::FUTURE) {
+      valid_until = std::min (valid_until, t);
+    }
+
+    /* the formatted string only depends on the category and the minute of
+     * the date */
+    uint64_t key = (static_cast<uint64_t> (t / 60) << 4) | static_cast<uint64_t> (cd);
+
+    {
+      std::lock_guard<std::mutex> lk (cache_m);
+      auto f = cache.find (key);
+      if (f != cache.end ()) return f->second;
+    }
+
     Glib::DateTime dt = Glib::DateTime::create_local (
         local_time.tm_year + 1900,
         local_time.tm_mon + 1,
@@ -125,7 +169,13 @@ namespace Astroid {
         local_time.tm_min,
         local_time.tm_sec);
 
-    return dt.format (fmt);
+    ustring r = dt.format (fmt);
+
+    std::lock_guard<std::mutex> lk (cache_m);
+    if (cache.size () > max_cached) cache.clear ();
+    cache[key] = r;
+
+    return r;
   }
 
   ustring Date::pretty_print_verbose (time_t t, bool include_short) {
@@ -1,5 +1,9 @@
 # pragma once
 
+# include <mutex>
+# include <unordered_map>
+# include <cstdint>
+
 # include "astroid.hh"
 
 namespace Astroid {
@@ -44,10 +48,23 @@ namespace Astroid {
       static CoarseDate coarse_date (struct tm, struct tm, time_t );
       static CoarseDate coarse_date (time_t t);
       static ustring pretty_print (time_t );
+
+      /* pretty print relative to now (computed once by the caller for many
+       * dates), valid_until is set to the time when the string changes
+       * next. */
+      static ustring pretty_print (time_t, time_t now, time_t & valid_until);
       static ustring pretty_print_verbose (time_t, bool = false);
 
       static ustring asctime (time_t t);
 
       static void init ();
+
+    private:
+      /* formatted strings by coarse date and minute */
+      static std::mutex cache_m;
+      static std::unordered_map<uint64_t, ustring> cache;
+      static const size_t max_cached = 10000;
+
+      static time_t next_midnight (time_t);
   };
 }
@@ -0,0 +1,106 @@
+# include <algorithm>
+
+# include "prefix_trie.hh"
+
+using namespace std;
+
+namespace Astroid {
+  PrefixTrie::PrefixTrie () {
+    clear ();
+  }
+
+  void PrefixTrie::clear () {
+    nodes.clear ();
+    values.clear ();
+
+    nodes.emplace_back (); // root
+  }
+
+  size_t PrefixTrie::size () const {
+    return values.size ();
+  }
+
+  bool PrefixTrie::insert (const std::string & key) {
+    return insert (key, key);
+  }
+
+  bool PrefixTrie::insert (const std::string & key, const std::string & value) {
+    uint32_t n = 0;
+
+    for (unsigned char c : key) {
+      auto & ch = nodes[n].children;
+      auto it = std::lower_bound (ch.begin (), ch.end (), c,
+          [] (const std::pair<unsigned char, uint32_t> & a, unsigned char b) { return a.first < b; });
+
+      if (it != ch.end () && it->first == c) {
+        n = it->second;
+      } else {
+        /* the new node is appended after the children are updated, since
+         * growing the node list invalidates the reference */
+        uint32_t nn = nodes.size ();
+        ch.insert (it, std::make_pair (c, nn));
+        nodes.emplace_back ();
+        n = nn;
+      }
+    }
+
+    for (uint32_t v : nodes[n].values) {
+      if (values[v] == value) return false;
+    }
+
+    nodes[n].values.push_back (values.size ());
+    values.push_back (value);
+
+    return true;
+  }
+
+  long PrefixTrie::find (const std::string & key) const {
+    uint32_t n = 0;
+
+    for (unsigned char c : key) {
+      auto & ch = nodes[n].children;
+      auto it = std::lower_bound (ch.begin (), ch.end (), c,
+          [] (const std::pair<unsigned char, uint32_t> & a, unsigned char b) { return a.first < b; });
+
+      if (it == ch.end () || it->first != c) return -1;
+
+      n = it->second;
+    }
+
+    return n;
+  }
+
+  bool PrefixTrie::contains (const std::string & key) const {
+    long n = find (key);
+    return (n >= 0 && !nodes[n].values.empty ());
+  }
+
+  std::vector<std::string> PrefixTrie::complete (const std::string & prefix, size_t max) const {
+    std::vector<std::string> out;
+
+    long start = find (prefix);
+    if (start < 0) return out;
+
+    /* pre-order walk: the values of a node come before those of its
+     * children, which gives key order */
+    std::vector<uint32_t> stack = { static_cast<uint32_t> (start) };
+
+    while (!stack.empty ()) {
+      uint32_t n = stack.back ();
+      stack.pop_back ();
+
+      for (uint32_t v : nodes[n].values) {
+        out.push_back (values[v]);
+        if (max > 0 && out.size () >= max) return out;
+      }
+
+      auto & ch = nodes[n].children;
+      for (auto it = ch.rbegin (); it != ch.rend (); ++it) {
+        stack.push_back (it->second);
+      }
+    }
+
+    return out;
+  }
+}
+
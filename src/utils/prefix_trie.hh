@@ -0,0 +1,49 @@
+# pragma once
+
+# include <string>
+# include <vector>
+# include <cstdint>
+# include <cstddef>
+
+namespace Astroid {
+  /* a prefix index for completion, e.g. of tags or of past queries.
+   *
+   * every entry has a key (usually case-folded by the caller) and a value,
+   * which is what is returned on completion. several values may share a key,
+   * like 'Inbox' and 'inbox'. entries can only be added, the index is
+   * extended in place as new tags or queries show up.
+   *
+   * completion walks down to the node of the prefix and collects the values
+   * below it in key order, so the cost depends on the length of the prefix
+   * and the number of values returned - not on the size of the index. */
+  class PrefixTrie {
+    public:
+      PrefixTrie ();
+
+      void   clear ();
+
+      /* returns false if the entry was already present */
+      bool   insert (const std::string & key, const std::string & value);
+      bool   insert (const std::string & key);
+
+      bool   contains (const std::string & key) const;
+      size_t size () const;  // number of values
+
+      /* values with keys starting with prefix in key order, at most max
+       * (0 for all) */
+      std::vector<std::string> complete (const std::string & prefix, size_t max = 0) const;
+
+    private:
+      struct Node {
+        std::vector<std::pair<unsigned char, uint32_t>> children; // sorted by label
+        std::vector<uint32_t> values;
+      };
+
+      std::vector<Node>        nodes;
+      std::vector<std::string> values;
+
+      /* node index of key, or -1 */
+      long find (const std::string & key) const;
+  };
+}
+
@@ -0,0 +1,201 @@
+# include <sstream>
+# include <iomanip>
+
+# include "astroid.hh"
+# include "rw_lock.hh"
+
+using namespace std;
+
+namespace Astroid {
+  const std::vector<double> RwLock::bucket_bounds = { 1, 10, 100, 1000, 10000 };
+
+  void RwLock::Histogram::add (double ms) {
+    if (buckets.empty ()) buckets.resize (bucket_bounds.size () + 1, 0);
+
+    unsigned int i = 0;
+    while (i < bucket_bounds.size () && ms >= bucket_bounds[i]) i++;
+    buckets[i]++;
+
+    count++;
+    total += ms;
+    if (ms > max) max = ms;
+  }
+
+  RwLock::RwLock (std::string _name) : name (_name) {
+  }
+
+  bool RwLock::thread_holds_read () {
+    auto tid = this_thread::get_id ();
+    for (auto &h : holders) {
+      if (!h.second.write && h.second.thread == tid) return true;
+    }
+    return false;
+  }
+
+  RwLock::ticket RwLock::lock_read (std::string caller) {
+    std::unique_lock<std::mutex> lk (m);
+
+    auto start = chrono::steady_clock::now ();
+    ticket t = next_ticket++;
+    waiters[t] = { caller, false, this_thread::get_id (), start };
+
+    /* a thread that already holds a read lock must not queue up behind a
+     * writer that is waiting for it */
+    bool reentrant = thread_holds_read ();
+
+    while (!cv.wait_for (lk, warn_after.load (), [&] {
+          return !active_writer && (reentrant || waiting_writers == 0);
+          }))
+    {
+      LOG (warn) << name << ": " << caller << " has waited " <<
+        chrono::duration_cast<chrono::milliseconds> (chrono::steady_clock::now () - start).count () <<
+        " ms for read lock:\n" << dump_locked ();
+    }
+
+    active_readers++;
+    return add_holder (t, start);
+  }
+
+  RwLock::ticket RwLock::lock_write (std::string caller) {
+    std::unique_lock<std::mutex> lk (m);
+
+    auto start = chrono::steady_clock::now ();
+    ticket t = next_ticket++;
+    waiters[t] = { caller, true, this_thread::get_id (), start };
+
+    if (thread_holds_read ()) {
+      LOG (error) << name << ": " << caller << " is waiting for write lock while holding a read lock in the same thread, this will deadlock.";
+    }
+
+    ticket turn = next_writer++;
+    waiting_writers++;
+
+    while (!cv.wait_for (lk, warn_after.load (), [&] {
+          return !active_writer && active_readers == 0 && serve_writer == turn;
+          }))
+    {
+      LOG (warn) << name << ": " << caller << " has waited " <<
+        chrono::duration_cast<chrono::milliseconds> (chrono::steady_clock::now () - start).count () <<
+        " ms for write lock:\n" << dump_locked ();
+    }
+
+    waiting_writers--;
+    serve_writer++;
+    active_writer = true;
+
+    return add_holder (t, start);
+  }
+
+  RwLock::ticket RwLock::add_holder (ticket t,
+      std::chrono::time_point<std::chrono::steady_clock> start)
+  {
+    /* must be called with m locked */
+    Holder h = waiters[t];
+    waiters.erase (t);
+
+    h.since = chrono::steady_clock::now ();
+    holders[t] = h;
+
+    double waited = chrono::duration<double, std::milli> (h.since - start).count ();
+    histograms[h.caller + (h.write ? " (rw)" : " (ro)")].add (waited);
+
+    LOG (debug) << name << ": " << (h.write ? "write" : "read") << " lock acquired by: " << h.caller << " after " << waited << " ms (readers: " << active_readers << ", waiting writers: " << waiting_writers << ")";
+
+    return t;
+  }
+
+  void RwLock::unlock (ticket t) {
+    {
+      std::lock_guard<std::mutex> lk (m);
+
+      auto h = holders.find (t);
+      if (h == holders.end ()) {
+        LOG (error) << name << ": unlock of unknown ticket: " << t;
+        return;
+      }
+
+      if (h->second.write) {
+        active_writer = false;
+      } else {
+        active_readers--;
+      }
+
+      LOG (debug) << name << ": " << (h->second.write ? "write" : "read") << " lock released by: " << h->second.caller;
+      holders.erase (h);
+    }
+
+    cv.notify_all ();
+  }
+
+  int RwLock::readers () {
+    std::lock_guard<std::mutex> lk (m);
+    return active_readers;
+  }
+
+  bool RwLock::writer () {
+    std::lock_guard<std::mutex> lk (m);
+    return active_writer;
+  }
+
+  std::string RwLock::dump () {
+    std::lock_guard<std::mutex> lk (m);
+    return dump_locked ();
+  }
+
+  std::string RwLock::dump_locked () {
+    auto now = chrono::steady_clock::now ();
+    std::ostringstream s;
+
+    s << name << ": readers: " << active_readers
+      << ", writer: " << (active_writer ? "yes" : "no")
+      << ", waiting writers: " << waiting_writers << "\n";
+
+    for (auto &h : holders) {
+      s << "  holder " << h.first << ": " << (h.second.write ? "rw" : "ro")
+        << ", " << h.second.caller
+        << ", thread: " << h.second.thread
+        << ", held for: " << chrono::duration_cast<chrono::milliseconds> (now - h.second.since).count () << " ms\n";
+    }
+
+    for (auto &h : waiters) {
+      s << "  waiter " << h.first << ": " << (h.second.write ? "rw" : "ro")
+        << ", " << h.second.caller
+        << ", thread: " << h.second.thread
+        << ", waiting for: " << chrono::duration_cast<chrono::milliseconds> (now - h.second.since).count () << " ms\n";
+    }
+
+    return s.str ();
+  }
+
+  std::map<std::string, RwLock::Histogram> RwLock::stats () {
+    std::lock_guard<std::mutex> lk (m);
+    return histograms;
+  }
+
+  std::string RwLock::dump_stats () {
+    auto hs = stats ();
+    std::ostringstream s;
+
+    s << name << ": wait times (ms):\n";
+    s << "  " << left << setw (40) << "caller" << right;
+    double lo = 0;
+    for (double b : bucket_bounds) {
+      s << setw (10) << (to_string ((int) lo) + "-" + to_string ((int) b));
+      lo = b;
+    }
+    s << setw (10) << (">" + to_string ((int) lo))
+      << setw (10) << "max" << setw (10) << "mean" << "\n";
+
+    for (auto &h : hs) {
+      s << "  " << left << setw (40) << h.first << right;
+      for (auto b : h.second.buckets) s << setw (10) << b;
+      s << fixed << setprecision (1)
+        << setw (10) << h.second.max
+        << setw (10) << (h.second.count > 0 ? h.second.total / h.second.count : 0)
+        << "\n";
+    }
+
+    return s.str ();
+  }
+}
+
@@ -0,0 +1,94 @@
+# pragma once
+
+# include <string>
+# include <vector>
+# include <map>
+# include <mutex>
+# include <condition_variable>
+# include <chrono>
+# include <atomic>
+# include <thread>
+
+namespace Astroid {
+  /* a reader/writer lock with writer preference and wait instrumentation.
+   *
+   * any number of readers may hold the lock, or exactly one writer. new
+   * readers queue up behind a waiting writer so that a steady stream of
+   * readers can not starve it, writers are served in the order they
+   * arrived. a thread already holding a read lock may take another one
+   * regardless of waiting writers, otherwise it would deadlock on itself.
+   *
+   * every acquisition returns a ticket which must be passed on release, it
+   * is used to keep track of the current holders. the time spent waiting
+   * is collected in a histogram for each caller. */
+  class RwLock {
+    public:
+      typedef unsigned long ticket;
+
+      RwLock (std::string name);
+
+      ticket lock_read (std::string caller);
+      ticket lock_write (std::string caller);
+      void   unlock (ticket);
+
+      int  readers ();
+      bool writer ();
+
+      /* log the current holders if a wait exceeds this, may be changed
+       * while the lock is used */
+      std::atomic<std::chrono::milliseconds> warn_after { std::chrono::milliseconds (5000) };
+
+      /* wait times are counted in buckets with these upper bounds (ms),
+       * the last bucket takes the rest. */
+      static const std::vector<double> bucket_bounds;
+
+      struct Histogram {
+        std::vector<unsigned long> buckets;
+        unsigned long count = 0;
+        double total        = 0; // ms
+        double max          = 0; // ms
+
+        void add (double ms);
+      };
+
+      /* the current holders and waiters */
+      std::string dump ();
+
+      /* the wait time histograms per caller */
+      std::string dump_stats ();
+      std::map<std::string, Histogram> stats ();
+
+    private:
+      struct Holder {
+        std::string     caller;
+        bool            write;
+        std::thread::id thread;
+        std::chrono::time_point<std::chrono::steady_clock> since;
+      };
+
+      std::string name;
+
+      std::mutex m;
+      std::condition_variable cv;
+
+      int  active_readers = 0;
+      bool active_writer  = false;
+
+      /* writers are served in order of arrival */
+      ticket next_writer   = 0;
+      ticket serve_writer  = 0;
+      int    waiting_writers = 0;
+
+      ticket next_ticket = 1;
+      std::map<ticket, Holder> holders;
+      std::map<ticket, Holder> waiters;
+
+      std::map<std::string, Histogram> histograms;
+
+      bool thread_holds_read ();
+      ticket add_holder (ticket,
+          std::chrono::time_point<std::chrono::steady_clock> start);
+      std::string dump_locked ();
+  };
+}
+
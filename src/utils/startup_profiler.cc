@@ -0,0 +1,167 @@
+# include <iostream>
+# include <iomanip>
+# include <algorithm>
+
+# include "astroid.hh"
+# include "startup_profiler.hh"
+
+using namespace std;
+
+namespace Astroid {
+  bool StartupProfiler::print    = false;
+  std::atomic<bool> StartupProfiler::reported (false);
+  chrono::time_point<chrono::steady_clock> StartupProfiler::t0 = chrono::steady_clock::now ();
+  std::thread::id StartupProfiler::main_thread;
+
+  std::mutex StartupProfiler::records_m;
+  std::vector<StartupProfiler::Record> StartupProfiler::records;
+
+  std::mutex StartupProfiler::pending_m;
+  std::map<std::string, std::shared_future<bool>> StartupProfiler::pending;
+
+  void StartupProfiler::init (bool _print) {
+    print       = _print;
+    t0          = chrono::steady_clock::now ();
+    main_thread = this_thread::get_id ();
+  }
+
+  StartupProfiler::Phase::Phase (std::string _name) : name (_name) {
+    start = chrono::steady_clock::now ();
+  }
+
+  StartupProfiler::Phase::~Phase () {
+    StartupProfiler::record (name, start, chrono::steady_clock::now ());
+  }
+
+  void StartupProfiler::record (
+      std::string name,
+      chrono::time_point<chrono::steady_clock> start,
+      chrono::time_point<chrono::steady_clock> end)
+  {
+    Record r;
+    r.name     = name;
+    r.start    = chrono::duration<double, std::milli> (start - t0).count ();
+    r.duration = chrono::duration<double, std::milli> (end - start).count ();
+    r.worker   = (this_thread::get_id () != main_thread);
+
+    LOG (debug) << "startup: " << name << ": " << r.duration << " ms" << (r.worker ? " (worker)" : "");
+
+    std::lock_guard<std::mutex> lk (records_m);
+    records.push_back (r);
+
+    /* finished after the report: print it on its own */
+    if (print && reported) print_record (r);
+  }
+
+  void StartupProfiler::print_record (const Record & r) {
+    cout << "  " << left << setw (32) << r.name
+         << right << fixed << setprecision (1)
+         << setw (12) << r.start
+         << setw (12) << r.duration
+         << "  " << (r.worker ? "worker" : "main") << endl;
+  }
+
+  void StartupProfiler::launch (std::string name, std::function<void()> func) {
+    LOG (debug) << "startup: launching: " << name;
+
+    std::shared_future<bool> f = std::async (std::launch::async,
+        [name, func] () {
+          Phase p (name);
+
+          try {
+            func ();
+          } catch (std::exception &ex) {
+            /* wait () returns false, so that the consumer of the phase redoes
+             * the work and reports the error where it is handled today */
+            LOG (error) << "startup: " << name << " failed: " << ex.what ();
+            return false;
+          }
+
+          return true;
+        }).share ();
+
+    std::lock_guard<std::mutex> lk (pending_m);
+    pending[name] = f;
+  }
+
+  bool StartupProfiler::wait (std::string name) {
+    std::shared_future<bool> f;
+
+    {
+      std::lock_guard<std::mutex> lk (pending_m);
+      auto fnd = pending.find (name);
+      if (fnd == pending.end ()) return false;
+
+      f = fnd->second;
+      pending.erase (fnd);
+    }
+
+    auto start = chrono::steady_clock::now ();
+    f.wait ();
+    auto end   = chrono::steady_clock::now ();
+
+    if ((end - start) > chrono::milliseconds (1)) {
+      record ("wait: " + name, start, end);
+    }
+
+    return f.get ();
+  }
+
+  void StartupProfiler::wait_all () {
+    std::map<std::string, std::shared_future<bool>> p;
+
+    {
+      std::lock_guard<std::mutex> lk (pending_m);
+      p.swap (pending);
+    }
+
+    for (auto &kv : p) kv.second.wait ();
+  }
+
+  void StartupProfiler::report () {
+    if (!print || reported) return;
+
+    /* do not block the GUI on background phases: only the finished ones are
+     * in records, the rest print themselves from record () */
+    std::vector<std::string> running;
+    {
+      std::lock_guard<std::mutex> lk (pending_m);
+      for (auto &kv : pending) {
+        if (kv.second.wait_for (chrono::seconds (0)) != future_status::ready) {
+          running.push_back (kv.first);
+        }
+      }
+    }
+
+    std::lock_guard<std::mutex> lk (records_m);
+    reported = true;
+
+    std::vector<Record> r = records;
+    std::sort (r.begin (), r.end (),
+        [] (const Record &a, const Record &b) { return a.start < b.start; });
+
+    double total = 0;
+    for (auto &rr : r) total = std::max (total, rr.start + rr.duration);
+
+    cout << "astroid: startup profile:" << endl;
+    cout << "  " << left << setw (32) << "phase"
+         << right << setw (12) << "start (ms)"
+         << setw (12) << "time (ms)"
+         << "  thread" << endl;
+
+    for (auto &rr : r) print_record (rr);
+
+    cout << "  " << left << setw (32) << "total" << right << setw (24) << total << endl;
+
+    for (auto &n : running) {
+      /* finished between the two checks: already printed above */
+      if (std::any_of (r.begin (), r.end (),
+            [&] (const Record &rr) { return rr.name == n; })) continue;
+
+      cout << "  " << left << setw (32) << n << right << setw (24) << "(still running)" << endl;
+    }
+
+    LOG (info) << "startup: first window shown after: " << total << " ms.";
+  }
+}
+
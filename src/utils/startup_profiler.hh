@@ -0,0 +1,76 @@
+# pragma once
+
+# include <string>
+# include <vector>
+# include <map>
+# include <mutex>
+# include <future>
+# include <chrono>
+# include <thread>
+# include <functional>
+# include <atomic>
+
+namespace Astroid {
+  /* times the phases of start up and runs independent phases
+   * concurrently on worker threads.
+   *
+   * phases are always timed (it is cheap), but only printed when
+   * --profile-startup is passed. */
+  class StartupProfiler {
+    public:
+      static void init (bool print);
+
+      /* times the enclosing scope as a phase on the calling thread */
+      class Phase {
+        public:
+          Phase (std::string name);
+          ~Phase ();
+
+        private:
+          std::string name;
+          std::chrono::time_point<std::chrono::steady_clock> start;
+      };
+
+      /* run an independent phase on a worker thread */
+      static void launch (std::string name, std::function<void()>);
+
+      /* block until a launched phase has completed. returns true if a phase
+       * with this name was pending and succeeded, subsequent calls return
+       * false so that the first consumer can use the prefetched result. if
+       * the phase failed false is returned, and the consumer should do the
+       * work itself. */
+      static bool wait (std::string name);
+      static void wait_all ();
+
+      /* print the collected phases (only if --profile-startup). this runs
+       * on the GUI thread and does not wait: launched phases that are still
+       * running are listed as such and print themselves when they finish. */
+      static void report ();
+
+    private:
+      struct Record {
+        std::string name;
+        double      start;    // ms since init
+        double      duration; // ms
+        bool        worker;
+      };
+
+      static void record (std::string name,
+          std::chrono::time_point<std::chrono::steady_clock> start,
+          std::chrono::time_point<std::chrono::steady_clock> end);
+
+      static void print_record (const Record &);
+
+      static bool print;
+      static std::atomic<bool> reported;
+      static std::chrono::time_point<std::chrono::steady_clock> t0;
+      static std::thread::id main_thread;
+
+      static std::mutex records_m;
+      static std::vector<Record> records;
+
+      static std::mutex pending_m;
+      static std::map<std::string, std::shared_future<bool>> pending; // true on success
+  };
+}
+
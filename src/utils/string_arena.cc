@@ -0,0 +1,115 @@
+# include <cstring>
+# include <algorithm>
+
+# include "string_arena.hh"
+
+namespace Astroid {
+  StringArena::StringArena (size_t _chunk_size) : chunk_size (_chunk_size) {
+  }
+
+  std::shared_ptr<StringArena> StringArena::global () {
+    static std::shared_ptr<StringArena> g = std::make_shared<StringArena> ();
+    return g;
+  }
+
+  const char * StringArena::copy (const std::string & s) {
+    /* must be called with m locked */
+    size_t len = s.size () + 1;
+
+    if (len > chunk_size) {
+      /* strings larger than a chunk get a chunk of their own, placed
+       * before the chunk that is being filled */
+      char * c = new char[len];
+      memcpy (c, s.c_str (), len);
+
+      chunks.emplace (chunks.end () - (chunks.empty () ? 0 : 1), c);
+      n_allocated += len;
+      n_used      += len;
+
+      return c;
+    }
+
+    if (chunks.empty () || (pos + len) > chunk_size) {
+      chunks.emplace_back (new char[chunk_size]);
+      n_allocated += chunk_size;
+      pos = 0;
+    }
+
+    char * c = chunks.back ().get () + pos;
+    memcpy (c, s.c_str (), len);
+
+    pos    += len;
+    n_used += len;
+
+    return c;
+  }
+
+  const char * StringArena::store (const std::string & s) {
+    std::lock_guard<std::mutex> lk (m);
+    return copy (s);
+  }
+
+  const char * StringArena::intern (const std::string & s) {
+    std::lock_guard<std::mutex> lk (m);
+
+    auto f = interned.find (s.c_str ());
+    if (f != interned.end ()) return *f;
+
+    const char * c = copy (s);
+    interned.insert (c);
+
+    return c;
+  }
+
+  std::pair<const char *, const char *> StringArena::intern_folded (const std::string & s, const Fold & fold) {
+    std::lock_guard<std::mutex> lk (m);
+
+    const char * c;
+    auto f = interned.find (s.c_str ());
+    if (f != interned.end ()) {
+      c = *f;
+
+      auto ff = folds.find (c);
+      if (ff != folds.end ()) return std::make_pair (c, ff->second);
+    } else {
+      c = copy (s);
+      interned.insert (c);
+    }
+
+    std::string fs = fold (s);
+    const char * fc = (fs == s) ? c : copy (fs);
+    folds[c] = fc;
+
+    return std::make_pair (c, fc);
+  }
+
+  size_t StringArena::bytes () const {
+    std::lock_guard<std::mutex> lk (m);
+    return n_allocated;
+  }
+
+  size_t StringArena::used () const {
+    std::lock_guard<std::mutex> lk (m);
+    return n_used;
+  }
+
+  size_t StringArena::strings () const {
+    std::lock_guard<std::mutex> lk (m);
+    return interned.size ();
+  }
+
+  size_t StringArena::hash::operator() (const char * s) const {
+    /* FNV-1a */
+    size_t h = 14695981039346656037ULL;
+    for (; *s; s++) {
+      h ^= static_cast<unsigned char> (*s);
+      h *= 1099511628211ULL;
+    }
+    return h;
+  }
+
+  bool StringArena::equal::operator() (const char * a, const char * b) const {
+    return strcmp (a, b) == 0;
+  }
+}
+
@@ -0,0 +1,72 @@
+# pragma once
+
+# include <string>
+# include <vector>
+# include <memory>
+# include <mutex>
+# include <cstddef>
+# include <unordered_set>
+# include <unordered_map>
+# include <functional>
+# include <utility>
+
+namespace Astroid {
+  /* an append-only store for many small strings, e.g. the author names of
+   * the threads of a query. strings are copied into large chunks and are
+   * never moved or freed until the arena is destroyed, so the returned
+   * pointers stay valid for its lifetime.
+   *
+   * interned strings are de-duplicated: the same name is only stored once
+   * however many threads refer to it. */
+  class StringArena {
+    public:
+      StringArena (size_t chunk_size = 64 * 1024);
+
+      /* copy, or return the existing copy of, a string */
+      const char * intern (const std::string &);
+
+      /* like intern (), and keeps a folded form (e.g. lower case) of the
+       * string with it. fold is only called the first time, after that the
+       * cached form is returned. returns the string and its folded form. */
+      typedef std::function<std::string (const std::string &)> Fold;
+      std::pair<const char *, const char *> intern_folded (const std::string &, const Fold &);
+
+      /* copy a string without looking for an existing copy */
+      const char * store (const std::string &);
+
+      size_t bytes () const;   // allocated
+      size_t used () const;    // used by strings
+      size_t strings () const; // number of interned strings
+
+      /* fallback arena for items that are not loaded as part of a query.
+       * like any arena it never frees, and it lives as long as astroid: it
+       * grows with every distinct string stored in it during a session. it
+       * should only get the few items that are not part of a query. */
+      static std::shared_ptr<StringArena> global ();
+
+    private:
+      mutable std::mutex m;
+
+      size_t chunk_size;
+      size_t pos  = 0;
+      size_t n_allocated = 0;
+      size_t n_used      = 0;
+      std::vector<std::unique_ptr<char[]>> chunks;
+
+      const char * copy (const std::string &);
+
+      struct hash {
+        size_t operator() (const char *) const;
+      };
+
+      struct equal {
+        bool operator() (const char *, const char *) const;
+      };
+
+      std::unordered_set<const char *, hash, equal> interned;
+
+      /* interned string -> its folded form */
+      std::unordered_map<const char *, const char *> folds;
+  };
+}
+
@@ -0,0 +1,54 @@
+# include "tag_set.hh"
+
+namespace Astroid {
+  void TagSet::set (unsigned int id) {
+    if (id / 64 >= bits.size ()) bits.resize (id / 64 + 1, 0);
+    bits[id / 64] |= (uint64_t (1) << (id % 64));
+  }
+
+  void TagSet::reset (unsigned int id) {
+    if (id / 64 < bits.size ()) {
+      bits[id / 64] &= ~(uint64_t (1) << (id % 64));
+    }
+  }
+
+  bool TagSet::test (unsigned int id) const {
+    if (id / 64 >= bits.size ()) return false;
+    return (bits[id / 64] >> (id % 64)) & 1;
+  }
+
+  void TagSet::clear () {
+    bits.clear ();
+    bits.shrink_to_fit ();
+  }
+
+  bool TagSet::empty () const {
+    for (auto w : bits) if (w != 0) return false;
+    return true;
+  }
+
+  size_t TagSet::count () const {
+    size_t n = 0;
+    for (auto w : bits) n += __builtin_popcountll (w);
+    return n;
+  }
+
+  size_t TagSet::bytes () const {
+    return bits.capacity () * sizeof (uint64_t);
+  }
+
+  std::vector<unsigned int> TagSet::ids () const {
+    std::vector<unsigned int> r;
+
+    for (size_t i = 0; i < bits.size (); i++) {
+      uint64_t w = bits[i];
+      while (w != 0) {
+        r.push_back (i * 64 + __builtin_ctzll (w));
+        w &= w - 1;
+      }
+    }
+
+    return r;
+  }
+}
+
@@ -0,0 +1,28 @@
+# pragma once
+
+# include <vector>
+# include <cstdint>
+# include <cstddef>
+
+namespace Astroid {
+  /* a set of interned tag ids (see Db::tag_id) stored as a bitset, the ids
+   * are small and dense so a handful of words covers all tags. */
+  class TagSet {
+    public:
+      void set   (unsigned int id);
+      void reset (unsigned int id);
+      bool test  (unsigned int id) const;
+      void clear ();
+
+      bool   empty () const;
+      size_t count () const;
+      size_t bytes () const;
+
+      /* the ids in the set, in increasing order */
+      std::vector<unsigned int> ids () const;
+
+    private:
+      std::vector<uint64_t> bits;
+  };
+}
+
@@ -0,0 +1,240 @@
+# include <algorithm>
+# include <thread>
+# include <future>
+# include <functional>
+# include <cstring>
+
+# ifdef __SSE2__
+# include <emmintrin.h>
+# endif
+
+# include "text_filter.hh"
+
+using namespace std;
+
+namespace Astroid {
+  TextFilter::TextFilter () {
+    max_workers = std::max (1u, std::thread::hardware_concurrency ());
+  }
+
+  void TextFilter::clear () {
+    corpus.clear ();
+    offsets.clear ();
+    bits.clear ();
+    last_keys.clear ();
+    n_matched  = 0;
+    has_result = false;
+  }
+
+  size_t TextFilter::add (const std::string & s) {
+    offsets.push_back (corpus.size ());
+    corpus.append (s);
+    corpus.push_back ('\0');
+
+    /* the previous result does not cover the new entry */
+    has_result = false;
+
+    return offsets.size () - 1;
+  }
+
+  size_t TextFilter::size () const {
+    return offsets.size ();
+  }
+
+  size_t TextFilter::bytes () const {
+    return corpus.size ();
+  }
+
+  size_t TextFilter::matched () const {
+    return n_matched;
+  }
+
+  bool TextFilter::visible (size_t e) const {
+    if (e >= offsets.size ()) return false;
+    return test (bits, e);
+  }
+
+  void TextFilter::set (std::vector<uint64_t> & b, size_t e) {
+    b[e / 64] |= (uint64_t (1) << (e % 64));
+  }
+
+  bool TextFilter::test (const std::vector<uint64_t> & b, size_t e) const {
+    return (b[e / 64] >> (e % 64)) & 1;
+  }
+
+  size_t TextFilter::entry_end (size_t e) const {
+    /* position of the terminating NUL */
+    return ((e + 1) < offsets.size () ? offsets[e + 1] : corpus.size ()) - 1;
+  }
+
+  const char * TextFilter::search (const char * h, size_t hlen,
+                                   const char * n, size_t nlen)
+  {
+    if (nlen == 0) return h;
+    if (nlen > hlen) return NULL;
+    if (nlen == 1) return static_cast<const char *> (memchr (h, n[0], hlen));
+
+    size_t i = 0;
+
+# ifdef __SSE2__
+    /* compare the first and last byte of the needle against 16 positions at
+     * the time, and only compare the full needle where both match. */
+    const __m128i first = _mm_set1_epi8 (n[0]);
+    const __m128i last  = _mm_set1_epi8 (n[nlen - 1]);
+
+    for (; i + nlen - 1 + 16 <= hlen; i += 16) {
+      const __m128i bf = _mm_loadu_si128 (reinterpret_cast<const __m128i *> (h + i));
+      const __m128i bl = _mm_loadu_si128 (reinterpret_cast<const __m128i *> (h + i + nlen - 1));
+
+      unsigned int mask = _mm_movemask_epi8 (
+          _mm_and_si128 (_mm_cmpeq_epi8 (first, bf), _mm_cmpeq_epi8 (last, bl)));
+
+      while (mask != 0) {
+        unsigned int bit = __builtin_ctz (mask);
+
+        if (memcmp (h + i + bit + 1, n + 1, nlen - 2) == 0) {
+          return h + i + bit;
+        }
+
+        mask &= mask - 1;
+      }
+    }
+# endif
+
+    /* the rest */
+    for (; i + nlen <= hlen; i++) {
+      const char * p = static_cast<const char *> (memchr (h + i, n[0], hlen - nlen - i + 1));
+      if (p == NULL) return NULL;
+
+      i = p - h;
+      if (memcmp (p + 1, n + 1, nlen - 1) == 0) return p;
+    }
+
+    return NULL;
+  }
+
+  bool TextFilter::entry_matches (size_t e, const std::vector<std::string> & keys, size_t first_key) const {
+    const char * h  = corpus.data () + offsets[e];
+    size_t hlen     = entry_end (e) - offsets[e];
+
+    for (size_t k = first_key; k < keys.size (); k++) {
+      if (search (h, hlen, keys[k].data (), keys[k].size ()) == NULL) return false;
+    }
+
+    return true;
+  }
+
+  void TextFilter::sweep (const std::string & key, size_t begin, size_t end, std::vector<uint64_t> & out) {
+    /* search the key across all entries in [begin, end) in one go, a match
+     * can not span entries since keys never contain NUL. */
+    if (begin >= end) return;
+
+    const char * base = corpus.data ();
+    size_t pos  = offsets[begin];
+    size_t stop = entry_end (end - 1) + 1;
+
+    while (pos < stop) {
+      const char * p = search (base + pos, stop - pos, key.data (), key.size ());
+      if (p == NULL) break;
+
+      size_t at = p - base;
+      size_t e  = std::upper_bound (offsets.begin () + begin, offsets.begin () + end, at) - offsets.begin () - 1;
+
+      set (out, e);
+
+      /* continue with the next entry */
+      pos = entry_end (e) + 1;
+    }
+  }
+
+  void TextFilter::narrow (const std::vector<std::string> & keys, size_t first_key,
+      size_t begin, size_t end, const std::vector<uint64_t> & in, std::vector<uint64_t> & out)
+  {
+    for (size_t w = begin / 64; w * 64 < end; w++) {
+      uint64_t word = in[w];
+
+      while (word != 0) {
+        size_t e = w * 64 + __builtin_ctzll (word);
+        word &= word - 1;
+
+        if (e < begin || e >= end) continue;
+
+        if (entry_matches (e, keys, first_key)) set (out, e);
+      }
+    }
+  }
+
+  bool TextFilter::refines (const std::vector<std::string> & keys) const {
+    /* every previous key is contained in a new key: the new result is a
+     * subset of the previous */
+    if (!has_result || last_keys.empty ()) return false;
+
+    return std::all_of (last_keys.begin (), last_keys.end (),
+        [&] (const std::string & o) {
+          return std::any_of (keys.begin (), keys.end (),
+              [&] (const std::string & k) { return k.find (o) != std::string::npos; });
+        });
+  }
+
+  size_t TextFilter::filter (const std::vector<std::string> & _keys) {
+    size_t n = offsets.size ();
+
+    /* search for the longest (most selective) key first */
+    std::vector<std::string> keys = _keys;
+    std::sort (keys.begin (), keys.end (),
+        [] (const std::string & a, const std::string & b) { return a.size () > b.size (); });
+
+    std::vector<uint64_t> out ((n + 63) / 64, 0);
+
+    if (keys.empty ()) {
+      for (size_t e = 0; e < n; e++) set (out, e);
+
+    } else {
+      bool narrowing = refines (keys);
+
+      /* split the entries in ranges on word boundaries, so that each worker
+       * writes to separate words of the bitmap. */
+      unsigned int workers = 1;
+      if (corpus.size () > parallel_threshold) {
+        workers = std::min<size_t> (max_workers, std::max<size_t> (1, (n + 63) / 64));
+      }
+
+      size_t chunk = ((n + workers - 1) / workers + 63) / 64 * 64;
+
+      std::function<void(size_t, size_t)> job;
+
+      if (narrowing) {
+        job = [&] (size_t b, size_t e) { narrow (keys, 0, b, e, bits, out); };
+      } else {
+        job = [&] (size_t b, size_t e) {
+          std::vector<uint64_t> first ((n + 63) / 64, 0);
+          sweep (keys[0], b, e, first);
+          if (keys.size () > 1) {
+            narrow (keys, 1, b, e, first, out);
+          } else {
+            for (size_t w = b / 64; w * 64 < e; w++) out[w] |= first[w];
+          }
+        };
+      }
+
+      std::vector<std::future<void>> fs;
+      for (size_t b = chunk; b < n; b += chunk) {
+        fs.push_back (std::async (std::launch::async, job, b, std::min (n, b + chunk)));
+      }
+
+      job (0, std::min (n, chunk));
+      for (auto &f : fs) f.wait ();
+    }
+
+    bits.swap (out);
+
+    n_matched = 0;
+    for (auto w : bits) n_matched += __builtin_popcountll (w);
+
+    last_keys  = keys;
+    has_result = true;
+
+    return n_matched;
+  }
+}
+
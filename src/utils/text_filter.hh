@@ -0,0 +1,69 @@
+# pragma once
+
+# include <string>
+# include <vector>
+# include <cstdint>
+# include <cstddef>
+
+namespace Astroid {
+  /* a substring filter over a packed corpus of (already case-folded) entries.
+   *
+   * the entries are stored back to back in one buffer separated by a NUL
+   * byte, so that the first key can be searched for across the whole corpus
+   * in one sweep rather than entry by entry. the sweep is split across
+   * worker threads for large corpora. the result is a visibility bitmap
+   * indexed by entry.
+   *
+   * if the new keys are a refinement of the previous keys (every previous key
+   * is contained in one of the new keys) the result can only shrink, and
+   * only the entries visible in the previous result are checked. */
+  class TextFilter {
+    public:
+      TextFilter ();
+
+      void   clear ();
+      size_t add (const std::string &);
+      size_t size () const;
+
+      /* all keys must match (AND). returns the number of matching entries. */
+      size_t filter (const std::vector<std::string> & keys);
+
+      bool   visible (size_t) const;
+      size_t matched () const;
+
+      /* corpus size in bytes */
+      size_t bytes () const;
+
+      /* use worker threads when the corpus is larger than this (bytes) */
+      size_t parallel_threshold = 1 << 20;
+      unsigned int max_workers;
+
+      /* find needle in haystack, SSE2 accelerated where available */
+      static const char * search (const char * haystack, size_t hlen,
+                                  const char * needle, size_t nlen);
+
+    private:
+      std::string         corpus;
+      std::vector<size_t> offsets; // start of each entry
+
+      std::vector<uint64_t> bits;
+      size_t n_matched = 0;
+
+      std::vector<std::string> last_keys;
+      bool has_result = false;
+
+      bool refines (const std::vector<std::string> & keys) const;
+
+      void set   (std::vector<uint64_t> &, size_t);
+      bool test  (const std::vector<uint64_t> &, size_t) const;
+
+      /* entry range [begin, end) */
+      void sweep  (const std::string & key, size_t begin, size_t end, std::vector<uint64_t> & out);
+      void narrow (const std::vector<std::string> & keys, size_t first_key,
+                   size_t begin, size_t end, const std::vector<uint64_t> & in, std::vector<uint64_t> & out);
+
+      bool entry_matches (size_t e, const std::vector<std::string> & keys, size_t first_key) const;
+      size_t entry_end (size_t e) const;
+  };
+}
+
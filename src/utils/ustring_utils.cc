@@ -81,6 +81,12 @@ namespace Astroid {
   }
 
   std::pair<bool, Glib::ustring> UstringUtils::data_to_ustring (unsigned int len, const char * data) {
+    /* valid UTF-8 (without nul bytes) is taken as it is */
+    if (g_utf8_validate (data, len, NULL)) {
+      std::string u (data, len);
+      return std::make_pair (true, Glib::ustring (u));
+    }
+
     std::string  u;
     bool success;
 
@@ -106,5 +112,34 @@ namespace Astroid {
 
     return data_to_ustring (len, in);
   }
+
+  std::pair<bool, Glib::ustring> UstringUtils::bytes_to_ustring (Glib::RefPtr<Glib::Bytes> &b) {
+    gsize        len  = 0;
+    const gchar * in  = (const gchar *) b->get_data (len);
+
+    return data_to_ustring (len, in);
+  }
+
+  std::pair<bool, Glib::ustring> UstringUtils::bytes_to_unix_ustring (Glib::RefPtr<Glib::Bytes> &b) {
+    gsize        len  = 0;
+    const gchar * in  = (const gchar *) b->get_data (len);
+
+    if (!g_utf8_validate (in, len, NULL)) {
+      auto r = data_to_ustring (len, in);
+      if (r.first) r.second = unixify (r.second);
+      return r;
+    }
+
+    /* read straight from the bytes, dropping the CR of CRLFs */
+    std::string u;
+    u.reserve (len);
+
+    for (gsize i = 0; i < len; i++) {
+      if (in[i] == '\r' && i + 1 < len && in[i + 1] == '\n') continue;
+      u += in[i];
+    }
+
+    return std::make_pair (true, Glib::ustring (u));
+  }
 }
 
@@ -17,6 +17,8 @@ namespace Astroid {
       /* converts a byte array to a ustring */
       static std::pair<bool, Glib::ustring> data_to_ustring (unsigned int len, const char * data);
       static std::pair<bool, Glib::ustring> bytearray_to_ustring (Glib::RefPtr<Glib::ByteArray> &ba);
+      static std::pair<bool, Glib::ustring> bytes_to_ustring (Glib::RefPtr<Glib::Bytes> &b);
+      static std::pair<bool, Glib::ustring> bytes_to_unix_ustring (Glib::RefPtr<Glib::Bytes> &b); // and unixify in one pass
   };
 }
 
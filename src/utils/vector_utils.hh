@@ -2,6 +2,9 @@
 
 # include "astroid.hh"
 # include <vector>
+# include <algorithm>
+# include <future>
+# include <thread>
 
 namespace Astroid {
   template<class T> bool has (std::vector<T> v, T e) {
@@ -18,6 +21,55 @@ namespace Astroid {
 
       static const std::vector<ustring> stop_ons_tags;
 
+      /* sort in chunks on separate threads and merge the chunks, small
+       * vectors are sorted in place. */
+      template<class T, class Compare> static void parallel_sort (
+          std::vector<T> & v, Compare comp, size_t min_chunk = 4096)
+      {
+        size_t n = v.size ();
+        size_t workers = std::min<size_t> (
+            std::max (1u, std::thread::hardware_concurrency ()),
+            n / min_chunk);
+
+        if (workers < 2) {
+          std::sort (v.begin (), v.end (), comp);
+          return;
+        }
+
+        size_t chunk = (n + workers - 1) / workers;
+
+        std::vector<size_t> bounds;
+        for (size_t b = 0; b < n; b += chunk) bounds.push_back (b);
+        bounds.push_back (n);
+
+        std::vector<std::future<void>> fs;
+        for (size_t i = 1; i + 1 < bounds.size (); i++) {
+          fs.push_back (std::async (std::launch::async, [&, i] {
+                std::sort (v.begin () + bounds[i], v.begin () + bounds[i+1], comp);
+              }));
+        }
+
+        std::sort (v.begin (), v.begin () + bounds[1], comp);
+        for (auto &f : fs) f.wait ();
+
+        /* merge neighbouring chunks pairwise until one is left */
+        for (size_t step = 1; step + 1 < bounds.size (); step *= 2) {
+          std::vector<std::future<void>> ms;
+
+          for (size_t i = 0; i + step + 1 < bounds.size (); i += 2 * step) {
+            size_t b = bounds[i];
+            size_t m = bounds[i + step];
+            size_t e = bounds[std::min (i + 2 * step, bounds.size () - 1)];
+
+            ms.push_back (std::async (std::launch::async, [&, b, m, e] {
+                  std::inplace_merge (v.begin () + b, v.begin () + m, v.begin () + e, comp);
+                }));
+          }
+
+          for (auto &f : ms) f.wait ();
+        }
+      }
+
   };
 }
 
@@ -0,0 +1,143 @@
+# define BOOST_TEST_DYN_LINK
+# define BOOST_TEST_MODULE TestContactIndex
+# include <boost/test/unit_test.hpp>
+
+# include <string>
+# include <vector>
+# include <cstdio>
+# include <unistd.h>
+
+# include "test_common.hh"
+# include "utils/contact_index.hh"
+
+using Astroid::ContactIndex;
+
+BOOST_AUTO_TEST_SUITE(Contacts)
+
+  BOOST_AUTO_TEST_CASE(count_and_rank)
+  {
+    ContactIndex c;
+    int64_t now = 1000000000;
+
+    BOOST_CHECK (c.count_message ("a@example.com"));
+    c.add ("alice@example.com", "Alice Liddell", now - 10);
+    BOOST_CHECK (!c.count_message ("a@example.com"));
+
+    BOOST_CHECK (c.count_message ("b@example.com"));
+    c.add ("Alice@Example.com", "Alice Liddell", now - 5);
+    c.add ("albert@example.com", "Albert", now - 5);
+
+    BOOST_CHECK_EQUAL (c.size (), 2);
+    BOOST_CHECK_EQUAL (c.messages (), 2);
+
+    auto r = c.lookup ("al", 10, now);
+    BOOST_REQUIRE_EQUAL (r.size (), 2);
+    BOOST_CHECK_EQUAL (r[0].email, "alice@example.com");
+    BOOST_CHECK_EQUAL (r[0].count, 2);
+    BOOST_CHECK_EQUAL (r[1].email, "albert@example.com");
+
+    /* words of the name, case insensitive */
+    r = c.lookup ("LIDD", 10, now);
+    BOOST_REQUIRE_EQUAL (r.size (), 1);
+    BOOST_CHECK_EQUAL (r[0].name, "Alice Liddell");
+
+    BOOST_CHECK (c.lookup ("bob", 10, now).empty ());
+    BOOST_CHECK_EQUAL (c.lookup ("a", 1, now).size (), 1);
+
+    /* with more matching keys than are scanned the best ranked contacts
+     * are checked instead */
+    c.add ("bob@example.com", "Bob", now);
+    c.lookup_scan = 1;
+
+    r = c.lookup ("al", 10, now);
+    BOOST_REQUIRE_EQUAL (r.size (), 2);
+    BOOST_CHECK_EQUAL (r[0].email, "alice@example.com");
+    BOOST_CHECK_EQUAL (r[1].email, "albert@example.com");
+
+    r = c.lookup ("al", 1, now);
+    BOOST_REQUIRE_EQUAL (r.size (), 1);
+    BOOST_CHECK_EQUAL (r[0].email, "alice@example.com");
+  }
+
+  BOOST_AUTO_TEST_CASE(recency)
+  {
+    ContactIndex c;
+    c.half_life = 100;
+    int64_t now = 100000;
+
+    /* seen often, but long ago */
+    for (int i = 0; i < 8; i++) c.add ("old@example.com", "", now - 1000);
+    c.add ("new@example.com", "", now);
+
+    auto r = c.lookup ("", 0, now);
+    BOOST_REQUIRE_EQUAL (r.size (), 2);
+    BOOST_CHECK_EQUAL (r[0].email, "new@example.com");
+  }
+
+  BOOST_AUTO_TEST_CASE(fuzzy)
+  {
+    ContactIndex c;
+    int64_t now = 1000;
+
+    c.add ("john.doe@example.com", "John Doe", now);
+    c.add ("jane@example.org", "Jane Roe", now);
+
+    auto r = c.fuzzy ("jdoe", 10, now);
+    BOOST_REQUIRE (!r.empty ());
+    BOOST_CHECK_EQUAL (r[0].email, "john.doe@example.com");
+
+    BOOST_CHECK (c.fuzzy ("xyz", 10, now).empty ());
+
+    /* only the best ranked contacts are scanned */
+    c.add ("jane@example.org", "Jane Roe", now);
+    c.fuzzy_scan = 1;
+    r = c.fuzzy ("j", 10, now);
+    BOOST_REQUIRE_EQUAL (r.size (), 1);
+    BOOST_CHECK_EQUAL (r[0].email, "jane@example.org");
+    c.fuzzy_scan = 0;
+
+    BOOST_CHECK_EQUAL (c.fuzzy ("j", 10, now).size (), 2);
+
+    /* parts of the local part are prefixes too */
+    r = c.lookup ("doe", 10, now);
+    BOOST_REQUIRE_EQUAL (r.size (), 1);
+    BOOST_CHECK_EQUAL (r[0].email, "john.doe@example.com");
+  }
+
+  BOOST_AUTO_TEST_CASE(save_and_load)
+  {
+    ContactIndex c;
+
+    c.count_message ("m1");
+    c.add ("alice@example.com", "Alice", 10);
+    c.add ("bob@example.com", "Bob", 20);
+
+    char tmpl[] = "/tmp/astroid-contacts-XXXXXX";
+    int fd = mkstemp (tmpl);
+    BOOST_REQUIRE (fd >= 0);
+    close (fd);
+
+    BOOST_REQUIRE (c.save (tmpl, "uuid", 42));
+
+    ContactIndex l;
+    std::string uuid;
+    uint64_t revision = 0;
+    BOOST_REQUIRE (l.load (tmpl, uuid, revision));
+
+    BOOST_CHECK_EQUAL (uuid, "uuid");
+    BOOST_CHECK_EQUAL (revision, 42);
+    BOOST_CHECK_EQUAL (l.size (), 2);
+    BOOST_CHECK (!l.count_message ("m1"));
+
+    auto r = l.lookup ("bo", 10, 20);
+    BOOST_REQUIRE_EQUAL (r.size (), 1);
+    BOOST_CHECK_EQUAL (r[0].name, "Bob");
+    BOOST_CHECK_EQUAL (r[0].last, 20);
+
+    std::remove (tmpl);
+
+    BOOST_CHECK (!l.load (tmpl, uuid, revision));
+  }
+
+BOOST_AUTO_TEST_SUITE_END()
+
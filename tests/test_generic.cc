@@ -88,6 +88,13 @@ BOOST_AUTO_TEST_SUITE(Generic)
     BOOST_CHECK (v[1] == "bgd");
     BOOST_CHECK (v.size () == 2);
 
+    /* raw bytes */
+    std::string raw = "From: a\r\nTo: b\r\n\r\nbody\rx\n";
+    auto b = Glib::Bytes::create (raw.data (), raw.size ());
+    auto r = UstringUtils::bytes_to_unix_ustring (b);
+    BOOST_CHECK (r.first);
+    BOOST_CHECK (r.second == "From: a\nTo: b\n\nbody\rx\n");
+
     teardown ();
   }
 
@@ -0,0 +1,93 @@
+# define BOOST_TEST_DYN_LINK
+# define BOOST_TEST_MODULE TestPrefixTrie
+# include <boost/test/unit_test.hpp>
+
+# include <string>
+# include <vector>
+# include <algorithm>
+
+# include "test_common.hh"
+# include "utils/prefix_trie.hh"
+
+using Astroid::PrefixTrie;
+
+BOOST_AUTO_TEST_SUITE(Trie)
+
+  BOOST_AUTO_TEST_CASE(insert_and_complete)
+  {
+    PrefixTrie t;
+
+    BOOST_CHECK (t.insert ("inbox"));
+    BOOST_CHECK (t.insert ("important"));
+    BOOST_CHECK (t.insert ("unread"));
+    BOOST_CHECK (t.insert ("in"));
+    BOOST_CHECK (!t.insert ("inbox"));
+
+    BOOST_CHECK_EQUAL (t.size (), 4);
+    BOOST_CHECK (t.contains ("in"));
+    BOOST_CHECK (!t.contains ("inb"));
+
+    std::vector<std::string> r = t.complete ("i");
+    std::vector<std::string> e = { "important", "in", "inbox" };
+    BOOST_CHECK (r == e);
+
+    r = t.complete ("inb");
+    BOOST_REQUIRE_EQUAL (r.size (), 1);
+    BOOST_CHECK_EQUAL (r[0], "inbox");
+
+    BOOST_CHECK (t.complete ("x").empty ());
+    BOOST_CHECK (t.complete ("inboxes").empty ());
+
+    /* empty prefix gives everything */
+    BOOST_CHECK_EQUAL (t.complete ("").size (), 4);
+
+    t.clear ();
+    BOOST_CHECK_EQUAL (t.size (), 0);
+    BOOST_CHECK (t.complete ("").empty ());
+  }
+
+  BOOST_AUTO_TEST_CASE(shared_keys)
+  {
+    PrefixTrie t;
+
+    /* case-folded key, original value */
+    BOOST_CHECK (t.insert ("inbox", "Inbox"));
+    BOOST_CHECK (t.insert ("inbox", "inbox"));
+    BOOST_CHECK (!t.insert ("inbox", "Inbox"));
+
+    std::vector<std::string> r = t.complete ("inb");
+    std::vector<std::string> e = { "Inbox", "inbox" };
+    BOOST_CHECK (r == e);
+  }
+
+  BOOST_AUTO_TEST_CASE(order_and_limit)
+  {
+    PrefixTrie t;
+
+    std::vector<std::string> all;
+    for (int i = 0; i < 1000; i++) {
+      all.push_back ("tag" + std::to_string (i));
+    }
+
+    /* insertion order does not matter */
+    std::vector<std::string> shuffled = all;
+    std::reverse (shuffled.begin (), shuffled.end ());
+    for (auto & s : shuffled) t.insert (s);
+
+    std::sort (all.begin (), all.end ());
+    BOOST_CHECK (t.complete ("tag") == all);
+
+    std::vector<std::string> r = t.complete ("tag1", 5);
+    std::vector<std::string> e = { "tag1", "tag10", "tag100", "tag101", "tag102" };
+    BOOST_CHECK (r == e);
+
+    /* non-ascii keys are indexed byte-wise */
+    t.insert ("ærlig");
+    t.insert ("æble");
+    r = t.complete ("æ");
+    e = { "æble", "ærlig" };
+    BOOST_CHECK (r == e);
+  }
+
+BOOST_AUTO_TEST_SUITE_END()
+
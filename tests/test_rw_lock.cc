@@ -0,0 +1,113 @@
+# define BOOST_TEST_DYN_LINK
+# define BOOST_TEST_MODULE TestRwLock
+# include <boost/test/unit_test.hpp>
+
+# include <thread>
+# include <atomic>
+# include <chrono>
+
+# include "test_common.hh"
+# include "utils/rw_lock.hh"
+
+using Astroid::RwLock;
+
+BOOST_AUTO_TEST_SUITE(Locking)
+
+  BOOST_AUTO_TEST_CASE(readers_share_lock)
+  {
+    RwLock l ("test");
+
+    auto a = l.lock_read ("a");
+    auto b = l.lock_read ("b");
+
+    BOOST_CHECK_EQUAL (l.readers (), 2);
+    BOOST_CHECK (!l.writer ());
+
+    l.unlock (a);
+    l.unlock (b);
+
+    BOOST_CHECK_EQUAL (l.readers (), 0);
+  }
+
+  BOOST_AUTO_TEST_CASE(writer_preference)
+  {
+    RwLock l ("test");
+
+    auto r = l.lock_read ("first reader");
+
+    std::atomic<bool> writer_done (false);
+    std::atomic<bool> reader_done (false);
+
+    std::thread w ([&] {
+        auto t = l.lock_write ("writer");
+        BOOST_CHECK (!reader_done);
+        writer_done = true;
+        l.unlock (t);
+        });
+
+    /* wait for the writer to queue up */
+    while (l.dump ().find ("waiting writers: 1") == std::string::npos)
+      std::this_thread::sleep_for (std::chrono::milliseconds (1));
+
+    /* a new reader must wait behind the writer */
+    std::thread rr ([&] {
+        auto t = l.lock_read ("second reader");
+        BOOST_CHECK (writer_done);
+        reader_done = true;
+        l.unlock (t);
+        });
+
+    std::this_thread::sleep_for (std::chrono::milliseconds (50));
+    BOOST_CHECK (!writer_done);
+    BOOST_CHECK (!reader_done);
+
+    l.unlock (r);
+
+    w.join ();
+    rr.join ();
+
+    BOOST_CHECK (writer_done);
+    BOOST_CHECK (reader_done);
+  }
+
+  BOOST_AUTO_TEST_CASE(reentrant_reader)
+  {
+    RwLock l ("test");
+
+    auto r = l.lock_read ("reader");
+
+    std::thread w ([&] {
+        auto t = l.lock_write ("writer");
+        l.unlock (t);
+        });
+
+    while (l.dump ().find ("waiting writers: 1") == std::string::npos)
+      std::this_thread::sleep_for (std::chrono::milliseconds (1));
+
+    /* same thread may take another read lock despite the waiting writer */
+    auto r2 = l.lock_read ("reader again");
+    BOOST_CHECK_EQUAL (l.readers (), 2);
+
+    l.unlock (r2);
+    l.unlock (r);
+    w.join ();
+  }
+
+  BOOST_AUTO_TEST_CASE(wait_histograms)
+  {
+    RwLock l ("test");
+
+    l.unlock (l.lock_read ("reader"));
+    l.unlock (l.lock_read ("reader"));
+    l.unlock (l.lock_write ("writer"));
+
+    auto s = l.stats ();
+    BOOST_CHECK_EQUAL (s["reader (ro)"].count, 2);
+    BOOST_CHECK_EQUAL (s["writer (rw)"].count, 1);
+    BOOST_CHECK_EQUAL (s["reader (ro)"].buckets.size (), RwLock::bucket_bounds.size () + 1);
+
+    BOOST_CHECK (l.dump_stats ().find ("reader (ro)") != std::string::npos);
+  }
+
+BOOST_AUTO_TEST_SUITE_END()
+
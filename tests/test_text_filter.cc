@@ -0,0 +1,86 @@
+# define BOOST_TEST_DYN_LINK
+# define BOOST_TEST_MODULE TestTextFilter
+# include <boost/test/unit_test.hpp>
+
+# include <string>
+# include <vector>
+# include <cstring>
+
+# include "test_common.hh"
+# include "utils/text_filter.hh"
+
+using Astroid::TextFilter;
+
+BOOST_AUTO_TEST_SUITE(Filter)
+
+  BOOST_AUTO_TEST_CASE(search)
+  {
+    std::string h = "the quick brown fox jumps over the lazy dog, and again the quick brown fox";
+
+    for (size_t s = 0; s < h.size (); s++) {
+      for (size_t l = 1; l < 12 && s + l <= h.size (); l++) {
+        std::string n = h.substr (s, l);
+        const char * p = TextFilter::search (h.data (), h.size (), n.data (), n.size ());
+        BOOST_REQUIRE (p != NULL);
+        BOOST_CHECK_EQUAL ((size_t) (p - h.data ()), h.find (n));
+      }
+    }
+
+    BOOST_CHECK (TextFilter::search (h.data (), h.size (), "foxes", 5) == NULL);
+    BOOST_CHECK (TextFilter::search (h.data (), 3, "the quick", 9) == NULL);
+  }
+
+  BOOST_AUTO_TEST_CASE(filter_and_narrow)
+  {
+    TextFilter f;
+
+    f.add ("first thread subject alice inbox");
+    f.add ("second thread bob inbox unread");
+    f.add ("third alice unread");
+    f.add ("");
+
+    BOOST_CHECK_EQUAL (f.filter ({}), 4);
+
+    BOOST_CHECK_EQUAL (f.filter ({ "alice" }), 2);
+    BOOST_CHECK (f.visible (0));
+    BOOST_CHECK (!f.visible (1));
+    BOOST_CHECK (f.visible (2));
+    BOOST_CHECK (!f.visible (3));
+
+    /* narrowing */
+    BOOST_CHECK_EQUAL (f.filter ({ "alice", "unr" }), 1);
+    BOOST_CHECK (f.visible (2));
+
+    BOOST_CHECK_EQUAL (f.filter ({ "alice", "unread" }), 1);
+    BOOST_CHECK (f.visible (2));
+
+    /* widening */
+    BOOST_CHECK_EQUAL (f.filter ({ "unread" }), 2);
+    BOOST_CHECK (f.visible (1));
+    BOOST_CHECK (f.visible (2));
+
+    /* a key can not match across entries */
+    BOOST_CHECK_EQUAL (f.filter ({ "inboxsecond" }), 0);
+  }
+
+  BOOST_AUTO_TEST_CASE(parallel)
+  {
+    TextFilter f;
+    f.parallel_threshold = 0;
+    f.max_workers = 4;
+
+    size_t n = 1000;
+    for (size_t i = 0; i < n; i++) {
+      f.add ("entry number " + std::to_string (i) + (i % 3 == 0 ? " fizz" : "") + (i % 5 == 0 ? " buzz" : ""));
+    }
+
+    BOOST_CHECK_EQUAL (f.filter ({ "fizz" }), 334);
+    BOOST_CHECK_EQUAL (f.filter ({ "fizz", "buzz" }), 67);
+
+    for (size_t i = 0; i < n; i++) {
+      BOOST_CHECK_EQUAL (f.visible (i), (i % 15 == 0));
+    }
+  }
+
+BOOST_AUTO_TEST_SUITE_END()
+